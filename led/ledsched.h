@@ -0,0 +1,287 @@
+/*
+ * Non-blocking LED/indicator scheduler
+ *
+ * Blinking an LED with usleep() between the on and off writes stalls the
+ * caller for the whole pattern - in a decoder that is hundreds of symbols
+ * not read from the socket. Here the calling thread only writes the first
+ * step, at once; the rest of the pattern is switched from the daemon's own
+ * loop when a timerfd fires. Add ledsched_fd() to the poll()/zmq_poll() set
+ * and call ledsched_dispatch() when it is readable.
+ *
+ * Each LED has one slot per priority. A pattern started at a priority at
+ * least as high as the one playing takes over immediately. A finite
+ * pattern (repeat > 0) that would be hidden by a higher priority one is
+ * dropped - a late "message received" blink means nothing. A continuous
+ * one (repeat = 0) waits and restarts when the LED is free again. Playing
+ * the pattern that is already in its slot is coalesced: a burst of
+ * messages gives one blink, not a queue of them. With nothing playing the
+ * LED shows its base level (ledsched_base()).
+ *
+ * ledsched_play(), ledsched_stop() and ledsched_base() may be called from
+ * any thread; ledsched_dispatch() from one thread only. The first three
+ * call the output function in the caller's thread when the level changes,
+ * so it has to work from every thread that uses them. The scheduler lock
+ * keeps any two calls from overlapping.
+ */
+#ifndef LEDSCHED_H
+#define LEDSCHED_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/timerfd.h>
+
+#define LEDSCHED_MAX_LEDS 4
+#define LEDSCHED_MAX_STEPS 16
+#define LEDSCHED_PRIOS 4
+
+// durations in ms, alternating on, off, on, ... starting with on
+typedef struct
+{
+    uint16_t ms[LEDSCHED_MAX_STEPS];
+    uint8_t steps;
+    uint8_t repeat; // times to play the whole pattern, 0 - until stopped
+} ledsched_pattern_t;
+
+// switches the hardware, called with the scheduler lock held - from
+// ledsched_dispatch() or from the thread that changed the pattern/base level
+typedef void (*ledsched_out_fn)(uint8_t led, bool on);
+
+typedef struct
+{
+    const ledsched_pattern_t *pat; // NULL - slot empty
+    uint8_t step;
+    uint8_t loops;
+} ledsched_slot_t;
+
+typedef struct
+{
+    ledsched_slot_t slot[LEDSCHED_PRIOS];
+    int8_t active;  // playing priority, -1 - showing the base level
+    uint64_t due;   // CLOCK_MONOTONIC ns of the next step
+    bool base;
+    bool state;     // last level written
+} ledsched_led_t;
+
+typedef struct
+{
+    int fd;
+    pthread_mutex_t mtx;
+    ledsched_out_fn out;
+    uint8_t n;
+    ledsched_led_t led[LEDSCHED_MAX_LEDS];
+} ledsched_t;
+
+static inline uint64_t ledsched_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// `n` LEDs, numbered 0..n-1 in calls to `out`; all start off. Returns 0 on success
+static inline int ledsched_init(ledsched_t *s, uint8_t n, ledsched_out_fn out)
+{
+    memset(s, 0, sizeof(*s));
+
+    if (n > LEDSCHED_MAX_LEDS)
+        return -1;
+
+    s->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (s->fd < 0)
+        return -1;
+
+    pthread_mutex_init(&s->mtx, NULL);
+    s->out = out;
+    s->n = n;
+
+    for (uint8_t i = 0; i < n; i++)
+    {
+        s->led[i].active = -1;
+        out(i, false);
+    }
+
+    return 0;
+}
+
+static inline int ledsched_fd(const ledsched_t *s)
+{
+    return s->fd;
+}
+
+static inline void ledsched_close(ledsched_t *s)
+{
+    close(s->fd);
+    pthread_mutex_destroy(&s->mtx);
+}
+
+static inline void ledsched_write(ledsched_t *s, uint8_t i, bool on)
+{
+    if (s->led[i].state != on)
+    {
+        s->led[i].state = on;
+        s->out(i, on);
+    }
+}
+
+// start the highest priority pattern left, or show the base level
+static inline void ledsched_pick(ledsched_t *s, uint8_t i, uint64_t now)
+{
+    ledsched_led_t *l = &s->led[i];
+
+    l->active = -1;
+    for (int8_t p = LEDSCHED_PRIOS - 1; p >= 0; p--)
+    {
+        if (l->slot[p].pat)
+        {
+            l->active = p;
+            break;
+        }
+    }
+
+    if (l->active < 0)
+    {
+        ledsched_write(s, i, l->base);
+        return;
+    }
+
+    ledsched_slot_t *sl = &l->slot[l->active];
+    sl->step = 0;
+    sl->loops = 0;
+    l->due = now + sl->pat->ms[0] * 1000000ULL;
+    ledsched_write(s, i, true);
+}
+
+// arm the timer for the earliest step of any LED
+static inline void ledsched_arm(ledsched_t *s)
+{
+    struct itimerspec its = {0};
+    uint64_t next = 0;
+
+    for (uint8_t i = 0; i < s->n; i++)
+        if (s->led[i].active >= 0 && (next == 0 || s->led[i].due < next))
+            next = s->led[i].due;
+
+    // all zero disarms
+    its.it_value.tv_sec = next / 1000000000ULL;
+    its.it_value.tv_nsec = next % 1000000000ULL;
+    timerfd_settime(s->fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+// play `pat` (kept by pointer, it has to outlive its use). Returns 0 on success
+static inline int ledsched_play(ledsched_t *s, uint8_t led, const ledsched_pattern_t *pat, uint8_t prio)
+{
+    if (led >= s->n || prio >= LEDSCHED_PRIOS || !pat || pat->steps == 0 || pat->steps > LEDSCHED_MAX_STEPS)
+        return -1;
+    for (uint8_t k = 0; k < pat->steps; k++)
+        if (pat->ms[k] == 0)
+            return -1;
+
+    pthread_mutex_lock(&s->mtx);
+
+    ledsched_led_t *l = &s->led[led];
+
+    if (l->slot[prio].pat != pat) // otherwise coalesced with the one in the slot
+    {
+        if (prio >= l->active)
+        {
+            // a finite pattern being replaced is over, a continuous one resumes later
+            if (l->active >= 0 && l->slot[l->active].pat->repeat)
+                l->slot[l->active].pat = NULL;
+            l->slot[prio].pat = pat;
+            ledsched_pick(s, led, ledsched_now());
+            ledsched_arm(s);
+        }
+        else if (pat->repeat == 0)
+        {
+            l->slot[prio].pat = pat;
+        }
+    }
+
+    pthread_mutex_unlock(&s->mtx);
+
+    return 0;
+}
+
+// end the pattern at `prio`, if any
+static inline void ledsched_stop(ledsched_t *s, uint8_t led, uint8_t prio)
+{
+    if (led >= s->n || prio >= LEDSCHED_PRIOS)
+        return;
+
+    pthread_mutex_lock(&s->mtx);
+
+    ledsched_led_t *l = &s->led[led];
+    l->slot[prio].pat = NULL;
+    if (l->active == prio)
+    {
+        ledsched_pick(s, led, ledsched_now());
+        ledsched_arm(s);
+    }
+
+    pthread_mutex_unlock(&s->mtx);
+}
+
+// level shown while no pattern is playing
+static inline void ledsched_base(ledsched_t *s, uint8_t led, bool on)
+{
+    if (led >= s->n)
+        return;
+
+    pthread_mutex_lock(&s->mtx);
+
+    s->led[led].base = on;
+    if (s->led[led].active < 0)
+        ledsched_write(s, led, on);
+
+    pthread_mutex_unlock(&s->mtx);
+}
+
+// advance all patterns up to now, call when ledsched_fd() is readable
+static inline void ledsched_dispatch(ledsched_t *s)
+{
+    // EAGAIN is fine - a re-arm may have consumed the expiration, the
+    // deadlines are checked anyway
+    uint64_t expirations;
+    ssize_t r = read(s->fd, &expirations, sizeof(expirations));
+    (void)r;
+
+    pthread_mutex_lock(&s->mtx);
+
+    uint64_t now = ledsched_now();
+
+    for (uint8_t i = 0; i < s->n; i++)
+    {
+        ledsched_led_t *l = &s->led[i];
+
+        // steps are timed from the previous deadline, not from the (late)
+        // wakeup, so long patterns do not drift
+        while (l->active >= 0 && l->due <= now)
+        {
+            ledsched_slot_t *sl = &l->slot[l->active];
+
+            if (++sl->step == sl->pat->steps)
+            {
+                sl->step = 0;
+                if (sl->pat->repeat && ++sl->loops == sl->pat->repeat)
+                {
+                    sl->pat = NULL;
+                    ledsched_pick(s, i, now);
+                    continue;
+                }
+            }
+
+            l->due += sl->pat->ms[sl->step] * 1000000ULL;
+            ledsched_write(s, i, !(sl->step & 1));
+        }
+    }
+
+    ledsched_arm(s);
+
+    pthread_mutex_unlock(&s->mtx);
+}
+
+#endif // LEDSCHED_H
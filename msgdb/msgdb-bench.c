@@ -0,0 +1,253 @@
+/*
+ * Message database benchmark: counts before and after the migrations
+ *
+ *   msgdb-bench [rows] [path]
+ *
+ * Builds a version 1 database (the original table, no indexes) with `rows`
+ * messages, times the COUNT(*) queries the tools used to run, applies the
+ * migrations one at a time (timing each) and times the counter lookups and
+ * the inserts that pay for the indexes and triggers, and the first page of
+ * a few searches - including a near miss, a word longer than the indexed
+ * prefix that no row contains in full. Finally updates and deletes rows at
+ * random and checks the counters against COUNT(*).
+ * Exits with 1 if they disagree. Use a tmpfs path to leave the disk out.
+ */
+#include "msgdb.h"
+
+#include <stdlib.h>
+#include <time.h>
+
+#define SOURCES 500 // distinct callsigns, every 10th message unread
+#define BINARY_EVERY 8 // every 8th row is a binary packet, not a text message
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// run a single-integer query `reps` times, returns us per run
+static double time_count(sqlite3 *db, const char *sql, int reps, int *result)
+{
+    sqlite3_stmt *stmt;
+    double t0;
+
+    *result = -1;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+        return -1.0;
+
+    t0 = now_s();
+    for (int i = 0; i < reps; i++)
+    {
+        if (sqlite3_step(stmt) == SQLITE_ROW)
+            *result = sqlite3_column_int(stmt, 0);
+        sqlite3_reset(stmt);
+    }
+    t0 = now_s() - t0;
+
+    sqlite3_finalize(stmt);
+    return t0 * 1e6 / reps;
+}
+
+// insert rows [first, first + n) in transactions of `batch`, returns seconds
+static double insert_rows(sqlite3 *db, int first, int n, int batch)
+{
+    sqlite3_stmt *stmt;
+    char src[16];
+    double t0 = now_s();
+
+    if (sqlite3_prepare_v2(db, MSGDB_INSERT_SQL, -1, &stmt, NULL) != SQLITE_OK)
+        return -1.0;
+
+    for (int i = first; i < first + n; i++)
+    {
+        if ((i - first) % batch == 0)
+            sqlite3_exec(db, "BEGIN;", NULL, NULL, NULL);
+
+        snprintf(src, sizeof(src), "N0CALL%d", i % SOURCES);
+        sqlite3_bind_int64(stmt, 1, 1700000000 + i);
+        sqlite3_bind_text(stmt, 3, src, -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 4, "@ALL", -1, SQLITE_STATIC);
+        sqlite3_bind_blob(stmt, 5, "12345678901234", 14, SQLITE_STATIC);
+        if (i % BINARY_EVERY == 0)
+        {
+            // another packet type, stored as it came and never counted
+            sqlite3_bind_text(stmt, 2, "M17 APRS", -1, SQLITE_STATIC);
+            sqlite3_bind_blob(stmt, 6, "\x82\xa0\xa4\xa6 Hello\x03\xf0", 12, SQLITE_STATIC);
+        }
+        else
+        {
+            sqlite3_bind_text(stmt, 2, "M17", -1, SQLITE_STATIC);
+            sqlite3_bind_text(stmt, 6, "Hello world, this is a test message of moderate length.", -1, SQLITE_STATIC);
+        }
+        sqlite3_bind_int(stmt, 7, i % 10 != 0);
+        sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+
+        if ((i - first) % batch == batch - 1 || i == first + n - 1)
+            sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL);
+    }
+
+    sqlite3_finalize(stmt);
+    return now_s() - t0;
+}
+
+static int count_row(void *arg, const msgdb_row_t *row)
+{
+    (void)row;
+    (*(int *)arg)++;
+    return 0;
+}
+
+// first page of a search for `text`, `reps` times, returns us per run
+static double time_search(sqlite3 *db, const char *text, int reps, int *rows, int64_t *next_id)
+{
+    msgdb_query_t q = {.text = text, .limit = 20};
+    double t0 = now_s();
+
+    for (int i = 0; i < reps; i++)
+    {
+        *rows = 0;
+        if (msgdb_search(db, &q, count_row, rows) < 0)
+            return -1.0;
+    }
+
+    *next_id = q.next_id;
+    return (now_s() - t0) * 1e6 / reps;
+}
+
+// one migration step the way msgdb_migrate() applies it, returns seconds
+static double migrate_step(sqlite3 *db, int v)
+{
+    char sql[64];
+    double t0 = now_s();
+
+    snprintf(sql, sizeof(sql), "PRAGMA user_version = %d;", v + 1);
+    if (sqlite3_exec(db, "BEGIN IMMEDIATE;", NULL, NULL, NULL) != SQLITE_OK ||
+        sqlite3_exec(db, msgdb_migrations[v], NULL, NULL, NULL) != SQLITE_OK ||
+        sqlite3_exec(db, sql, NULL, NULL, NULL) != SQLITE_OK ||
+        sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL) != SQLITE_OK)
+    {
+        fprintf(stderr, "Migration to version %d failed: %s\n", v + 1, sqlite3_errmsg(db));
+        return -1.0;
+    }
+
+    return now_s() - t0;
+}
+
+// counters against a full scan, prints both; true if they match
+static bool check_counts(sqlite3 *db, const char *when)
+{
+    int total, unread, scan_total, scan_unread;
+
+    time_count(db, MSGDB_COUNT_SQL, 1, &total);
+    time_count(db, MSGDB_UNREAD_COUNT_SQL, 1, &unread);
+    time_count(db, "SELECT COUNT(*) FROM messages WHERE protocol = 'M17';", 1, &scan_total);
+    time_count(db, "SELECT COUNT(*) FROM messages WHERE protocol = 'M17' AND read IS 0;", 1, &scan_unread);
+
+    printf("%-24s total %d (scan %d), unread %d (scan %d)\n", when, total, scan_total, unread, scan_unread);
+    return total == scan_total && unread == scan_unread;
+}
+
+int main(int argc, char *argv[])
+{
+    int rows = argc > 1 ? atoi(argv[1]) : 1000000;
+    const char *path = argc > 2 ? argv[2] : "/dev/shm/msgdb-bench.db";
+    char wal[256];
+    sqlite3 *db;
+    double t;
+    int c;
+    bool ok = true;
+
+    if (rows <= 0)
+    {
+        fprintf(stderr, "Usage: %s [rows] [path]\n", argv[0]);
+        return 1;
+    }
+
+    remove(path);
+    snprintf(wal, sizeof(wal), "%s-wal", path);
+    remove(wal);
+    snprintf(wal, sizeof(wal), "%s-shm", path);
+    remove(wal);
+
+    // version 1, as the tools created it before the migrations
+    if (sqlite3_open(path, &db) != SQLITE_OK ||
+        sqlite3_exec(db, msgdb_migrations[0], NULL, NULL, NULL) != SQLITE_OK ||
+        sqlite3_exec(db, "PRAGMA user_version = 1;", NULL, NULL, NULL) != SQLITE_OK)
+    {
+        fprintf(stderr, "Cannot create %s: %s\n", path, sqlite3_errmsg(db));
+        return 1;
+    }
+
+    t = insert_rows(db, 0, rows, 10000);
+    printf("version 1, %d rows inserted in %.2f s\n", rows, t);
+    t = time_count(db, "SELECT COUNT(*) FROM messages WHERE read = 0;", 5, &c);
+    printf("  unread COUNT(*)        %10.1f us  (%d)\n", t, c);
+    t = time_count(db, "SELECT COUNT(*) FROM messages;", 5, &c);
+    printf("  total COUNT(*)         %10.1f us  (%d)\n", t, c);
+    t = time_count(db, "SELECT COUNT(*) FROM messages WHERE source = 'N0CALL7';", 5, &c);
+    printf("  COUNT(*) by source     %10.1f us  (%d)\n", t, c);
+
+    for (int v = 1; v < MSGDB_VERSION; v++)
+    {
+        if ((t = migrate_step(db, v)) < 0)
+            return 1;
+        printf("migration %d -> %d         %10.2f s\n", v, v + 1, t);
+    }
+    sqlite3_close(db);
+
+    // nothing left to do, but check msgdb_open() agrees
+    if (msgdb_open(&db, path) != 0)
+        return 1;
+
+    printf("version %d\n", MSGDB_VERSION);
+    t = time_count(db, MSGDB_UNREAD_COUNT_SQL, 1000, &c);
+    printf("  unread counter         %10.1f us  (%d)\n", t, c);
+    t = time_count(db, MSGDB_COUNT_SQL, 1000, &c);
+    printf("  total counter          %10.1f us  (%d)\n", t, c);
+    t = time_count(db, "SELECT COUNT(*) FROM messages WHERE source = 'N0CALL7';", 100, &c);
+    printf("  COUNT(*) by source     %10.1f us  (%d)\n", t, c);
+
+    static const char *const searches[][2] =
+    {
+        {"hello", "short word"},
+        {"message", "long word, hits"},
+        {"messages", "long word, near miss"},
+    };
+    for (size_t i = 0; i < sizeof(searches) / sizeof(searches[0]); i++)
+    {
+        int64_t next = 0;
+        t = time_search(db, searches[i][0], 10, &c, &next);
+        printf("  search %-10s %-21s %10.1f us  (%d rows, next page before id %lld)\n",
+               searches[i][0], searches[i][1], t, c, (long long)next);
+    }
+
+    int more = rows / 10 > 0 ? rows / 10 : 1;
+    t = insert_rows(db, rows, more, 32);
+    printf("  insert, 32 per commit  %10.1f us/row  (%d rows)\n", t * 1e6 / more, more);
+
+    ok &= check_counts(db, "after inserts");
+
+    srand(1);
+    sqlite3_exec(db, "BEGIN;", NULL, NULL, NULL);
+    for (int i = 0; i < 1000; i++)
+    {
+        char sql[96];
+        int id = 1 + rand() % (rows + more);
+
+        if (i % 3 == 0)
+            snprintf(sql, sizeof(sql), "DELETE FROM messages WHERE id = %d;", id);
+        else
+            snprintf(sql, sizeof(sql), "UPDATE messages SET read = %d WHERE id = %d;", rand() % 2, id);
+        sqlite3_exec(db, sql, NULL, NULL, NULL);
+    }
+    sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL);
+
+    ok &= check_counts(db, "after updates/deletes");
+
+    sqlite3_close(db);
+    printf("%s\n", ok ? "counters OK" : "COUNTER MISMATCH");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,546 @@
+/*
+ * Message database - schema, migrations and search
+ *
+ * gui_test and m17-packet-sqlite both write to the same SQLite file
+ * (/var/lib/linht/messages.db). The schema lives here so the two can never
+ * disagree about it. msgdb_open() brings any existing database up to the
+ * current version.
+ *
+ * The schema version is kept in PRAGMA user_version. Migration N takes the
+ * database from version N-1 to N and runs inside an IMMEDIATE transaction
+ * together with the version bump, so two processes starting at the same time
+ * cannot apply the same migration twice. Migrations are append-only: never
+ * edit one that has shipped, add a new one instead.
+ */
+#ifndef MSGDB_H
+#define MSGDB_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <sqlite3.h>
+
+// statements shared by the writers and readers
+#define MSGDB_INSERT_SQL "INSERT INTO messages (timestamp, protocol, source, destination, meta, message, read) " \
+                         "VALUES (?, ?, ?, ?, ?, ?, ?);"
+#define MSGDB_COUNT_SQL "SELECT total FROM message_counts WHERE id = 0;"
+#define MSGDB_UNREAD_COUNT_SQL "SELECT unread FROM message_counts WHERE id = 0;"
+
+static const char *const msgdb_migrations[] =
+{
+    // 1: the original table, as created by the tools before migrations existed
+    "CREATE TABLE IF NOT EXISTS messages ("
+    "id INTEGER PRIMARY KEY,"
+    "timestamp INTEGER,"
+    "protocol TEXT,"
+    "source TEXT,"
+    "destination TEXT,"
+    "meta BLOB,"
+    "message TEXT,"
+    "read INTEGER"
+    ");",
+
+    // 2: indexes, and total/unread counters kept up to date by triggers so
+    // the counts do not need a table scan
+    "CREATE INDEX IF NOT EXISTS messages_read ON messages(read);"
+    "CREATE INDEX IF NOT EXISTS messages_timestamp ON messages(timestamp);"
+    "CREATE INDEX IF NOT EXISTS messages_source ON messages(source);"
+    "CREATE TABLE message_counts ("
+    "id INTEGER PRIMARY KEY CHECK (id = 0),"
+    "total INTEGER NOT NULL,"
+    "unread INTEGER NOT NULL"
+    ");"
+    "INSERT INTO message_counts (id, total, unread) "
+    "SELECT 0, COUNT(*), COUNT(*) FILTER (WHERE read IS 0) FROM messages;"
+    "CREATE TRIGGER messages_count_ins AFTER INSERT ON messages BEGIN "
+    "UPDATE message_counts SET total = total + 1, unread = unread + (NEW.read IS 0) WHERE id = 0; "
+    "END;"
+    "CREATE TRIGGER messages_count_del AFTER DELETE ON messages BEGIN "
+    "UPDATE message_counts SET total = total - 1, unread = unread - (OLD.read IS 0) WHERE id = 0; "
+    "END;"
+    "CREATE TRIGGER messages_count_upd AFTER UPDATE OF read ON messages BEGIN "
+    "UPDATE message_counts SET unread = unread + (NEW.read IS 0) - (OLD.read IS 0) WHERE id = 0; "
+    "END;",
+
+    // 3: full-text index over the message text and callsigns, external
+    // content (no second copy of the text), kept in sync by triggers;
+    // prefixes up to MSGDB_FTS_PREFIX_MAX bytes are indexed
+    "CREATE INDEX IF NOT EXISTS messages_destination ON messages(destination);"
+    "CREATE VIRTUAL TABLE messages_fts USING fts5("
+    "message, source, destination,"
+    "content='messages', content_rowid='id', prefix='2 3 4 5 6'"
+    ");"
+    "INSERT INTO messages_fts(messages_fts) VALUES('rebuild');"
+    "CREATE TRIGGER messages_fts_ins AFTER INSERT ON messages BEGIN "
+    "INSERT INTO messages_fts(rowid, message, source, destination) "
+    "VALUES (NEW.id, NEW.message, NEW.source, NEW.destination); "
+    "END;"
+    "CREATE TRIGGER messages_fts_del AFTER DELETE ON messages BEGIN "
+    "INSERT INTO messages_fts(messages_fts, rowid, message, source, destination) "
+    "VALUES ('delete', OLD.id, OLD.message, OLD.source, OLD.destination); "
+    "END;"
+    "CREATE TRIGGER messages_fts_upd AFTER UPDATE OF message, source, destination ON messages BEGIN "
+    "INSERT INTO messages_fts(messages_fts, rowid, message, source, destination) "
+    "VALUES ('delete', OLD.id, OLD.message, OLD.source, OLD.destination); "
+    "INSERT INTO messages_fts(rowid, message, source, destination) "
+    "VALUES (NEW.id, NEW.message, NEW.source, NEW.destination); "
+    "END;",
+
+    // 4: only text messages (protocol 'M17') are counted and indexed - the
+    // other packet types keep their payload as a BLOB in the message column
+    "DROP TRIGGER messages_count_ins;"
+    "DROP TRIGGER messages_count_del;"
+    "DROP TRIGGER messages_count_upd;"
+    "DROP TRIGGER messages_fts_ins;"
+    "DROP TRIGGER messages_fts_del;"
+    "DROP TRIGGER messages_fts_upd;"
+    "UPDATE message_counts SET "
+    "total = (SELECT COUNT(*) FROM messages WHERE protocol = 'M17'), "
+    "unread = (SELECT COUNT(*) FROM messages WHERE protocol = 'M17' AND read IS 0) "
+    "WHERE id = 0;"
+    "CREATE TRIGGER messages_count_ins AFTER INSERT ON messages WHEN NEW.protocol = 'M17' BEGIN "
+    "UPDATE message_counts SET total = total + 1, unread = unread + (NEW.read IS 0) WHERE id = 0; "
+    "END;"
+    "CREATE TRIGGER messages_count_del AFTER DELETE ON messages WHEN OLD.protocol = 'M17' BEGIN "
+    "UPDATE message_counts SET total = total - 1, unread = unread - (OLD.read IS 0) WHERE id = 0; "
+    "END;"
+    "CREATE TRIGGER messages_count_upd AFTER UPDATE OF read, protocol ON messages "
+    "WHEN NEW.protocol = 'M17' OR OLD.protocol = 'M17' BEGIN "
+    "UPDATE message_counts SET "
+    "total = total + (NEW.protocol IS 'M17') - (OLD.protocol IS 'M17'), "
+    "unread = unread + (NEW.protocol IS 'M17' AND NEW.read IS 0) - (OLD.protocol IS 'M17' AND OLD.read IS 0) "
+    "WHERE id = 0; "
+    "END;"
+    "INSERT INTO messages_fts(messages_fts) VALUES('delete-all');"
+    "INSERT INTO messages_fts(rowid, message, source, destination) "
+    "SELECT id, message, source, destination FROM messages WHERE protocol = 'M17';"
+    "CREATE TRIGGER messages_fts_ins AFTER INSERT ON messages WHEN NEW.protocol = 'M17' BEGIN "
+    "INSERT INTO messages_fts(rowid, message, source, destination) "
+    "VALUES (NEW.id, NEW.message, NEW.source, NEW.destination); "
+    "END;"
+    "CREATE TRIGGER messages_fts_del AFTER DELETE ON messages WHEN OLD.protocol = 'M17' BEGIN "
+    "INSERT INTO messages_fts(messages_fts, rowid, message, source, destination) "
+    "VALUES ('delete', OLD.id, OLD.message, OLD.source, OLD.destination); "
+    "END;"
+    "CREATE TRIGGER messages_fts_upd AFTER UPDATE OF message, source, destination, protocol ON messages "
+    "WHEN NEW.protocol = 'M17' OR OLD.protocol = 'M17' BEGIN "
+    "INSERT INTO messages_fts(messages_fts, rowid, message, source, destination) "
+    "SELECT 'delete', OLD.id, OLD.message, OLD.source, OLD.destination WHERE OLD.protocol = 'M17'; "
+    "INSERT INTO messages_fts(rowid, message, source, destination) "
+    "SELECT NEW.id, NEW.message, NEW.source, NEW.destination WHERE NEW.protocol = 'M17'; "
+    "END;",
+};
+
+#define MSGDB_VERSION ((int)(sizeof(msgdb_migrations) / sizeof(msgdb_migrations[0])))
+
+static inline int msgdb_user_version(sqlite3 *db)
+{
+    sqlite3_stmt *stmt;
+    int v = -1;
+
+    if (sqlite3_prepare_v2(db, "PRAGMA user_version;", -1, &stmt, NULL) != SQLITE_OK)
+        return -1;
+    if (sqlite3_step(stmt) == SQLITE_ROW)
+        v = sqlite3_column_int(stmt, 0);
+    sqlite3_finalize(stmt);
+
+    return v;
+}
+
+#define MSGDB_BUSY_TIMEOUT_MS 1000 // readers and writers waiting for each other
+#define MSGDB_MIGRATE_WAIT_S 600   // for another process's migration, ~17 s a step at 1M rows
+
+// apply all pending migrations, returns 0 on success
+static inline int msgdb_migrate(sqlite3 *db)
+{
+    char *err_msg = NULL;
+    char sql[64];
+    time_t deadline = 0;
+
+    while (1)
+    {
+        int rc = sqlite3_exec(db, "BEGIN IMMEDIATE;", NULL, NULL, &err_msg);
+
+        // a process starting at the same time may be in the middle of a
+        // migration, far longer than the busy timeout - keep trying, each
+        // try waits MSGDB_BUSY_TIMEOUT_MS (set by msgdb_open())
+        if (rc == SQLITE_BUSY && (deadline == 0 || time(NULL) < deadline))
+        {
+            if (deadline == 0)
+            {
+                fprintf(stderr, "Message database is locked, waiting for another process to migrate it\n");
+                deadline = time(NULL) + MSGDB_MIGRATE_WAIT_S;
+            }
+            sqlite3_free(err_msg);
+            err_msg = NULL;
+            continue;
+        }
+        if (rc != SQLITE_OK)
+            break;
+
+        // read the version inside the write transaction - another process
+        // may have migrated the database in the meantime
+        int v = msgdb_user_version(db);
+        if (v < 0 || v > MSGDB_VERSION)
+        {
+            fprintf(stderr, "Message database has unsupported schema version %d\n", v);
+            sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+            return 1;
+        }
+
+        if (v == MSGDB_VERSION)
+            return sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL) == SQLITE_OK ? 0 : 1;
+
+        snprintf(sql, sizeof(sql), "PRAGMA user_version = %d;", v + 1);
+
+        if (sqlite3_exec(db, msgdb_migrations[v], NULL, NULL, &err_msg) != SQLITE_OK ||
+            sqlite3_exec(db, sql, NULL, NULL, &err_msg) != SQLITE_OK ||
+            sqlite3_exec(db, "COMMIT;", NULL, NULL, &err_msg) != SQLITE_OK)
+        {
+            fprintf(stderr, "Message database migration to version %d failed: %s\n", v + 1, err_msg);
+            sqlite3_free(err_msg);
+            sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+            return 1;
+        }
+    }
+
+    fprintf(stderr, "Message database migration failed: %s\n", err_msg ? err_msg : sqlite3_errmsg(db));
+    sqlite3_free(err_msg);
+    return 1;
+}
+
+// open (creating if needed) and migrate the message database
+static inline int msgdb_open(sqlite3 **db, const char *path)
+{
+    if (sqlite3_open(path, db) != SQLITE_OK)
+    {
+        fprintf(stderr, "Cannot open database: %s\n", sqlite3_errmsg(*db));
+        sqlite3_close(*db);
+        *db = NULL;
+        return 1;
+    }
+
+    // the GUI reads while the decoder writes - WAL lets both proceed
+    sqlite3_busy_timeout(*db, MSGDB_BUSY_TIMEOUT_MS);
+    sqlite3_exec(*db, "PRAGMA journal_mode=WAL;", NULL, NULL, NULL);
+    sqlite3_exec(*db, "PRAGMA synchronous=NORMAL;", NULL, NULL, NULL);
+
+    if (msgdb_migrate(*db) != 0)
+    {
+        sqlite3_close(*db);
+        *db = NULL;
+        return 1;
+    }
+
+    return 0;
+}
+
+// ---------------------------------------------------------------- search
+
+#define MSGDB_SEARCH_MAX_TEXT 256 // bytes of search text used
+#define MSGDB_SEARCH_MAX_SKIP 2000 // candidates a page may reject before it is returned short
+
+typedef struct
+{
+    const char *text;     // words to look for (prefix match, all must occur), NULL/"" - any
+    const char *callsign; // exact source or destination, NULL/"" - any
+    int64_t before_id;    // paging: only rows with id < before_id, 0 - from the newest
+    int limit;            // rows per page
+    int64_t next_id;      // out: before_id of the next page, 0 - no more rows
+} msgdb_query_t;
+
+// one result row, the pointers are only valid inside the callback
+typedef struct
+{
+    int64_t id;
+    int64_t timestamp;
+    const char *protocol;
+    const char *source;
+    const char *destination;
+    const char *message;
+    const void *meta;
+    int meta_len;
+    int read;
+} msgdb_row_t;
+
+// return non-zero to stop the iteration
+typedef int (*msgdb_row_cb)(void *arg, const msgdb_row_t *row);
+
+#define MSGDB_SEARCH_COLS "m.id, m.timestamp, m.protocol, m.source, m.destination, m.message, m.meta, m.read"
+
+// text messages only, as in messages_fts (migration 4) - other packet types
+// hold a binary payload in m.message
+#define MSGDB_TEXT_ROW "m.protocol = 'M17'"
+
+// append `s` (`n` bytes) as an FTS5 string, quotes doubled; false if it does not fit
+static inline bool msgdb_fts_quote(char *out, size_t size, size_t *o, const char *s, size_t n)
+{
+    size_t w = *o;
+
+    if (w + 1 >= size)
+        return false;
+    out[w++] = '"';
+
+    for (size_t i = 0; i < n; i++)
+    {
+        if (w + 2 + (s[i] == '"') >= size)
+            return false;
+        if (s[i] == '"')
+            out[w++] = '"';
+        out[w++] = s[i];
+    }
+
+    out[w++] = '"';
+    out[w] = 0;
+    *o = w;
+    return true;
+}
+
+// next whitespace separated word of `*p`, returns its length (0 - no more words)
+static inline size_t msgdb_next_word(const char **p)
+{
+    size_t n = 0;
+
+    while (**p == ' ' || **p == '\t' || **p == '\n' || **p == '\r')
+        (*p)++;
+    while ((*p)[n] && (*p)[n] != ' ' && (*p)[n] != '\t' && (*p)[n] != '\n' && (*p)[n] != '\r')
+        n++;
+
+    return n;
+}
+
+// longest prefix, in bytes, kept in the FTS5 prefix index (see migration 3)
+#define MSGDB_FTS_PREFIX_MAX 6
+
+// length of the indexed prefix of a word, never splitting a UTF-8 sequence
+static inline size_t msgdb_fts_prefix_len(const char *s, size_t n)
+{
+    if (n <= MSGDB_FTS_PREFIX_MAX)
+        return n;
+
+    n = MSGDB_FTS_PREFIX_MAX;
+    while (n && ((unsigned char)s[n] & 0xC0) == 0x80)
+        n--;
+
+    return n;
+}
+
+/*
+ * Build the FTS5 query: every word of `text` becomes a quoted prefix term,
+ * so user input can never be parsed as FTS5 syntax. A prefix query FTS5
+ * cannot answer from its prefix index makes it merge the doclists of all
+ * matching terms before returning the first row - tens of ms for a common
+ * word - so longer words are cut to their indexed prefix here and checked
+ * in full by msgdb_row_has_words(). A callsign is matched as a phrase in
+ * the source/destination columns, letting FTS5 narrow the rows before the
+ * exact comparison in SQL. Returns the number of words.
+ */
+static inline int msgdb_fts_query(const char *text, const char *callsign, char *out, size_t size)
+{
+    size_t o = 0, n;
+    int terms = 0;
+    const char *p = text;
+
+    out[0] = 0;
+
+    if (callsign && callsign[0])
+    {
+        if (size < 32)
+            return 0;
+        strcpy(out, "{source destination} : ");
+        o = strlen(out);
+        if (!msgdb_fts_quote(out, size, &o, callsign, strlen(callsign)))
+            return 0;
+    }
+
+    while ((n = msgdb_next_word(&p)) > 0)
+    {
+        size_t save = o;
+        if (o + 2 >= size)
+            break;
+        if (o)
+            out[o++] = ' ';
+        if (!msgdb_fts_quote(out, size, &o, p, msgdb_fts_prefix_len(p, n)) || o + 1 >= size)
+        {
+            out[save] = 0; // the rest of the words do not fit
+            break;
+        }
+        out[o++] = '*';
+        out[o] = 0;
+
+        terms++;
+        p += n;
+    }
+
+    return terms;
+}
+
+static inline bool msgdb_is_word_char(char c)
+{
+    // bytes of multibyte UTF-8 characters count as letters, as in unicode61
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c & 0x80);
+}
+
+static inline char msgdb_lower(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+// does a token of `s` start with the word `w` (`n` bytes), ASCII case-insensitive
+static inline bool msgdb_has_prefix(const char *s, const char *w, size_t n)
+{
+    for (size_t i = 0; s && s[i]; i++)
+    {
+        if (i && msgdb_is_word_char(s[i - 1]))
+            continue;
+
+        size_t k = 0;
+        while (k < n && s[i + k] && msgdb_lower(s[i + k]) == msgdb_lower(w[k]))
+            k++;
+        if (k == n)
+            return true;
+    }
+
+    return false;
+}
+
+/*
+ * Check the words cut by msgdb_fts_query() against the row. Folding is
+ * ASCII only, so an accented word longer than the indexed prefix has to
+ * be typed as stored.
+ */
+static inline bool msgdb_row_has_words(const char *text, const char *const cols[3])
+{
+    const char *p = text;
+    size_t n;
+
+    while ((n = msgdb_next_word(&p)) > 0)
+    {
+        if (msgdb_fts_prefix_len(p, n) < n &&
+            !msgdb_has_prefix(cols[0], p, n) && !msgdb_has_prefix(cols[1], p, n) && !msgdb_has_prefix(cols[2], p, n))
+            return false;
+        p += n;
+    }
+
+    return true;
+}
+
+// true if any word of `text` is longer than its indexed prefix
+static inline bool msgdb_needs_check(const char *text)
+{
+    const char *p = text;
+    size_t n;
+
+    while ((n = msgdb_next_word(&p)) > 0)
+    {
+        if (msgdb_fts_prefix_len(p, n) < n)
+            return true;
+        p += n;
+    }
+
+    return false;
+}
+
+/*
+ * Newest-first search of the text messages with keyset paging: pass
+ * `next_id` as `before_id` to get the next page. Returns the number of rows
+ * passed to `cb`, or -1 on error.
+ *
+ * A word longer than the indexed prefix that (nearly) never occurs in full,
+ * e.g. "messages" when every row says "message", would otherwise scan the
+ * whole doclist of its prefix for one page. After MSGDB_SEARCH_MAX_SKIP
+ * rejected rows the page is returned short, with `next_id` where the scan
+ * stopped.
+ */
+static inline int msgdb_search(sqlite3 *db, msgdb_query_t *q, msgdb_row_cb cb, void *arg)
+{
+    char match[2 * MSGDB_SEARCH_MAX_TEXT];
+    sqlite3_stmt *stmt;
+    const char *sql;
+    int rows = 0, skipped = 0, rc;
+
+    q->next_id = 0;
+
+    int limit = q->limit > 0 ? q->limit : 20;
+    int has_call = q->callsign && q->callsign[0];
+    int has_text = q->text && msgdb_fts_query(q->text, has_call ? q->callsign : NULL, match, sizeof(match)) > 0;
+    // the FTS5 match may return rows the full words rule out, so the limit
+    // is applied here - rows are produced lazily, newest first
+    int check = has_text && msgdb_needs_check(q->text);
+
+    if (has_text)
+        sql = "SELECT " MSGDB_SEARCH_COLS " FROM messages_fts f JOIN messages m ON m.id = f.rowid "
+              "WHERE messages_fts MATCH ?1 AND f.rowid < ?3 "
+              "AND (?2 IS NULL OR m.source = ?2 OR m.destination = ?2) "
+              "ORDER BY f.rowid DESC LIMIT ?4;";
+    else if (has_call)
+        sql = "SELECT " MSGDB_SEARCH_COLS " FROM messages m WHERE m.source = ?2 AND m.id < ?3 AND " MSGDB_TEXT_ROW " "
+              "UNION ALL "
+              "SELECT " MSGDB_SEARCH_COLS " FROM messages m WHERE m.destination = ?2 AND m.source IS NOT ?2 AND m.id < ?3 "
+              "AND " MSGDB_TEXT_ROW " "
+              "ORDER BY 1 DESC LIMIT ?4;";
+    else
+        sql = "SELECT " MSGDB_SEARCH_COLS " FROM messages m WHERE m.id < ?3 AND " MSGDB_TEXT_ROW " "
+              "ORDER BY m.id DESC LIMIT ?4;";
+
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        fprintf(stderr, "Message search failed: %s\n", sqlite3_errmsg(db));
+        return -1;
+    }
+
+    if (has_text)
+        sqlite3_bind_text(stmt, 1, match, -1, SQLITE_STATIC);
+    if (has_call)
+        sqlite3_bind_text(stmt, 2, q->callsign, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 3, q->before_id > 0 ? q->before_id : INT64_MAX);
+    sqlite3_bind_int(stmt, 4, check ? -1 : limit);
+
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        msgdb_row_t row;
+
+        row.id = sqlite3_column_int64(stmt, 0);
+        row.timestamp = sqlite3_column_int64(stmt, 1);
+        row.protocol = (const char *)sqlite3_column_text(stmt, 2);
+        row.source = (const char *)sqlite3_column_text(stmt, 3);
+        row.destination = (const char *)sqlite3_column_text(stmt, 4);
+        row.message = (const char *)sqlite3_column_text(stmt, 5);
+        row.meta = sqlite3_column_blob(stmt, 6);
+        row.meta_len = sqlite3_column_bytes(stmt, 6);
+        row.read = sqlite3_column_int(stmt, 7);
+
+        if (check)
+        {
+            const char *cols[3] = {row.source, row.destination, row.message};
+            if (!msgdb_row_has_words(q->text, cols))
+            {
+                if (++skipped < MSGDB_SEARCH_MAX_SKIP)
+                    continue;
+                q->next_id = row.id;
+                break;
+            }
+        }
+
+        rows++;
+        if (cb(arg, &row) || rows >= limit)
+        {
+            q->next_id = row.id;
+            break;
+        }
+    }
+
+    if (rc != SQLITE_ROW && rc != SQLITE_DONE)
+    {
+        fprintf(stderr, "Message search failed: %s\n", sqlite3_errmsg(db));
+        q->next_id = 0;
+        rows = -1;
+    }
+
+    sqlite3_finalize(stmt);
+    return rows;
+}
+
+#endif // MSGDB_H
@@ -0,0 +1,464 @@
+/*
+ * GNU Radio PMT serialization - writer and streaming reader
+ *
+ * The GR flowgraphs and our own tools exchange messages as serialized PMTs
+ * (pmt::serialize_str() on the GR side). Only the wire format is needed here,
+ * so this is a header-only, allocation-free implementation working directly
+ * on caller-provided buffers.
+ *
+ * Writer: pmt_writer_init() on a buffer, then pmt_put_*() in prefix order.
+ * A pair is pmt_put_pair() followed by its car and cdr, a dict is
+ * pmt_put_dict() followed by one key/value pair and the rest of the dict
+ * (another dict node or null). On overflow the writer sets `err` and stops
+ * writing, so a whole message can be built and checked once at the end.
+ *
+ * Reader: pmt_next() returns one token at a time in the same prefix order.
+ * Containers only report their tag (and element count), the elements follow
+ * as separate tokens. Every read is bounds checked; truncated or malformed
+ * input makes pmt_next() return -1 and never touches memory past `len`.
+ * Strings and vectors are returned as pointers into the input buffer - they
+ * are not null terminated.
+ *
+ * Multi-byte values are big-endian on the wire.
+ */
+#ifndef PMT_H
+#define PMT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+
+// serialization tags
+typedef enum
+{
+    PMT_TRUE = 0x00,
+    PMT_FALSE = 0x01,
+    PMT_SYMBOL = 0x02,
+    PMT_INT32 = 0x03,
+    PMT_DOUBLE = 0x04,
+    PMT_COMPLEX = 0x05,
+    PMT_NULL = 0x06,
+    PMT_PAIR = 0x07,
+    PMT_VECTOR = 0x08,
+    PMT_DICT = 0x09,
+    PMT_UNIFORM_VECTOR = 0x0A,
+    PMT_UINT64 = 0x0B,
+    PMT_TUPLE = 0x0C,
+    PMT_INT64 = 0x0D
+} pmt_tag_t;
+
+// uniform vector item types
+typedef enum
+{
+    PMT_UV_U8 = 0x00,
+    PMT_UV_S8,
+    PMT_UV_U16,
+    PMT_UV_S16,
+    PMT_UV_U32,
+    PMT_UV_S32,
+    PMT_UV_U64,
+    PMT_UV_S64,
+    PMT_UV_F32,
+    PMT_UV_F64,
+    PMT_UV_C32,
+    PMT_UV_C64
+} pmt_uv_type_t;
+
+#define PMT_SYMBOL_MAX 0xFFFF
+
+typedef struct
+{
+    uint8_t *buf;
+    size_t cap;
+    size_t len;
+    bool err; // ran out of space
+} pmt_writer_t;
+
+typedef struct
+{
+    const uint8_t *buf;
+    size_t len;
+    size_t pos;
+} pmt_reader_t;
+
+typedef struct
+{
+    uint8_t tag;         // pmt_tag_t
+    uint8_t uv_type;     // pmt_uv_type_t, PMT_UNIFORM_VECTOR only
+    uint32_t len;        // symbol: bytes, (uniform) vector/tuple: items
+    const uint8_t *data; // symbol text or uniform vector items (big-endian)
+    union
+    {
+        int64_t i;       // PMT_INT32, PMT_INT64
+        uint64_t u;      // PMT_UINT64
+        double d;        // PMT_DOUBLE
+        double c[2];     // PMT_COMPLEX
+    } v;
+} pmt_item_t;
+
+static inline void pmt_wr_be(uint8_t *p, uint64_t v, int n)
+{
+    for (int i = n - 1; i >= 0; i--, v >>= 8)
+        p[i] = (uint8_t)v;
+}
+
+static inline uint64_t pmt_rd_be(const uint8_t *p, int n)
+{
+    uint64_t v = 0;
+    for (int i = 0; i < n; i++)
+        v = (v << 8) | p[i];
+    return v;
+}
+
+static inline size_t pmt_uv_item_size(uint8_t uv_type)
+{
+    static const uint8_t sz[] = {1, 1, 2, 2, 4, 4, 8, 8, 4, 8, 8, 16};
+    return uv_type < sizeof(sz) ? sz[uv_type] : 0;
+}
+
+// ---------------------------------------------------------------- writer
+
+static inline void pmt_writer_init(pmt_writer_t *w, uint8_t *buf, size_t cap)
+{
+    w->buf = buf;
+    w->cap = cap;
+    w->len = 0;
+    w->err = false;
+}
+
+// reserve `n` bytes, NULL (and `err` set) if they do not fit
+static inline uint8_t *pmt_reserve(pmt_writer_t *w, size_t n)
+{
+    if (w->err || n > w->cap - w->len)
+    {
+        w->err = true;
+        return NULL;
+    }
+
+    uint8_t *p = w->buf + w->len;
+    w->len += n;
+    return p;
+}
+
+static inline void pmt_put_tag(pmt_writer_t *w, uint8_t tag)
+{
+    uint8_t *p = pmt_reserve(w, 1);
+    if (p)
+        p[0] = tag;
+}
+
+static inline void pmt_put_null(pmt_writer_t *w) { pmt_put_tag(w, PMT_NULL); }
+static inline void pmt_put_pair(pmt_writer_t *w) { pmt_put_tag(w, PMT_PAIR); }
+static inline void pmt_put_dict(pmt_writer_t *w) { pmt_put_tag(w, PMT_DICT); }
+
+static inline void pmt_put_bool(pmt_writer_t *w, bool v)
+{
+    pmt_put_tag(w, v ? PMT_TRUE : PMT_FALSE);
+}
+
+static inline void pmt_put_symbol_n(pmt_writer_t *w, const char *s, size_t n)
+{
+    uint8_t *p;
+
+    if (n > PMT_SYMBOL_MAX || (p = pmt_reserve(w, 3 + n)) == NULL)
+    {
+        w->err = true;
+        return;
+    }
+
+    p[0] = PMT_SYMBOL;
+    pmt_wr_be(&p[1], n, 2);
+    memcpy(&p[3], s, n);
+}
+
+static inline void pmt_put_symbol(pmt_writer_t *w, const char *s)
+{
+    pmt_put_symbol_n(w, s, strlen(s));
+}
+
+static inline void pmt_put_int32(pmt_writer_t *w, int32_t v)
+{
+    uint8_t *p = pmt_reserve(w, 5);
+    if (p)
+    {
+        p[0] = PMT_INT32;
+        pmt_wr_be(&p[1], (uint32_t)v, 4);
+    }
+}
+
+static inline void pmt_put_int64(pmt_writer_t *w, int64_t v)
+{
+    uint8_t *p = pmt_reserve(w, 9);
+    if (p)
+    {
+        p[0] = PMT_INT64;
+        pmt_wr_be(&p[1], (uint64_t)v, 8);
+    }
+}
+
+static inline void pmt_put_uint64(pmt_writer_t *w, uint64_t v)
+{
+    uint8_t *p = pmt_reserve(w, 9);
+    if (p)
+    {
+        p[0] = PMT_UINT64;
+        pmt_wr_be(&p[1], v, 8);
+    }
+}
+
+static inline void pmt_put_double(pmt_writer_t *w, double v)
+{
+    uint8_t *p = pmt_reserve(w, 9);
+    uint64_t u;
+
+    if (p)
+    {
+        memcpy(&u, &v, sizeof(u));
+        p[0] = PMT_DOUBLE;
+        pmt_wr_be(&p[1], u, 8);
+    }
+}
+
+// `n` elements follow
+static inline void pmt_put_tuple(pmt_writer_t *w, uint32_t n)
+{
+    uint8_t *p = pmt_reserve(w, 5);
+    if (p)
+    {
+        p[0] = PMT_TUPLE;
+        pmt_wr_be(&p[1], n, 4);
+    }
+}
+
+static inline void pmt_put_vector(pmt_writer_t *w, uint32_t n)
+{
+    uint8_t *p = pmt_reserve(w, 5);
+    if (p)
+    {
+        p[0] = PMT_VECTOR;
+        pmt_wr_be(&p[1], n, 4);
+    }
+}
+
+// GR writes one padding byte after the header, the reader accepts any amount
+static inline void pmt_put_u8vector(pmt_writer_t *w, const uint8_t *data, uint32_t n)
+{
+    uint8_t *p = pmt_reserve(w, 8 + (size_t)n);
+    if (p)
+    {
+        p[0] = PMT_UNIFORM_VECTOR;
+        p[1] = PMT_UV_U8;
+        pmt_wr_be(&p[2], n, 4);
+        p[6] = 1; // padding length
+        p[7] = 0;
+        memcpy(&p[8], data, n);
+    }
+}
+
+// whole message: a single symbol, returns its length or 0 if it does not fit
+static inline size_t pmt_symbol(uint8_t *buf, size_t cap, const char *s)
+{
+    pmt_writer_t w;
+
+    pmt_writer_init(&w, buf, cap);
+    pmt_put_symbol(&w, s);
+
+    return w.err ? 0 : w.len;
+}
+
+// ---------------------------------------------------------------- reader
+
+static inline void pmt_reader_init(pmt_reader_t *r, const void *buf, size_t len)
+{
+    r->buf = (const uint8_t *)buf;
+    r->len = len;
+    r->pos = 0;
+}
+
+// 1 - token read, 0 - end of input, -1 - malformed/truncated input
+static inline int pmt_next(pmt_reader_t *r, pmt_item_t *it)
+{
+    size_t left = r->len - r->pos;
+    const uint8_t *p = r->buf + r->pos;
+    size_t n = 1; // bytes consumed
+
+    if (left == 0)
+        return 0;
+
+    memset(it, 0, sizeof(*it));
+    it->tag = p[0];
+
+    switch (it->tag)
+    {
+    case PMT_TRUE:
+    case PMT_FALSE:
+    case PMT_NULL:
+    case PMT_PAIR:
+    case PMT_DICT:
+        break;
+
+    case PMT_SYMBOL:
+        if (left < 3)
+            return -1;
+        it->len = (uint32_t)pmt_rd_be(&p[1], 2);
+        n = 3 + (size_t)it->len;
+        it->data = &p[3];
+        break;
+
+    case PMT_INT32:
+        n = 5;
+        if (left >= n)
+            it->v.i = (int32_t)pmt_rd_be(&p[1], 4);
+        break;
+
+    case PMT_INT64:
+    case PMT_UINT64:
+    case PMT_DOUBLE:
+        n = 9;
+        if (left >= n)
+        {
+            uint64_t u = pmt_rd_be(&p[1], 8);
+            if (it->tag == PMT_INT64)
+                it->v.i = (int64_t)u;
+            else if (it->tag == PMT_DOUBLE)
+                memcpy(&it->v.d, &u, sizeof(double));
+            else
+                it->v.u = u;
+        }
+        break;
+
+    case PMT_COMPLEX:
+        n = 17;
+        if (left >= n)
+        {
+            uint64_t re = pmt_rd_be(&p[1], 8), im = pmt_rd_be(&p[9], 8);
+            memcpy(&it->v.c[0], &re, sizeof(double));
+            memcpy(&it->v.c[1], &im, sizeof(double));
+        }
+        break;
+
+    case PMT_VECTOR:
+    case PMT_TUPLE:
+        n = 5;
+        if (left >= n)
+            it->len = (uint32_t)pmt_rd_be(&p[1], 4);
+        break;
+
+    case PMT_UNIFORM_VECTOR:
+    {
+        size_t isz, npad, avail;
+
+        if (left < 7)
+            return -1;
+        it->uv_type = p[1];
+        it->len = (uint32_t)pmt_rd_be(&p[2], 4);
+        npad = p[6];
+        isz = pmt_uv_item_size(it->uv_type);
+        avail = left - 7;
+        if (isz == 0 || npad > avail || it->len > (avail - npad) / isz)
+            return -1;
+        n = 7 + npad + (size_t)it->len * isz;
+        it->data = &p[7 + npad];
+        break;
+    }
+
+    default:
+        return -1;
+    }
+
+    if (n > left)
+        return -1;
+
+    r->pos += n;
+    return 1;
+}
+
+// number of child values that follow a token
+static inline uint32_t pmt_children(const pmt_item_t *it)
+{
+    switch (it->tag)
+    {
+    case PMT_PAIR:
+    case PMT_DICT:
+        return 2;
+    case PMT_VECTOR:
+    case PMT_TUPLE:
+        return it->len;
+    default:
+        return 0;
+    }
+}
+
+// skip the children of an already read token, so the next pmt_next() returns
+// its sibling; iterative, nesting depth is not limited by the stack
+static inline int pmt_skip(pmt_reader_t *r, const pmt_item_t *it)
+{
+    uint64_t pending = pmt_children(it);
+    pmt_item_t c;
+
+    while (pending)
+    {
+        if (pmt_next(r, &c) != 1)
+            return -1;
+        pending = pending - 1 + pmt_children(&c);
+    }
+
+    return 0;
+}
+
+static inline bool pmt_symbol_eq(const pmt_item_t *it, const char *s)
+{
+    size_t n = strlen(s);
+    return it->tag == PMT_SYMBOL && it->len == n && memcmp(it->data, s, n) == 0;
+}
+
+// copy a symbol as a C string, truncating to `size`; false if not a symbol
+static inline bool pmt_symbol_str(const pmt_item_t *it, char *dst, size_t size)
+{
+    size_t n;
+
+    if (it->tag != PMT_SYMBOL || size == 0)
+        return false;
+
+    n = it->len < size - 1 ? it->len : size - 1;
+    memcpy(dst, it->data, n);
+    dst[n] = 0;
+    return true;
+}
+
+/*
+ * Walk a dict or a list of pairs with symbol keys, e.g. the messages coming
+ * from the M17 flowgraphs: DICT PAIR key value DICT PAIR key value ... NULL.
+ * Returns 1 with the next key and value, 0 at the end, -1 on malformed input.
+ * Container values are skipped - `val` only holds their tag and item count.
+ */
+static inline int pmt_next_kv(pmt_reader_t *r, pmt_item_t *key, pmt_item_t *val)
+{
+    int ret;
+
+    while ((ret = pmt_next(r, key)) == 1)
+    {
+        if (key->tag == PMT_DICT || key->tag == PMT_PAIR || key->tag == PMT_NULL)
+            continue; // structure, the keys are inside
+
+        if (key->tag != PMT_SYMBOL)
+        {
+            // not a key/value layout we know - skip the whole value
+            if (pmt_skip(r, key) != 0)
+                return -1;
+            continue;
+        }
+
+        if (pmt_next(r, val) != 1)
+            return -1;
+        if (pmt_skip(r, val) != 0)
+            return -1;
+
+        return 1;
+    }
+
+    return ret;
+}
+
+#endif // PMT_H
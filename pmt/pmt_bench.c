@@ -0,0 +1,133 @@
+/*
+ * PMT reader/writer throughput on the messages the tools actually exchange
+ *
+ *   pmt_bench [iterations]
+ *
+ * ptt      - symbol "SOT", read and compared (ptt_msg, zmq_proxy)
+ * meta     - 5-key dict walked with pmt_next_kv() (M17 flowgraph metadata)
+ * packet   - pair of the meta dict and an 822 byte u8vector, skipped over
+ * build    - the meta dict written with pmt_put_*()
+ */
+#include "pmt.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void put_kv_sym(pmt_writer_t *w, const char *k, const char *v)
+{
+    pmt_put_dict(w);
+    pmt_put_pair(w);
+    pmt_put_symbol(w, k);
+    pmt_put_symbol(w, v);
+}
+
+static void put_kv_int(pmt_writer_t *w, const char *k, int32_t v)
+{
+    pmt_put_dict(w);
+    pmt_put_pair(w);
+    pmt_put_symbol(w, k);
+    pmt_put_int32(w, v);
+}
+
+static void build_meta(pmt_writer_t *w)
+{
+    put_kv_sym(w, "src", "SP5WWP");
+    put_kv_sym(w, "dst", "@ALL");
+    put_kv_int(w, "type", 5);
+    put_kv_int(w, "can", 0);
+    put_kv_sym(w, "meta", "0123456789abcd");
+    pmt_put_null(w);
+}
+
+// keep the compiler from dropping the loops
+static volatile uint64_t sink;
+
+static void report(const char *name, double t0, unsigned long n, size_t bytes)
+{
+    double ns = (now_ns() - t0) / n;
+    printf("%-8s %4zu B  %8.1f ns/msg  %8.1f MB/s\n", name, bytes, ns, bytes / ns * 1e3);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned long n = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+    uint8_t ptt[16], meta[256], packet[1200], payload[822];
+    size_t ptt_len, meta_len, packet_len;
+    pmt_writer_t w;
+    pmt_reader_t r;
+    pmt_item_t it, val;
+    double t0;
+
+    if (n == 0)
+    {
+        fprintf(stderr, "Usage: %s [iterations > 0]\n", argv[0]);
+        return 1;
+    }
+
+    ptt_len = pmt_symbol(ptt, sizeof(ptt), "SOT");
+
+    pmt_writer_init(&w, meta, sizeof(meta));
+    build_meta(&w);
+    meta_len = w.len;
+
+    for (size_t i = 0; i < sizeof(payload); i++)
+        payload[i] = i;
+    pmt_writer_init(&w, packet, sizeof(packet));
+    pmt_put_pair(&w);
+    build_meta(&w);
+    pmt_put_u8vector(&w, payload, sizeof(payload));
+    packet_len = w.len;
+
+    if (!ptt_len || w.err)
+    {
+        fprintf(stderr, "test messages do not fit\n");
+        return 1;
+    }
+
+    printf("%lu iterations\n", n);
+
+    t0 = now_ns();
+    for (unsigned long k = 0; k < n; k++)
+    {
+        pmt_reader_init(&r, ptt, ptt_len);
+        sink += pmt_next(&r, &it) == 1 && pmt_symbol_eq(&it, "SOT");
+    }
+    report("ptt", t0, n, ptt_len);
+
+    t0 = now_ns();
+    for (unsigned long k = 0; k < n; k++)
+    {
+        pmt_reader_init(&r, meta, meta_len);
+        while (pmt_next_kv(&r, &it, &val) == 1)
+            sink += val.tag;
+    }
+    report("meta", t0, n, meta_len);
+
+    t0 = now_ns();
+    for (unsigned long k = 0; k < n; k++)
+    {
+        pmt_reader_init(&r, packet, packet_len);
+        if (pmt_next(&r, &it) == 1 && pmt_skip(&r, &it) == 0)
+            sink += r.pos;
+    }
+    report("packet", t0, n, packet_len);
+
+    t0 = now_ns();
+    for (unsigned long k = 0; k < n; k++)
+    {
+        pmt_writer_init(&w, meta, sizeof(meta));
+        build_meta(&w);
+        sink += w.len;
+    }
+    report("build", t0, n, meta_len);
+
+    return 0;
+}
@@ -0,0 +1,184 @@
+/*
+ * Fuzz target for the PMT reader: pmt_next(), pmt_skip() and pmt_next_kv()
+ * over arbitrary bytes, checking that no token ever points outside the input
+ * and that symbols survive a write/read round trip.
+ *
+ * libFuzzer:  make fuzz && ./pmt_fuzz corpus/
+ * AFL:        make fuzz-afl CC=afl-clang-fast && afl-fuzz -i seeds -o out ./pmt_fuzz_afl
+ * gcc only:   make fuzz-afl && ./pmt_fuzz_afl -r 1000000   (random inputs)
+ *
+ * The AFL build reads one input from each file argument, or from stdin, so
+ * it also replays crashes found by either fuzzer.
+ */
+#include "pmt.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CHECK(c) do { if (!(c)) { fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #c); abort(); } } while (0)
+
+// a token returned by the reader must lie inside the bytes it consumed
+static void check_item(const pmt_reader_t *r, size_t start, const pmt_item_t *it)
+{
+    const uint8_t *end = r->buf + r->pos;
+
+    CHECK(r->pos > start && r->pos <= r->len);
+
+    if (it->tag == PMT_SYMBOL)
+    {
+        CHECK(it->data >= r->buf + start && it->data + it->len == end);
+    }
+    else if (it->tag == PMT_UNIFORM_VECTOR)
+    {
+        size_t isz = pmt_uv_item_size(it->uv_type);
+        CHECK(isz != 0);
+        CHECK(it->data >= r->buf + start && it->data + (size_t)it->len * isz == end);
+    }
+}
+
+// write a symbol read from the input and read it back
+static void check_symbol(const pmt_item_t *it)
+{
+    static uint8_t buf[PMT_SYMBOL_MAX + 3];
+    pmt_writer_t w;
+    pmt_reader_t r;
+    pmt_item_t back;
+    char s[8];
+
+    pmt_writer_init(&w, buf, sizeof(buf));
+    pmt_put_symbol_n(&w, (const char *)it->data, it->len);
+    CHECK(!w.err && w.len == 3 + (size_t)it->len);
+
+    pmt_reader_init(&r, buf, w.len);
+    CHECK(pmt_next(&r, &back) == 1 && back.tag == PMT_SYMBOL && back.len == it->len);
+    CHECK(memcmp(back.data, it->data, it->len) == 0);
+
+    // truncating copy must stay inside `s`
+    CHECK(pmt_symbol_str(it, s, sizeof(s)));
+    CHECK(strlen(s) <= sizeof(s) - 1);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    pmt_reader_t r;
+    pmt_item_t it, val;
+    size_t start;
+    int ret;
+
+    // token by token, as the tools that look at one message type do
+    pmt_reader_init(&r, data, size);
+    for (start = r.pos; (ret = pmt_next(&r, &it)) == 1; start = r.pos)
+    {
+        check_item(&r, start, &it);
+        if (it.tag == PMT_SYMBOL)
+            check_symbol(&it);
+    }
+    CHECK(ret == 0 || ret == -1);
+    CHECK(r.pos <= r.len);
+
+    // sibling by sibling
+    pmt_reader_init(&r, data, size);
+    for (start = r.pos; (ret = pmt_next(&r, &it)) == 1; start = r.pos)
+    {
+        check_item(&r, start, &it);
+        if (pmt_skip(&r, &it) != 0)
+            break;
+        CHECK(r.pos <= r.len);
+    }
+    CHECK(r.pos <= r.len);
+
+    // key/value walk, as the M17 message consumers do
+    pmt_reader_init(&r, data, size);
+    while ((ret = pmt_next_kv(&r, &it, &val)) == 1)
+    {
+        CHECK(it.tag == PMT_SYMBOL);
+        CHECK(it.data >= r.buf && it.data + it.len <= r.buf + r.pos);
+        CHECK(r.pos <= r.len);
+    }
+    CHECK(ret == 0 || ret == -1);
+
+    return 0;
+}
+
+#ifdef PMT_FUZZ_MAIN
+// run one input from an exactly sized heap buffer, so ASan sees any overread
+static void run(const uint8_t *data, size_t size)
+{
+    uint8_t *copy = malloc(size ? size : 1);
+    memcpy(copy, data, size);
+    LLVMFuzzerTestOneInput(copy, size);
+    free(copy);
+}
+
+// random inputs biased towards valid tags and short lengths
+static void run_random(unsigned long iterations)
+{
+    static const uint8_t seeds[][16] =
+    {
+        { PMT_SYMBOL, 0, 3, 'S', 'O', 'T' },
+        { PMT_DICT, PMT_PAIR, PMT_SYMBOL, 0, 1, 'k', PMT_INT32, 0, 0, 0, 1, PMT_NULL },
+        { PMT_VECTOR, 0, 0, 0, 2, PMT_TRUE, PMT_FALSE },
+        { PMT_UNIFORM_VECTOR, PMT_UV_U8, 0, 0, 0, 4, 1, 0, 1, 2, 3, 4 },
+    };
+    uint8_t buf[64];
+
+    srand(1);
+    for (unsigned long k = 0; k < iterations; k++)
+    {
+        size_t n = rand() % sizeof(buf);
+
+        if (k & 1)
+        {
+            // mutate a seed
+            memcpy(buf, seeds[rand() % 4], 16);
+            memset(buf + 16, 0, sizeof(buf) - 16);
+            for (int m = rand() % 4; m >= 0; m--)
+                buf[rand() % 16] = rand() % 16;
+            n = rand() % 17;
+        }
+        else
+        {
+            for (size_t i = 0; i < n; i++)
+                buf[i] = rand() % 16;
+        }
+
+        run(buf, n);
+    }
+}
+
+static void run_file(FILE *f)
+{
+    static uint8_t buf[1 << 20];
+    size_t n = fread(buf, 1, sizeof(buf), f);
+    run(buf, n);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc == 3 && strcmp(argv[1], "-r") == 0)
+    {
+        run_random(strtoul(argv[2], NULL, 10));
+        return 0;
+    }
+
+    if (argc == 1)
+    {
+        run_file(stdin);
+        return 0;
+    }
+
+    for (int i = 1; i < argc; i++)
+    {
+        FILE *f = fopen(argv[i], "rb");
+        if (f == NULL)
+        {
+            perror(argv[i]);
+            return 1;
+        }
+        run_file(f);
+        fclose(f);
+    }
+
+    return 0;
+}
+#endif
@@ -0,0 +1,378 @@
+/*
+ * SX1255 control broker - protocol and client side
+ *
+ * The SX1255 sits on one SPI bus and one reset GPIO, and libgpiod line
+ * requests are exclusive. Only one process can therefore own the chip.
+ * sx1255d is that owner; every other program (GUI, Soapy driver,
+ * sx1255-spi) sends it small fixed-size requests over ZeroMQ REQ/REP.
+ * The REP socket handles one request at a time, so commands coming from
+ * different processes can never interleave on the bus.
+ *
+ * sx1255_ctrl_open() connects to the broker if one answers a ping. Otherwise
+ * it falls back to opening the chip directly through libsx1255, as the tools
+ * did before. Callers always go through the sx1255_ctrl_*() wrappers and do
+ * not need to know which path is in use.
+ *
+ * Every wrapper returns 0 on success and a negative value if the broker
+ * reported an error or did not answer; the failure is also logged to stderr.
+ * Register reads return the value through a pointer, so a failed read can
+ * not be mistaken for a register full of zeros.
+ */
+#ifndef SX1255_CTRL_H
+#define SX1255_CTRL_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <zmq.h>
+#include <sx1255.h>
+
+#define SX1255_CTRL_IPC "ipc:///tmp/sx1255_ctrl"
+#define SX1255_CTRL_TIMEOUT_MS 100        // broker ping timeout
+#define SX1255_CTRL_REPLY_TIMEOUT_MS 2000 // command reply timeout, long enough for a reset
+                                          // queued behind other clients' requests
+
+typedef enum
+{
+    SX1255_CMD_PING = 0,
+    SX1255_CMD_RESET,
+    SX1255_CMD_SET_RATE,
+    SX1255_CMD_SET_RX_FREQ,
+    SX1255_CMD_SET_TX_FREQ,
+    SX1255_CMD_SET_LNA_GAIN,
+    SX1255_CMD_SET_PGA_GAIN,
+    SX1255_CMD_SET_DAC_GAIN,
+    SX1255_CMD_SET_MIX_GAIN,
+    SX1255_CMD_SET_RX_PLL_BW,
+    SX1255_CMD_SET_TX_PLL_BW,
+    SX1255_CMD_ENABLE_RX,
+    SX1255_CMD_ENABLE_TX,
+    SX1255_CMD_RF_LOOPBACK,
+    SX1255_CMD_GET_VERSION,
+    SX1255_CMD_READ_REG,
+    SX1255_CMD_WRITE_REG,
+    SX1255_CMD_UPDATE_REG, // atomic read-modify-write: reg = (reg & ~mask) | (val & mask)
+    SX1255_CMD_COUNT
+} sx1255_cmd_t;
+
+// both ends always run on the same machine - native byte order is fine
+typedef union
+{
+    uint32_t u;
+    int32_t i;
+    float f;
+} sx1255_arg_t;
+
+typedef struct __attribute__((packed))
+{
+    uint8_t cmd;
+    uint8_t addr; // register address (*_REG commands)
+    uint8_t mask; // bit mask (SX1255_CMD_UPDATE_REG)
+    uint8_t val;  // register value (*_REG commands)
+    sx1255_arg_t arg;
+} sx1255_req_t;
+
+typedef struct __attribute__((packed))
+{
+    int8_t retval; // 0 - OK, negative - error
+    uint8_t val;   // register readout / chip version
+} sx1255_rep_t;
+
+typedef struct
+{
+    void *sock; // NULL - direct libsx1255 access, no broker
+    bool opened;
+} sx1255_ctrl_t;
+
+// single request/reply round trip, returns the broker's retval or -1 on IPC failure
+static inline int8_t sx1255_ctrl_xfer(sx1255_ctrl_t *c, uint8_t cmd, uint8_t addr, uint8_t mask,
+                                      uint8_t val, sx1255_arg_t arg, uint8_t *out)
+{
+    sx1255_req_t req;
+    sx1255_rep_t rep;
+
+    req.cmd = cmd;
+    req.addr = addr;
+    req.mask = mask;
+    req.val = val;
+    req.arg = arg;
+
+    if (zmq_send(c->sock, &req, sizeof(req), 0) != (int)sizeof(req))
+        return -1;
+
+    if (zmq_recv(c->sock, &rep, sizeof(rep), 0) != (int)sizeof(rep))
+        return -1;
+
+    if (out != NULL)
+        *out = rep.val;
+
+    return rep.retval;
+}
+
+// as sx1255_ctrl_xfer(), logging failures
+static inline int8_t sx1255_ctrl_call(sx1255_ctrl_t *c, uint8_t cmd, uint8_t addr, uint8_t mask,
+                                      uint8_t val, sx1255_arg_t arg, uint8_t *out)
+{
+    int8_t retval = sx1255_ctrl_xfer(c, cmd, addr, mask, val, arg, out);
+
+    if (retval != 0)
+        fprintf(stderr, "SX1255 broker: command %u failed (%s)\n", cmd,
+                retval == -1 && zmq_errno() == EAGAIN ? "no reply" : "error reply");
+
+    return retval;
+}
+
+static inline int8_t sx1255_ctrl_cmd_u(sx1255_ctrl_t *c, uint8_t cmd, uint32_t v)
+{
+    sx1255_arg_t arg;
+    arg.u = v;
+    return sx1255_ctrl_call(c, cmd, 0, 0, 0, arg, NULL);
+}
+
+// connect to the broker at `endpoint` (NULL - default) only, never touch the
+// chip directly; returns 0 if the broker answered a ping
+static inline int sx1255_ctrl_connect(sx1255_ctrl_t *c, void *zmq_ctx, const char *endpoint)
+{
+    c->sock = NULL;
+    c->opened = false;
+
+    void *s = zmq_socket(zmq_ctx, ZMQ_REQ);
+    if (s == NULL)
+        return -1;
+
+    int tmo = SX1255_CTRL_TIMEOUT_MS, zero = 0, one = 1;
+    zmq_setsockopt(s, ZMQ_RCVTIMEO, &tmo, sizeof(tmo));
+    zmq_setsockopt(s, ZMQ_SNDTIMEO, &tmo, sizeof(tmo));
+    zmq_setsockopt(s, ZMQ_LINGER, &zero, sizeof(zero));
+    // allow a new request after a lost reply
+    zmq_setsockopt(s, ZMQ_REQ_RELAXED, &one, sizeof(one));
+    zmq_setsockopt(s, ZMQ_REQ_CORRELATE, &one, sizeof(one));
+
+    c->sock = s;
+    sx1255_arg_t arg;
+    arg.u = 0;
+    // no broker is not an error here, the ping is not logged
+    if (zmq_connect(s, endpoint != NULL ? endpoint : SX1255_CTRL_IPC) == 0 &&
+        sx1255_ctrl_xfer(c, SX1255_CMD_PING, 0, 0, 0, arg, NULL) == 0)
+    {
+        // the broker is there, give the commands themselves more time
+        tmo = SX1255_CTRL_REPLY_TIMEOUT_MS;
+        zmq_setsockopt(s, ZMQ_RCVTIMEO, &tmo, sizeof(tmo));
+        c->opened = true;
+        return 0;
+    }
+
+    zmq_close(s);
+    c->sock = NULL;
+    return -1;
+}
+
+// connect to the broker at `endpoint` (NULL - default) or open the chip directly
+// if no broker answers; returns 0 on success
+static inline int sx1255_ctrl_open(sx1255_ctrl_t *c, void *zmq_ctx, const char *endpoint,
+                                   const char *spi_dev, const char *gpio_chip, uint16_t rst_pin)
+{
+    if (zmq_ctx != NULL && (endpoint == NULL || endpoint[0] != 0) &&
+        sx1255_ctrl_connect(c, zmq_ctx, endpoint) == 0)
+        return 0;
+
+    c->sock = NULL;
+    c->opened = false;
+
+    if (sx1255_init(spi_dev, gpio_chip, rst_pin) != 0)
+        return -1;
+
+    c->opened = true;
+    return 0;
+}
+
+static inline void sx1255_ctrl_close(sx1255_ctrl_t *c)
+{
+    if (!c->opened)
+        return;
+
+    if (c->sock != NULL)
+    {
+        zmq_close(c->sock);
+        c->sock = NULL;
+    }
+    else
+    {
+        sx1255_cleanup();
+    }
+
+    c->opened = false;
+}
+
+static inline bool sx1255_ctrl_brokered(const sx1255_ctrl_t *c)
+{
+    return c->sock != NULL;
+}
+
+// --- libsx1255-like API, dispatched to the broker or the local chip ---
+// all return 0 on success, negative on error (direct access cannot fail
+// except for the rate setting)
+static inline int8_t sx1255_ctrl_reset(sx1255_ctrl_t *c)
+{
+    if (c->sock)
+        return sx1255_ctrl_cmd_u(c, SX1255_CMD_RESET, 0);
+    sx1255_reset();
+    return 0;
+}
+
+static inline int8_t sx1255_ctrl_set_rate(sx1255_ctrl_t *c, sx1255_rate_t rate)
+{
+    if (c->sock)
+        return sx1255_ctrl_cmd_u(c, SX1255_CMD_SET_RATE, (uint32_t)rate);
+    return sx1255_set_rate(rate);
+}
+
+static inline int8_t sx1255_ctrl_set_rx_freq(sx1255_ctrl_t *c, uint32_t freq)
+{
+    if (c->sock)
+        return sx1255_ctrl_cmd_u(c, SX1255_CMD_SET_RX_FREQ, freq);
+    sx1255_set_rx_freq(freq);
+    return 0;
+}
+
+static inline int8_t sx1255_ctrl_set_tx_freq(sx1255_ctrl_t *c, uint32_t freq)
+{
+    if (c->sock)
+        return sx1255_ctrl_cmd_u(c, SX1255_CMD_SET_TX_FREQ, freq);
+    sx1255_set_tx_freq(freq);
+    return 0;
+}
+
+static inline int8_t sx1255_ctrl_set_lna_gain(sx1255_ctrl_t *c, uint8_t gain)
+{
+    if (c->sock)
+        return sx1255_ctrl_cmd_u(c, SX1255_CMD_SET_LNA_GAIN, gain);
+    sx1255_set_lna_gain(gain);
+    return 0;
+}
+
+static inline int8_t sx1255_ctrl_set_pga_gain(sx1255_ctrl_t *c, uint8_t gain)
+{
+    if (c->sock)
+        return sx1255_ctrl_cmd_u(c, SX1255_CMD_SET_PGA_GAIN, gain);
+    sx1255_set_pga_gain(gain);
+    return 0;
+}
+
+static inline int8_t sx1255_ctrl_set_dac_gain(sx1255_ctrl_t *c, int8_t gain)
+{
+    if (c->sock)
+    {
+        sx1255_arg_t arg;
+        arg.i = gain;
+        return sx1255_ctrl_call(c, SX1255_CMD_SET_DAC_GAIN, 0, 0, 0, arg, NULL);
+    }
+    sx1255_set_dac_gain(gain);
+    return 0;
+}
+
+static inline int8_t sx1255_ctrl_set_mixer_gain(sx1255_ctrl_t *c, float gain)
+{
+    if (c->sock)
+    {
+        sx1255_arg_t arg;
+        arg.f = gain;
+        return sx1255_ctrl_call(c, SX1255_CMD_SET_MIX_GAIN, 0, 0, 0, arg, NULL);
+    }
+    sx1255_set_mixer_gain(gain);
+    return 0;
+}
+
+static inline int8_t sx1255_ctrl_set_rx_pll_bw(sx1255_ctrl_t *c, uint16_t bw)
+{
+    if (c->sock)
+        return sx1255_ctrl_cmd_u(c, SX1255_CMD_SET_RX_PLL_BW, bw);
+    sx1255_set_rx_pll_bw(bw);
+    return 0;
+}
+
+static inline int8_t sx1255_ctrl_set_tx_pll_bw(sx1255_ctrl_t *c, uint16_t bw)
+{
+    if (c->sock)
+        return sx1255_ctrl_cmd_u(c, SX1255_CMD_SET_TX_PLL_BW, bw);
+    sx1255_set_tx_pll_bw(bw);
+    return 0;
+}
+
+static inline int8_t sx1255_ctrl_enable_rx(sx1255_ctrl_t *c, bool ena)
+{
+    if (c->sock)
+        return sx1255_ctrl_cmd_u(c, SX1255_CMD_ENABLE_RX, ena);
+    sx1255_enable_rx(ena);
+    return 0;
+}
+
+static inline int8_t sx1255_ctrl_enable_tx(sx1255_ctrl_t *c, bool ena)
+{
+    if (c->sock)
+        return sx1255_ctrl_cmd_u(c, SX1255_CMD_ENABLE_TX, ena);
+    sx1255_enable_tx(ena);
+    return 0;
+}
+
+static inline int8_t sx1255_ctrl_enable_rf_loopback(sx1255_ctrl_t *c, bool ena)
+{
+    if (c->sock)
+        return sx1255_ctrl_cmd_u(c, SX1255_CMD_RF_LOOPBACK, ena);
+    sx1255_enable_rf_loopback(ena);
+    return 0;
+}
+
+static inline int8_t sx1255_ctrl_get_chip_version(sx1255_ctrl_t *c, uint8_t *ver)
+{
+    if (c->sock)
+    {
+        sx1255_arg_t arg;
+        arg.u = 0;
+        return sx1255_ctrl_call(c, SX1255_CMD_GET_VERSION, 0, 0, 0, arg, ver);
+    }
+    *ver = sx1255_get_chip_version();
+    return 0;
+}
+
+static inline int8_t sx1255_ctrl_read_reg(sx1255_ctrl_t *c, uint8_t addr, uint8_t *val)
+{
+    if (c->sock)
+    {
+        sx1255_arg_t arg;
+        arg.u = 0;
+        return sx1255_ctrl_call(c, SX1255_CMD_READ_REG, addr, 0, 0, arg, val);
+    }
+    *val = sx1255_read_reg(addr);
+    return 0;
+}
+
+static inline int8_t sx1255_ctrl_write_reg(sx1255_ctrl_t *c, uint8_t addr, uint8_t val)
+{
+    if (c->sock)
+    {
+        sx1255_arg_t arg;
+        arg.u = 0;
+        return sx1255_ctrl_call(c, SX1255_CMD_WRITE_REG, addr, 0, val, arg, NULL);
+    }
+    sx1255_write_reg(addr, val);
+    return 0;
+}
+
+// read-modify-write; atomic with respect to other broker clients
+static inline int8_t sx1255_ctrl_update_reg(sx1255_ctrl_t *c, uint8_t addr, uint8_t mask, uint8_t val)
+{
+    if (c->sock)
+    {
+        sx1255_arg_t arg;
+        arg.u = 0;
+        return sx1255_ctrl_call(c, SX1255_CMD_UPDATE_REG, addr, mask, val, arg, NULL);
+    }
+
+    uint8_t tmp = sx1255_read_reg(addr);
+    sx1255_write_reg(addr, (uint8_t)((tmp & ~mask) | (val & mask)));
+    return 0;
+}
+
+#endif
@@ -1,4 +1,4 @@
-// Build with gcc sx1255-spi.c -o sx1255-spi -lm -lsx1255
+// Build with gcc sx1255-spi.c -o sx1255-spi -lm -lsx1255 -lzmq
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -9,6 +9,7 @@
 #include <getopt.h>
 
 #include <sx1255.h>
+#include "sx1255-ctrl.h"
 
 // --- Configuration ---
 const uint16_t rst_pin_offset = 22;
@@ -27,6 +28,10 @@ sx1255_rate_t rate;
 uint8_t addr;
 uint8_t val;
 
+// goes through sx1255d if it is running
+void *zmq_ctx;
+sx1255_ctrl_t rf;
+
 void print_help(const char *program_name)
 {
     printf("SX1255 config tool\n\n");
@@ -57,13 +62,25 @@ void print_help(const char *program_name)
 // --- Main Program Logic ---
 int main(int argc, char *argv[])
 {
-    if (sx1255_init(spi_device, gpio_chip_path, rst_pin_offset) != 0)
+    zmq_ctx = zmq_ctx_new();
+    if (sx1255_ctrl_open(&rf, zmq_ctx, NULL, spi_device, gpio_chip_path, rst_pin_offset) != 0)
     {
         fprintf(stderr, "Can not initialize device\nExiting\n");
+        zmq_ctx_term(zmq_ctx);
         return -1;
     }
 
-    uint8_t val = sx1255_get_chip_version();
+    if (sx1255_ctrl_brokered(&rf))
+        printf("Using SX1255 broker at %s\n", SX1255_CTRL_IPC);
+
+    uint8_t val = 0;
+    if (sx1255_ctrl_get_chip_version(&rf, &val) != 0)
+    {
+        fprintf(stderr, "Can not read the chip version\nExiting\n");
+        sx1255_ctrl_close(&rf);
+        zmq_ctx_term(zmq_ctx);
+        return -1;
+    }
     printf("Detected SX1255 chip version V%d%c", (val >> 4) & 0xF, 'A' + (val & 0xF) - 1);
     if (val == 0x11)
     {
@@ -117,8 +134,7 @@ int main(int argc, char *argv[])
         // reset
         case 'E':
             printf("Resetting device... ");
-            sx1255_reset();
-            printf("completed\n");
+            printf("%s\n", sx1255_ctrl_reset(&rf) == 0 ? "completed" : "error");
             break;
 
         // sample rate
@@ -152,12 +168,13 @@ int main(int argc, char *argv[])
                 rate = SX1255_RATE_125K;
             }
 
-            int8_t retval = sx1255_set_rate(rate);
+            int8_t retval = sx1255_ctrl_set_rate(&rf, rate);
             printf("I2S setup %s\n", retval == 0 ? "OK" : "error");
             if (retval != 0)
             {
                 printf("Exiting\n");
-                sx1255_cleanup();
+                sx1255_ctrl_close(&rf);
+                zmq_ctx_term(zmq_ctx);
                 return -1;
             }
             break;
@@ -174,7 +191,7 @@ int main(int argc, char *argv[])
                 printf("Invalid RX frequency. Using 435000000 Hz.\n");
                 rxf = 435000000;
             }
-            sx1255_set_rx_freq(rxf);
+            sx1255_ctrl_set_rx_freq(&rf, rxf);
             break;
 
         // tx freq
@@ -189,7 +206,7 @@ int main(int argc, char *argv[])
                 printf("Invalid TX frequency. Using 435000000 Hz.\n");
                 txf = 435000000;
             }
-            sx1255_set_tx_freq(txf);
+            sx1255_ctrl_set_tx_freq(&rf, txf);
             break;
     
         // lna gain
@@ -212,7 +229,7 @@ int main(int argc, char *argv[])
                 printf("Missing LNA gain. Using 48 dB.\n");
                 lna_gain = 48;
             }
-            sx1255_set_lna_gain(lna_gain);
+            sx1255_ctrl_set_lna_gain(&rf, lna_gain);
             break;
 
         // pga gain
@@ -235,7 +252,7 @@ int main(int argc, char *argv[])
                 printf("Missing PGA gain. Using 30 dB.\n");
                 pga_gain = 30;
             }
-            sx1255_set_pga_gain(pga_gain);
+            sx1255_ctrl_set_pga_gain(&rf, pga_gain);
             break;
 
         // dac gain
@@ -258,7 +275,7 @@ int main(int argc, char *argv[])
                 printf("Missing DAC gain. Using -3 dB.\n");
                 dac_gain = -3;
             }
-            sx1255_set_dac_gain(dac_gain);
+            sx1255_ctrl_set_dac_gain(&rf, dac_gain);
             break;
 
         // mixer gain
@@ -281,7 +298,7 @@ int main(int argc, char *argv[])
                 printf("Missing mixer gain. Using -9.5 dB.\n");
                 mix_gain = -9.5;
             }
-            sx1255_set_mixer_gain(mix_gain);
+            sx1255_ctrl_set_mixer_gain(&rf, mix_gain);
             break;
 
         // rx pll bw
@@ -304,7 +321,7 @@ int main(int argc, char *argv[])
                 printf("Missing RX PLL bandwidth. Using 75 kHz.\n");
                 pll_bw = 75;
             }
-            sx1255_set_rx_pll_bw(pll_bw);
+            sx1255_ctrl_set_rx_pll_bw(&rf, pll_bw);
             break;
 
         // tx pll bw
@@ -327,7 +344,7 @@ int main(int argc, char *argv[])
                 printf("Missing TX PLL bandwidth. Using 75 kHz.\n");
                 pll_bw = 75;
             }
-            sx1255_set_tx_pll_bw(pll_bw);
+            sx1255_ctrl_set_tx_pll_bw(&rf, pll_bw);
             break;
 
         // enable/disable TX front end
@@ -337,12 +354,12 @@ int main(int argc, char *argv[])
                 val = atoi(optarg);
                 if (val == 0)
                 {
-                    sx1255_enable_tx(false);
+                    sx1255_ctrl_enable_tx(&rf, false);
                     printf("Disabling TX path.\n");
                 }
                 else
                 {
-                    sx1255_enable_tx(true);
+                    sx1255_ctrl_enable_tx(&rf, true);
                     printf("Enabling TX path.\n");
                 }
             }
@@ -359,12 +376,12 @@ int main(int argc, char *argv[])
                 val = atoi(optarg);
                 if (val == 0)
                 {
-                    sx1255_enable_rx(false);
+                    sx1255_ctrl_enable_rx(&rf, false);
                     printf("Disabling RX path.\n");
                 }
                 else
                 {
-                    sx1255_enable_rx(true);
+                    sx1255_ctrl_enable_rx(&rf, true);
                     printf("Enabling RX path.\n");
                 }
             }
@@ -376,7 +393,11 @@ int main(int argc, char *argv[])
 
         // get PLL lock flags
         case 'P':
-            val = sx1255_read_reg(0x11);
+            if (sx1255_ctrl_read_reg(&rf, 0x11, &val) != 0)
+            {
+                printf("PLL lock flags readout error.\n");
+                break;
+            }
             printf("TX PLL %s\n", (val & (1 << 0)) ? "locked" : "unlocked");
             printf("RX PLL %s\n", (val & (1 << 1)) ? "locked" : "unlocked");
             break;
@@ -388,12 +409,12 @@ int main(int argc, char *argv[])
                 val = atoi(optarg);
                 if (val == 0)
                 {
-                    sx1255_enable_rf_loopback(false);
+                    sx1255_ctrl_enable_rf_loopback(&rf, false);
                     printf("Disabling RF loopback.\n");
                 }
                 else
                 {
-                    sx1255_enable_rf_loopback(true);
+                    sx1255_ctrl_enable_rf_loopback(&rf, true);
                     printf("Enabling RF loopback.\n");
                 }
             }
@@ -412,10 +433,12 @@ int main(int argc, char *argv[])
                 else
                     addr = atoi(optarg);
 
-                if (addr <= 0x13)
-                    printf("Register 0x%02X value: 0x%02X\n", addr, sx1255_read_reg(addr));
-                else
+                if (addr > 0x13)
                     printf("Register readout error: address out of range.\n");
+                else if (sx1255_ctrl_read_reg(&rf, addr, &val) != 0)
+                    printf("Register readout error.\n");
+                else
+                    printf("Register 0x%02X value: 0x%02X\n", addr, val);
             }
             else
             {
@@ -433,7 +456,8 @@ int main(int argc, char *argv[])
                 if (addr <= 0x13)
                 {
                     printf("Seting register 0x%02X to 0x%02X\n", addr, val);
-                    sx1255_write_reg(addr, val);
+                    if (sx1255_ctrl_write_reg(&rf, addr, val) != 0)
+                        printf("Register write error.\n");
                 }
                 else
                     printf("Register write error: address out of range.\n");
@@ -447,12 +471,14 @@ int main(int argc, char *argv[])
         // help
         case 'h':
             print_help(argv[0]);
-            sx1255_cleanup();
+            sx1255_ctrl_close(&rf);
+            zmq_ctx_term(zmq_ctx);
             return 0;
             break;
         }
     }
 
-    sx1255_cleanup();
+    sx1255_ctrl_close(&rf);
+    zmq_ctx_term(zmq_ctx);
     return 0;
 }
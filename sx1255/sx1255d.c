@@ -0,0 +1,383 @@
+// SX1255 control broker - owns the SPI/GPIO and serializes requests from all clients
+// Build with gcc sx1255d.c -o sx1255d -lsx1255 -lzmq
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <signal.h>
+#include <getopt.h>
+
+#include "sx1255-ctrl.h"
+
+// --- Configuration ---
+uint16_t rst_pin_offset = 22;
+char spi_device[64] = "/dev/spidev0.0";
+char gpio_chip_path[64] = "/dev/gpiochip0";
+char ctrl_ipc[128] = SX1255_CTRL_IPC;
+
+bool mock = false;
+bool verbose = false;
+volatile sig_atomic_t running = 1;
+
+// hardware backend - libsx1255 or an in-memory mock for testing without the chip
+typedef struct
+{
+    int (*init)(void);
+    void (*cleanup)(void);
+    void (*reset)(void);
+    int8_t (*set_rate)(sx1255_rate_t rate);
+    void (*set_rx_freq)(uint32_t freq);
+    void (*set_tx_freq)(uint32_t freq);
+    void (*set_lna_gain)(uint8_t gain);
+    void (*set_pga_gain)(uint8_t gain);
+    void (*set_dac_gain)(int8_t gain);
+    void (*set_mixer_gain)(float gain);
+    void (*set_rx_pll_bw)(uint16_t bw);
+    void (*set_tx_pll_bw)(uint16_t bw);
+    void (*enable_rx)(bool ena);
+    void (*enable_tx)(bool ena);
+    void (*enable_rf_loopback)(bool ena);
+    uint8_t (*get_chip_version)(void);
+    uint8_t (*read_reg)(uint8_t addr);
+    void (*write_reg)(uint8_t addr, uint8_t val);
+} sx1255_ops_t;
+
+int hw_init(void)
+{
+    return sx1255_init(spi_device, gpio_chip_path, rst_pin_offset);
+}
+
+const sx1255_ops_t hw_ops =
+{
+    hw_init, sx1255_cleanup, sx1255_reset, sx1255_set_rate,
+    sx1255_set_rx_freq, sx1255_set_tx_freq,
+    sx1255_set_lna_gain, sx1255_set_pga_gain, sx1255_set_dac_gain, sx1255_set_mixer_gain,
+    sx1255_set_rx_pll_bw, sx1255_set_tx_pll_bw,
+    sx1255_enable_rx, sx1255_enable_tx, sx1255_enable_rf_loopback,
+    sx1255_get_chip_version, sx1255_read_reg, sx1255_write_reg
+};
+
+// --- Mock backend ---
+// Keeps a register file and the last value of every setting. Both PLLs report
+// lock once their path is enabled, so clients polling register 0x11 behave as
+// they would on real hardware.
+#define MOCK_NUM_REGS 0x14
+
+uint8_t mock_regs[MOCK_NUM_REGS];
+
+void mock_log(const char *what, double val)
+{
+    if (verbose)
+        fprintf(stderr, "mock: %s = %g\n", what, val);
+}
+
+void mock_reset(void)
+{
+    memset(mock_regs, 0, sizeof(mock_regs));
+    mock_regs[0x07] = 0x11; // chip version V1A
+    mock_log("reset", 0);
+}
+
+int mock_init(void) { mock_reset(); return 0; }
+void mock_cleanup(void) { }
+int8_t mock_set_rate(sx1255_rate_t rate) { mock_log("rate", rate); return 0; }
+void mock_set_rx_freq(uint32_t freq) { mock_log("rx_freq", freq); }
+void mock_set_tx_freq(uint32_t freq) { mock_log("tx_freq", freq); }
+void mock_set_lna_gain(uint8_t gain) { mock_log("lna_gain", gain); }
+void mock_set_pga_gain(uint8_t gain) { mock_log("pga_gain", gain); }
+void mock_set_dac_gain(int8_t gain) { mock_log("dac_gain", gain); }
+void mock_set_mixer_gain(float gain) { mock_log("mix_gain", gain); }
+void mock_set_rx_pll_bw(uint16_t bw) { mock_log("rx_pll_bw", bw); }
+void mock_set_tx_pll_bw(uint16_t bw) { mock_log("tx_pll_bw", bw); }
+void mock_enable_rf_loopback(bool ena) { mock_log("rf_loop", ena); }
+uint8_t mock_get_chip_version(void) { return mock_regs[0x07]; }
+
+void mock_enable_rx(bool ena)
+{
+    mock_log("rx_ena", ena);
+    if (ena)
+        mock_regs[0x11] |= (1 << 1);
+    else
+        mock_regs[0x11] &= (uint8_t)~(1 << 1);
+}
+
+void mock_enable_tx(bool ena)
+{
+    mock_log("tx_ena", ena);
+    if (ena)
+        mock_regs[0x11] |= (1 << 0);
+    else
+        mock_regs[0x11] &= (uint8_t)~(1 << 0);
+}
+
+uint8_t mock_read_reg(uint8_t addr)
+{
+    return addr < MOCK_NUM_REGS ? mock_regs[addr] : 0;
+}
+
+void mock_write_reg(uint8_t addr, uint8_t val)
+{
+    mock_log("reg write", addr);
+    if (addr < MOCK_NUM_REGS)
+        mock_regs[addr] = val;
+}
+
+const sx1255_ops_t mock_ops =
+{
+    mock_init, mock_cleanup, mock_reset, mock_set_rate,
+    mock_set_rx_freq, mock_set_tx_freq,
+    mock_set_lna_gain, mock_set_pga_gain, mock_set_dac_gain, mock_set_mixer_gain,
+    mock_set_rx_pll_bw, mock_set_tx_pll_bw,
+    mock_enable_rx, mock_enable_tx, mock_enable_rf_loopback,
+    mock_get_chip_version, mock_read_reg, mock_write_reg
+};
+
+// execute a single request
+sx1255_rep_t handle_request(const sx1255_ops_t *ops, const sx1255_req_t *req)
+{
+    sx1255_rep_t rep = {0, 0};
+
+    switch (req->cmd)
+    {
+    case SX1255_CMD_PING:
+        break;
+
+    case SX1255_CMD_RESET:
+        ops->reset();
+        break;
+
+    case SX1255_CMD_SET_RATE:
+        if (req->arg.u > SX1255_RATE_500K)
+            rep.retval = -1;
+        else
+            rep.retval = ops->set_rate((sx1255_rate_t)req->arg.u);
+        break;
+
+    case SX1255_CMD_SET_RX_FREQ:
+        ops->set_rx_freq(req->arg.u);
+        break;
+
+    case SX1255_CMD_SET_TX_FREQ:
+        ops->set_tx_freq(req->arg.u);
+        break;
+
+    case SX1255_CMD_SET_LNA_GAIN:
+        ops->set_lna_gain((uint8_t)req->arg.u);
+        break;
+
+    case SX1255_CMD_SET_PGA_GAIN:
+        ops->set_pga_gain((uint8_t)req->arg.u);
+        break;
+
+    case SX1255_CMD_SET_DAC_GAIN:
+        ops->set_dac_gain((int8_t)req->arg.i);
+        break;
+
+    case SX1255_CMD_SET_MIX_GAIN:
+        ops->set_mixer_gain(req->arg.f);
+        break;
+
+    case SX1255_CMD_SET_RX_PLL_BW:
+        ops->set_rx_pll_bw((uint16_t)req->arg.u);
+        break;
+
+    case SX1255_CMD_SET_TX_PLL_BW:
+        ops->set_tx_pll_bw((uint16_t)req->arg.u);
+        break;
+
+    case SX1255_CMD_ENABLE_RX:
+        ops->enable_rx(req->arg.u != 0);
+        break;
+
+    case SX1255_CMD_ENABLE_TX:
+        ops->enable_tx(req->arg.u != 0);
+        break;
+
+    case SX1255_CMD_RF_LOOPBACK:
+        ops->enable_rf_loopback(req->arg.u != 0);
+        break;
+
+    case SX1255_CMD_GET_VERSION:
+        rep.val = ops->get_chip_version();
+        break;
+
+    case SX1255_CMD_READ_REG:
+        if (req->addr <= 0x13)
+            rep.val = ops->read_reg(req->addr);
+        else
+            rep.retval = -1;
+        break;
+
+    case SX1255_CMD_WRITE_REG:
+        if (req->addr <= 0x13)
+            ops->write_reg(req->addr, req->val);
+        else
+            rep.retval = -1;
+        break;
+
+    case SX1255_CMD_UPDATE_REG:
+        if (req->addr <= 0x13)
+        {
+            uint8_t tmp = ops->read_reg(req->addr);
+            tmp = (uint8_t)((tmp & ~req->mask) | (req->val & req->mask));
+            ops->write_reg(req->addr, tmp);
+            rep.val = tmp;
+        }
+        else
+            rep.retval = -1;
+        break;
+
+    default:
+        rep.retval = -1;
+        break;
+    }
+
+    return rep;
+}
+
+void exit_handler(int sig)
+{
+    (void)sig;
+    running = 0;
+}
+
+void print_help(const char *program_name)
+{
+    printf("SX1255 control broker\n\n");
+    printf("Usage: %s [OPTIONS]\n\n", program_name);
+    printf("Optional options:\n");
+    printf("  -s, --spi=DEV             SPI device (default /dev/spidev0.0)\n");
+    printf("  -g, --gpio=CHIP           GPIO chip (default /dev/gpiochip0)\n");
+    printf("  -r, --reset_pin=NUM       Reset pin offset (default 22)\n");
+    printf("  -u, --usock=IPC           ZeroMQ control socket (default %s)\n", SX1255_CTRL_IPC);
+    printf("  -M, --mock                Use a mock chip instead of the hardware\n");
+    printf("  -v, --verbose             Log every request\n");
+    printf("  -h, --help                Display this help message and exit\n");
+    printf("\n");
+    printf("Example:\n");
+    printf("  %s -M -v -u ipc:///tmp/sx1255_test\n", program_name);
+}
+
+int main(int argc, char *argv[])
+{
+    // Define the long options
+    static struct option long_options[] =
+    {
+        {"spi", required_argument, 0, 's'},
+        {"gpio", required_argument, 0, 'g'},
+        {"reset_pin", required_argument, 0, 'r'},
+        {"usock", required_argument, 0, 'u'},
+        {"mock", no_argument, 0, 'M'},
+        {"verbose", no_argument, 0, 'v'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    // autogenerate the arg list
+    char arglist[64] = {0};
+    for (uint8_t i = 0; i < sizeof(long_options) / sizeof(struct option) - 1; i++)
+    {
+        arglist[strlen(arglist)] = long_options[i].val;
+        if (long_options[i].has_arg != no_argument)
+            arglist[strlen(arglist)] = ':';
+    }
+
+    int opt;
+    int option_index = 0;
+
+    // Parse command line arguments
+    while ((opt = getopt_long(argc, argv, arglist, long_options, &option_index)) != -1)
+    {
+        switch (opt)
+        {
+        case 's':
+            snprintf(spi_device, sizeof(spi_device), "%s", optarg);
+            break;
+
+        case 'g':
+            snprintf(gpio_chip_path, sizeof(gpio_chip_path), "%s", optarg);
+            break;
+
+        case 'r':
+            rst_pin_offset = atoi(optarg);
+            break;
+
+        case 'u':
+            snprintf(ctrl_ipc, sizeof(ctrl_ipc), "%s", optarg);
+            break;
+
+        case 'M':
+            mock = true;
+            break;
+
+        case 'v':
+            verbose = true;
+            break;
+
+        case 'h':
+            print_help(argv[0]);
+            return 0;
+            break;
+        }
+    }
+
+    const sx1255_ops_t *ops = mock ? &mock_ops : &hw_ops;
+
+    if (ops->init() != 0)
+    {
+        fprintf(stderr, "Can not initialize device\nExiting\n");
+        return -1;
+    }
+
+    void *zmq_ctx = zmq_ctx_new();
+    void *zmq_rep = zmq_socket(zmq_ctx, ZMQ_REP);
+
+    if (zmq_bind(zmq_rep, ctrl_ipc) != 0)
+    {
+        fprintf(stderr, "ZeroMQ: Error binding to %s.\nExiting.\n", ctrl_ipc);
+        ops->cleanup();
+        return -1;
+    }
+
+    // wake up from zmq_recv() now and then to check for a pending exit
+    int tmo = 500;
+    zmq_setsockopt(zmq_rep, ZMQ_RCVTIMEO, &tmo, sizeof(tmo));
+
+    signal(SIGINT, exit_handler);
+    signal(SIGTERM, exit_handler);
+
+    fprintf(stderr, "SX1255 broker running on %s (%s backend)\n", ctrl_ipc, mock ? "mock" : "hardware");
+
+    while (running)
+    {
+        sx1255_req_t req;
+        sx1255_rep_t rep;
+
+        int n = zmq_recv(zmq_rep, &req, sizeof(req), 0);
+        if (n < 0)
+            continue; // timeout or signal
+
+        if (n != (int)sizeof(req))
+        {
+            rep.retval = -1;
+            rep.val = 0;
+        }
+        else
+        {
+            rep = handle_request(ops, &req);
+            if (verbose)
+                fprintf(stderr, "cmd %u addr 0x%02X arg %u -> %d\n", req.cmd, req.addr, req.arg.u, rep.retval);
+        }
+
+        zmq_send(zmq_rep, &rep, sizeof(rep), 0);
+    }
+
+    fprintf(stderr, "\nCleaning up...\n");
+    zmq_close(zmq_rep);
+    zmq_ctx_term(zmq_ctx);
+    ops->cleanup();
+
+    return 0;
+}
@@ -0,0 +1,59 @@
+// Asset bundle, made at build time by mkbundle
+//
+// Everything gui_test draws, already in the form it is drawn in: the icons
+// as R8G8B8A8 pixels and the fonts rasterized at each size used. Nothing is
+// decoded or rasterized at startup - the file is mmapped and used where it
+// is. Layout (native byte order, the file is made where it is used,
+// offsets from the start of the file, tables 4-byte aligned):
+//
+//   bd_header_t
+//   bd_font_t[num_fonts]
+//   bd_image_t[num_images]
+//   per font: bd_glyph_t[count], advances uint8_t[count], coverage bytes
+//   per image: w * h * 4 bytes
+//
+// A glyph's coverage is its ink box only, w * h 8-bit values, row by row.
+#ifndef BUNDLE_H
+#define BUNDLE_H
+
+#include <stdint.h>
+
+#define BD_MAGIC "LHTA"
+#define BD_VERSION 1
+#define BD_NAME_LEN 32
+
+typedef struct
+{
+	char magic[4];
+	uint16_t version;
+	uint16_t num_fonts;
+	uint16_t num_images;
+	uint16_t reserved;
+} bd_header_t;
+
+typedef struct
+{
+	char name[BD_NAME_LEN]; // TTF file name without the extension
+	uint16_t size;			// px, also the line height
+	uint16_t first, count;	// codepoints first .. first + count - 1
+	uint32_t glyphs;		// bd_glyph_t[count]
+	uint32_t adv;			// uint8_t[count], pen advance in px
+	uint32_t bits;			// coverage
+	uint32_t bits_len;
+} bd_font_t;
+
+typedef struct
+{
+	int8_t x, y;  // ink box from the pen position at the top of the line
+	uint8_t w, h; // 0 - nothing to draw, e.g. space
+	uint32_t off; // coverage from bd_font_t.bits
+} bd_glyph_t;
+
+typedef struct
+{
+	char name[BD_NAME_LEN]; // PNG file name without the extension
+	uint16_t w, h;
+	uint32_t data; // R8G8B8A8
+} bd_image_t;
+
+#endif
@@ -0,0 +1,269 @@
+// mkbundle: convert icons and fonts into an asset bundle
+//
+// mkbundle <out.bin> [<font.ttf> <size>...]... [<icon.png>]...
+//
+// The glyphs are the ones raylib's LoadFontEx(path, size, 0, 250) has,
+// rasterized the same way, with the blank border of each trimmed. Icons
+// are decoded and converted to R8G8B8A8 as LoadImage() and ImageFormat()
+// did at runtime.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <raylib.h>
+
+#include "bundle.h"
+
+#define FIRST_CP 32
+#define NUM_CP 250
+#define MAX_FONTS 16
+#define MAX_IMAGES 32
+#define ALIGN4(x) (((x) + 3) & ~3U)
+
+typedef struct
+{
+	bd_font_t hdr;
+	bd_glyph_t glyph[NUM_CP];
+	uint8_t adv[NUM_CP];
+	uint8_t *bits;
+} font_t;
+
+typedef struct
+{
+	bd_image_t hdr;
+	Image img;
+} image_t;
+
+font_t font[MAX_FONTS];
+uint16_t num_fonts;
+image_t image[MAX_IMAGES];
+uint16_t num_images;
+
+// file name without the directory and the extension
+void base_name(char out[BD_NAME_LEN], const char *path)
+{
+	const char *base = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+
+	snprintf(out, BD_NAME_LEN, "%.*s", (int)strcspn(base, "."), base);
+}
+
+// glyph's coverage without its blank border into `f`
+int add_glyph(font_t *f, int i, const GlyphInfo *g)
+{
+	int adv = g->advanceX ? g->advanceX : g->image.width;
+	bd_glyph_t *fg = &f->glyph[i];
+	const uint8_t *cov = g->image.data;
+	int x0 = g->image.width, y0 = g->image.height, x1 = -1, y1 = -1;
+
+	if (adv > 255)
+		return -1;
+	f->adv[i] = adv;
+	memset(fg, 0, sizeof(*fg));
+
+	// anything else is a blank raylib made up (space)
+	if (g->image.format != PIXELFORMAT_UNCOMPRESSED_GRAYSCALE)
+		return 0;
+
+	for (int y = 0; y < g->image.height; y++)
+		for (int x = 0; x < g->image.width; x++)
+			if (cov[y * g->image.width + x])
+			{
+				x0 = x < x0 ? x : x0;
+				x1 = x > x1 ? x : x1;
+				y0 = y < y0 ? y : y0;
+				y1 = y > y1 ? y : y1;
+			}
+
+	if (x1 < 0)
+		return 0;
+
+	int ox = g->offsetX + x0, oy = g->offsetY + y0, w = x1 - x0 + 1, h = y1 - y0 + 1;
+	if (ox < -128 || ox > 127 || oy < -128 || oy > 127 || w > 255 || h > 255)
+		return -1;
+
+	fg->x = ox;
+	fg->y = oy;
+	fg->w = w;
+	fg->h = h;
+	fg->off = f->hdr.bits_len;
+
+	f->bits = realloc(f->bits, f->hdr.bits_len + w * h);
+	if (f->bits == NULL)
+		return -1;
+	for (int y = 0; y < h; y++)
+		memcpy(&f->bits[f->hdr.bits_len + y * w], &cov[(y0 + y) * g->image.width + x0], w);
+	f->hdr.bits_len += w * h;
+
+	return 0;
+}
+
+int add_font(const unsigned char *ttf, int len, const char *path, int size)
+{
+	if (num_fonts == MAX_FONTS || size < 1 || size > 255)
+	{
+		fprintf(stderr, "%s: bad size %d or too many fonts\n", path, size);
+		return -1;
+	}
+
+	font_t *f = &font[num_fonts];
+
+	base_name(f->hdr.name, path);
+	f->hdr.size = size;
+	f->hdr.first = FIRST_CP;
+	f->hdr.count = NUM_CP;
+
+	GlyphInfo *g = LoadFontData(ttf, len, size, NULL, NUM_CP, FONT_DEFAULT);
+	if (g == NULL)
+	{
+		fprintf(stderr, "%s: cannot rasterize at %d px\n", path, size);
+		return -1;
+	}
+
+	int err = 0;
+	for (int i = 0; i < NUM_CP && !err; i++)
+		err = add_glyph(f, i, &g[i]);
+	UnloadFontData(g, NUM_CP);
+
+	if (err)
+	{
+		fprintf(stderr, "%s: glyph too large at %d px\n", path, size);
+		return -1;
+	}
+
+	num_fonts++;
+	return 0;
+}
+
+int add_image(const char *path)
+{
+	if (num_images == MAX_IMAGES)
+	{
+		fprintf(stderr, "%s: too many images\n", path);
+		return -1;
+	}
+
+	image_t *im = &image[num_images];
+
+	im->img = LoadImage(path);
+	if (im->img.data == NULL || im->img.width > 0xFFFF || im->img.height > 0xFFFF)
+	{
+		fprintf(stderr, "Cannot load %s\n", path);
+		return -1;
+	}
+	ImageFormat(&im->img, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+
+	base_name(im->hdr.name, path);
+	im->hdr.w = im->img.width;
+	im->hdr.h = im->img.height;
+
+	num_images++;
+	return 0;
+}
+
+int write_bundle(const char *path)
+{
+	bd_header_t hdr = {BD_MAGIC, BD_VERSION, num_fonts, num_images, 0};
+	uint32_t off = ALIGN4(sizeof(hdr) + num_fonts * sizeof(bd_font_t) + num_images * sizeof(bd_image_t));
+	const uint8_t pad[4] = {0};
+
+	// tables go after the headers, font by font
+	for (uint16_t i = 0; i < num_fonts; i++)
+	{
+		bd_font_t *h = &font[i].hdr;
+
+		h->glyphs = off;
+		h->adv = h->glyphs + NUM_CP * sizeof(bd_glyph_t);
+		h->bits = h->adv + NUM_CP;
+		off = ALIGN4(h->bits + h->bits_len);
+	}
+
+	// then the pixels
+	for (uint16_t i = 0; i < num_images; i++)
+	{
+		image[i].hdr.data = off;
+		off += image[i].hdr.w * image[i].hdr.h * 4;
+	}
+
+	FILE *fp = fopen(path, "wb");
+	if (fp == NULL)
+	{
+		perror(path);
+		return -1;
+	}
+
+	fwrite(&hdr, sizeof(hdr), 1, fp);
+	for (uint16_t i = 0; i < num_fonts; i++)
+		fwrite(&font[i].hdr, sizeof(bd_font_t), 1, fp);
+	for (uint16_t i = 0; i < num_images; i++)
+		fwrite(&image[i].hdr, sizeof(bd_image_t), 1, fp);
+	fwrite(pad, ALIGN4(ftell(fp)) - ftell(fp), 1, fp);
+
+	for (uint16_t i = 0; i < num_fonts; i++)
+	{
+		fwrite(font[i].glyph, sizeof(bd_glyph_t), NUM_CP, fp);
+		fwrite(font[i].adv, 1, NUM_CP, fp);
+		fwrite(font[i].bits, 1, font[i].hdr.bits_len, fp);
+		fwrite(pad, ALIGN4(ftell(fp)) - ftell(fp), 1, fp);
+	}
+
+	for (uint16_t i = 0; i < num_images; i++)
+		fwrite(image[i].img.data, 4, image[i].hdr.w * image[i].hdr.h, fp);
+
+	if (fclose(fp) != 0)
+	{
+		perror(path);
+		return -1;
+	}
+
+	fprintf(stderr, "%s: %u fonts, %u images, %u bytes\n", path, num_fonts, num_images, off);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned char *ttf = NULL;
+	int len = 0;
+	const char *ttf_path = NULL;
+
+	if (argc < 3)
+	{
+		fprintf(stderr, "Usage: %s <out.bin> [<font.ttf> <size>...]... [<icon.png>]...\n", argv[0]);
+		return 1;
+	}
+
+	SetTraceLogLevel(LOG_WARNING);
+
+	for (int i = 2; i < argc; i++)
+	{
+		char *end;
+		long size = strtol(argv[i], &end, 10);
+
+		if (*end == 0 && ttf != NULL)
+		{
+			if (add_font(ttf, len, ttf_path, size) != 0)
+				return 1;
+			continue;
+		}
+
+		UnloadFileData(ttf);
+		ttf = NULL;
+
+		const char *ext = strrchr(argv[i], '.');
+		if (ext != NULL && strcmp(ext, ".png") == 0)
+		{
+			if (add_image(argv[i]) != 0)
+				return 1;
+			continue;
+		}
+
+		ttf_path = argv[i];
+		ttf = LoadFileData(ttf_path, &len);
+		if (ttf == NULL)
+		{
+			fprintf(stderr, "Cannot read %s\n", ttf_path);
+			return 1;
+		}
+	}
+	UnloadFileData(ttf);
+
+	return write_bundle(argv[1]) != 0;
+}
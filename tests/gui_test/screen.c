@@ -0,0 +1,751 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <linux/fb.h>
+
+#include "screen.h"
+
+#define FB_PAGE 4096   // deferred I/O tracks framebuffer writes per page
+#define BUS_BPP 2	   // bytes per pixel on the display bus (RGB565)
+
+#define LAYOUT_CACHE_LEN 64 // a power of two
+#define LAYOUT_TEXT_MAX 32	// longer text (messages) is laid out every time
+
+// a line of text laid out at (0, 0)
+typedef struct
+{
+	const scr_font_t *font;
+	int8_t spacing;
+	char text[LAYOUT_TEXT_MAX];
+	int16_t width;
+	scr_rect_t ink;
+} layout_t;
+
+// direct mapped, keyed by (font, spacing, text)
+static layout_t layout_cache[LAYOUT_CACHE_LEN];
+static uint32_t layout_hits, layout_misses;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline uint32_t pixel(Color c)
+{
+	return (uint32_t)c.r << 16 | (uint32_t)c.g << 8 | c.b;
+}
+
+// `c` over `d` with `a` (0..255)
+static inline uint32_t blend(uint32_t d, Color c, uint32_t a)
+{
+	int dr = d >> 16 & 0xFF, dg = d >> 8 & 0xFF, db = d & 0xFF;
+
+	dr += ((c.r - dr) * (int)a + 127) / 255;
+	dg += ((c.g - dg) * (int)a + 127) / 255;
+	db += ((c.b - db) * (int)a + 127) / 255;
+
+	return (uint32_t)dr << 16 | (uint32_t)dg << 8 | db;
+}
+
+static scr_rect_t intersect(scr_rect_t a, scr_rect_t b)
+{
+	int x0 = a.x > b.x ? a.x : b.x;
+	int y0 = a.y > b.y ? a.y : b.y;
+	int x1 = a.x + a.w < b.x + b.w ? a.x + a.w : b.x + b.w;
+	int y1 = a.y + a.h < b.y + b.h ? a.y + a.h : b.y + b.h;
+
+	if (x1 <= x0 || y1 <= y0)
+		return (scr_rect_t){0, 0, 0, 0};
+
+	return (scr_rect_t){x0, y0, x1 - x0, y1 - y0};
+}
+
+static scr_rect_t unite(scr_rect_t a, scr_rect_t b)
+{
+	if (a.w == 0)
+		return b;
+	if (b.w == 0)
+		return a;
+
+	int x0 = a.x < b.x ? a.x : b.x;
+	int y0 = a.y < b.y ? a.y : b.y;
+	int x1 = a.x + a.w > b.x + b.w ? a.x + a.w : b.x + b.w;
+	int y1 = a.y + a.h > b.y + b.h ? a.y + a.h : b.y + b.h;
+
+	return (scr_rect_t){x0, y0, x1 - x0, y1 - y0};
+}
+
+// mark an area for repainting, overlapping areas are merged
+static void mark_dirty(scr_t *scr, scr_rect_t r)
+{
+	r = intersect(r, (scr_rect_t){0, 0, scr->w, scr->h});
+	if (r.w == 0)
+		return;
+
+	for (uint8_t i = 0; i < scr->num_dirty; i++)
+	{
+		if (intersect(scr->dirty[i], r).w)
+		{
+			// the union may now overlap others - take it out and add it again
+			r = unite(scr->dirty[i], r);
+			scr->dirty[i] = scr->dirty[--scr->num_dirty];
+			mark_dirty(scr, r);
+			return;
+		}
+	}
+
+	if (scr->num_dirty == SCR_MAX_DIRTY)
+		scr->dirty[SCR_MAX_DIRTY - 1] = unite(scr->dirty[SCR_MAX_DIRTY - 1], r);
+	else
+		scr->dirty[scr->num_dirty++] = r;
+}
+
+// next codepoint of UTF-8 text, invalid bytes are taken one by one
+static int utf8_next(const char **s)
+{
+	const uint8_t *p = (const uint8_t *)*s;
+	int cp = p[0], n = 1;
+
+	if (cp >= 0xF0 && (p[1] & 0xC0) == 0x80 && (p[2] & 0xC0) == 0x80 && (p[3] & 0xC0) == 0x80)
+	{
+		cp = (cp & 0x07) << 18 | (p[1] & 0x3F) << 12 | (p[2] & 0x3F) << 6 | (p[3] & 0x3F);
+		n = 4;
+	}
+	else if (cp >= 0xE0 && (p[1] & 0xC0) == 0x80 && (p[2] & 0xC0) == 0x80)
+	{
+		cp = (cp & 0x0F) << 12 | (p[1] & 0x3F) << 6 | (p[2] & 0x3F);
+		n = 3;
+	}
+	else if (cp >= 0xC0 && (p[1] & 0xC0) == 0x80)
+	{
+		cp = (cp & 0x1F) << 6 | (p[1] & 0x3F);
+		n = 2;
+	}
+	else if (cp >= 0x80)
+	{
+		cp = '?';
+	}
+
+	*s += n;
+	return cp;
+}
+
+// glyph index of a codepoint, '?' for ones the font does not have
+static inline int glyph(const scr_font_t *f, int cp)
+{
+	if (cp < f->first || cp >= f->first + f->count)
+		cp = '?';
+
+	return cp - f->first;
+}
+
+static void draw_glyph(scr_t *scr, const scr_font_t *f, int i, int x, int y, Color c, scr_rect_t clip)
+{
+	const bd_glyph_t *g = &f->glyphs[i];
+
+	if (g->w == 0) // a blank, e.g. space
+		return;
+
+	scr_rect_t r = intersect((scr_rect_t){x + g->x, y + g->y, g->w, g->h}, clip);
+	const uint8_t *cov = f->bits + g->off;
+
+	for (int py = r.y; py < r.y + r.h; py++)
+	{
+		const uint8_t *src = &cov[(py - (y + g->y)) * g->w - (x + g->x)];
+		uint32_t *dst = &scr->back[py * scr->w];
+
+		for (int px = r.x; px < r.x + r.w; px++)
+			if (src[px])
+				dst[px] = blend(dst[px], c, src[px] * c.a / 255);
+	}
+}
+
+// one line of text from (x, y), at most `len` bytes; drawn clipped to `clip`
+// if it is not NULL, its inked area added to `ink` if that is not NULL.
+// Returns the width
+static int text_run(scr_t *scr, const scr_font_t *f, const char *text, int len, int x, int y, int spacing,
+					Color c, const scr_rect_t *clip, scr_rect_t *ink)
+{
+	const char *p = text, *end = text + len;
+	int x0 = x;
+
+	while (p < end && *p && *p != '\n')
+	{
+		int i = glyph(f, utf8_next(&p));
+		const bd_glyph_t *g = &f->glyphs[i];
+
+		if (clip)
+			draw_glyph(scr, f, i, x, y, c, *clip);
+		if (ink && g->w)
+			*ink = unite(*ink, (scr_rect_t){x + g->x, y + g->y, g->w, g->h});
+
+		x += f->adv[i] + spacing;
+	}
+
+	return x > x0 ? x - x0 - spacing : 0;
+}
+
+// width and inked area of a line of text at (0, 0) - from the cache if it
+// was laid out before, in `tmp` if it is too long to be kept
+static const layout_t *layout(const scr_font_t *f, const char *text, int spacing, layout_t *tmp)
+{
+	size_t len = strlen(text);
+	layout_t *l = tmp;
+
+	if (len < LAYOUT_TEXT_MAX)
+	{
+		// FNV-1a
+		uint32_t h = (2166136261u ^ (uint32_t)(uintptr_t)f) * 16777619u;
+		h = (h ^ (uint8_t)spacing) * 16777619u;
+		for (size_t i = 0; i < len; i++)
+			h = (h ^ (uint8_t)text[i]) * 16777619u;
+
+		l = &layout_cache[h & (LAYOUT_CACHE_LEN - 1)];
+		if (l->font == f && l->spacing == spacing && strcmp(l->text, text) == 0)
+		{
+			layout_hits++;
+			return l;
+		}
+
+		layout_misses++;
+		l->font = f;
+		l->spacing = spacing;
+		memcpy(l->text, text, len + 1);
+	}
+
+	l->ink = (scr_rect_t){0, 0, 0, 0};
+	l->width = text_run(NULL, f, text, len, 0, 0, spacing, BLANK, NULL, &l->ink);
+
+	return l;
+}
+
+int scr_text_width(const scr_font_t *f, const char *text, int spacing)
+{
+	layout_t tmp;
+
+	return layout(f, text, spacing, &tmp)->width;
+}
+
+// bytes of the next line of `text` that fit in `w` px: whole words if
+// possible, the newline or the space it was broken at is not included.
+// `next` is set to where the line after it starts
+static int wrap_line(const scr_font_t *f, const char *text, int w, int spacing, const char **next)
+{
+	const char *p = text, *brk = NULL;
+	int x = 0;
+
+	while (*p && *p != '\n')
+	{
+		const char *q = p;
+		int adv = f->adv[glyph(f, utf8_next(&q))];
+
+		if (x + adv > w && p > text)
+		{
+			if (brk == NULL) // one long word - break it anywhere
+				brk = p;
+			break;
+		}
+
+		if (*p == ' ')
+			brk = p;
+
+		x += adv + spacing;
+		p = q;
+	}
+
+	if (*p == 0 || *p == '\n')
+		brk = p;
+
+	*next = *brk ? brk + 1 : brk;
+	return brk - text;
+}
+
+// lay out a text box; drawn and/or its inked area returned as in text_run()
+static void textbox_run(scr_t *scr, const scr_widget_t *wg, const scr_rect_t *clip, scr_rect_t *ink)
+{
+	const char *p = wg->text;
+	scr_rect_t area = wg->box;
+	scr_rect_t c = clip ? intersect(*clip, area) : area;
+
+	for (int y = area.y; *p && y + wg->font->size <= area.y + area.h; y += wg->font->size)
+	{
+		const char *next;
+		int len = wrap_line(wg->font, p, area.w, wg->spacing, &next);
+
+		text_run(scr, wg->font, p, len, area.x, y, wg->spacing, wg->color, clip ? &c : NULL, ink);
+		p = next;
+	}
+
+	if (ink)
+		*ink = intersect(*ink, area);
+}
+
+// area a widget covers as it is now
+static scr_rect_t extent(const scr_widget_t *wg)
+{
+	scr_rect_t r = {0, 0, 0, 0};
+
+	if (!wg->visible)
+		return r;
+
+	switch (wg->kind)
+	{
+	case SCR_FILL:
+		return wg->box;
+
+	case SCR_ICON:
+		return (scr_rect_t){wg->box.x, wg->box.y, wg->img->width, wg->img->height};
+
+	case SCR_TEXT:
+	{
+		layout_t tmp;
+		const layout_t *l = layout(wg->font, wg->text, wg->spacing, &tmp);
+		int x = wg->box.x - (wg->align == SCR_CENTER ? l->width / 2 : wg->align == SCR_RIGHT ? l->width : 0);
+
+		if (l->ink.w)
+			r = (scr_rect_t){x + l->ink.x, wg->box.y + l->ink.y, l->ink.w, l->ink.h};
+		return r;
+	}
+
+	case SCR_TEXTBOX:
+		textbox_run(NULL, wg, NULL, &r);
+		return r;
+	}
+
+	return r;
+}
+
+// the widget changed - repaint where it was and where it is now
+static void changed(scr_t *scr, scr_widget_t *wg)
+{
+	mark_dirty(scr, wg->drawn);
+	wg->drawn = extent(wg);
+	mark_dirty(scr, wg->drawn);
+}
+
+static void draw_fill(scr_t *scr, scr_rect_t r, Color c, scr_rect_t clip)
+{
+	r = intersect(r, clip);
+	uint32_t p = pixel(c);
+
+	for (int y = r.y; y < r.y + r.h; y++)
+	{
+		uint32_t *dst = &scr->back[y * scr->w];
+
+		for (int x = r.x; x < r.x + r.w; x++)
+			dst[x] = c.a == 255 ? p : blend(dst[x], c, c.a);
+	}
+}
+
+static void draw_icon(scr_t *scr, const Image *img, int x, int y, Color tint, scr_rect_t clip)
+{
+	scr_rect_t r = intersect((scr_rect_t){x, y, img->width, img->height}, clip);
+	const uint8_t *rgba = img->data;
+
+	for (int py = r.y; py < r.y + r.h; py++)
+	{
+		const uint8_t *src = &rgba[((py - y) * img->width - x) * 4];
+		uint32_t *dst = &scr->back[py * scr->w];
+
+		for (int px = r.x; px < r.x + r.w; px++)
+		{
+			const uint8_t *s = &src[px * 4];
+			Color c = {s[0] * tint.r / 255, s[1] * tint.g / 255, s[2] * tint.b / 255, 255};
+
+			if (s[3])
+				dst[px] = blend(dst[px], c, s[3] * tint.a / 255);
+		}
+	}
+}
+
+static void draw_widget(scr_t *scr, const scr_widget_t *wg, scr_rect_t clip)
+{
+	switch (wg->kind)
+	{
+	case SCR_FILL:
+		draw_fill(scr, wg->box, wg->color, clip);
+		break;
+
+	case SCR_ICON:
+		draw_icon(scr, wg->img, wg->box.x, wg->box.y, wg->color, clip);
+		break;
+
+	case SCR_TEXT:
+	{
+		int w = scr_text_width(wg->font, wg->text, wg->spacing);
+		int x = wg->box.x - (wg->align == SCR_CENTER ? w / 2 : wg->align == SCR_RIGHT ? w : 0);
+
+		text_run(scr, wg->font, wg->text, SCR_TEXT_MAX, x, wg->box.y, wg->spacing, wg->color, &clip, NULL);
+		break;
+	}
+
+	case SCR_TEXTBOX:
+		textbox_run(scr, wg, &clip, NULL);
+		break;
+	}
+}
+
+int scr_init(scr_t *scr, const char *fb_path, int w, int h, Color bkg)
+{
+	memset(scr, 0, sizeof(*scr));
+	scr->w = w;
+	scr->h = h;
+	scr->bkg = bkg;
+
+	scr->fb_fd = open(fb_path, O_RDWR | O_CLOEXEC);
+	if (scr->fb_fd < 0)
+	{
+		perror("open framebuffer");
+		return 1;
+	}
+
+	struct fb_var_screeninfo vinfo;
+	struct fb_fix_screeninfo finfo;
+
+	if (ioctl(scr->fb_fd, FBIOGET_FSCREENINFO, &finfo) < 0 || ioctl(scr->fb_fd, FBIOGET_VSCREENINFO, &vinfo) < 0)
+	{
+		perror("framebuffer info");
+		close(scr->fb_fd);
+		return 1;
+	}
+
+	if (vinfo.bits_per_pixel != 32 || (int)vinfo.xres < w || (int)vinfo.yres < h)
+	{
+		fprintf(stderr, "Unsupported framebuffer: %ux%u, %u bpp\n", vinfo.xres, vinfo.yres, vinfo.bits_per_pixel);
+		close(scr->fb_fd);
+		return 1;
+	}
+
+	scr->stride = finfo.line_length / 4;
+	scr->fb_size = finfo.line_length * vinfo.yres;
+	scr->fb = mmap(0, scr->fb_size, PROT_READ | PROT_WRITE, MAP_SHARED, scr->fb_fd, 0);
+	if (scr->fb == MAP_FAILED)
+	{
+		perror("mmap framebuffer");
+		close(scr->fb_fd);
+		return 1;
+	}
+
+	scr->back = malloc(w * h * sizeof(uint32_t));
+	scr->front = malloc(w * h * sizeof(uint32_t));
+	if (scr->back == NULL || scr->front == NULL)
+	{
+		scr_cleanup(scr);
+		return 1;
+	}
+
+	// the screen content is unknown - nothing drawn can match this
+	memset(scr->front, 0xFF, w * h * sizeof(uint32_t));
+	mark_dirty(scr, (scr_rect_t){0, 0, w, h});
+
+	return 0;
+}
+
+void scr_cleanup(scr_t *scr)
+{
+	if (scr->fb != NULL && scr->fb != MAP_FAILED)
+		munmap(scr->fb, scr->fb_size);
+	close(scr->fb_fd);
+	free(scr->back);
+	free(scr->front);
+	scr->fb = NULL;
+	scr->back = scr->front = NULL;
+}
+
+int scr_assets_open(scr_assets_t *as, const char *path)
+{
+	struct stat st;
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+	as->map = NULL;
+	if (fd < 0 || fstat(fd, &st) < 0)
+	{
+		perror(path);
+		if (fd >= 0)
+			close(fd);
+		return 1;
+	}
+
+	// MAP_POPULATE: read it all now rather than page by page while drawing
+	as->len = st.st_size;
+	as->map = mmap(0, as->len, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+	close(fd);
+	if (as->map == MAP_FAILED)
+	{
+		perror(path);
+		as->map = NULL;
+		return 1;
+	}
+
+	const bd_header_t *hdr = as->map;
+	if (as->len < sizeof(*hdr) || memcmp(hdr->magic, BD_MAGIC, 4) != 0 || hdr->version != BD_VERSION ||
+		as->len < sizeof(*hdr) + hdr->num_fonts * sizeof(bd_font_t) + hdr->num_images * sizeof(bd_image_t))
+	{
+		fprintf(stderr, "%s: not an asset bundle of version %d\n", path, BD_VERSION);
+		scr_assets_close(as);
+		return 1;
+	}
+
+	return 0;
+}
+
+void scr_assets_close(scr_assets_t *as)
+{
+	if (as->map != NULL)
+		munmap(as->map, as->len);
+	as->map = NULL;
+}
+
+int scr_font_get(const scr_assets_t *as, scr_font_t *f, const char *name, int size)
+{
+	const bd_header_t *hdr = as->map;
+	const bd_font_t *ff = (const bd_font_t *)(hdr + 1);
+	const uint8_t *base = as->map;
+
+	for (uint16_t i = 0; i < hdr->num_fonts; i++, ff++)
+	{
+		if (ff->size != size || strncmp(ff->name, name, BD_NAME_LEN) != 0)
+			continue;
+
+		// every glyph has to be inside the file, '?' has to be there
+		if ((uint64_t)ff->glyphs + ff->count * sizeof(bd_glyph_t) > as->len ||
+			(uint64_t)ff->adv + ff->count > as->len || (uint64_t)ff->bits + ff->bits_len > as->len ||
+			ff->glyphs % 4 || ff->first > '?' || ff->first + ff->count <= '?')
+			break;
+
+		const bd_glyph_t *g = (const bd_glyph_t *)(base + ff->glyphs);
+		for (uint16_t k = 0; k < ff->count; k++)
+			if ((uint64_t)g[k].off + g[k].w * g[k].h > ff->bits_len)
+				goto bad;
+
+		// the cache may still hold layouts for whatever font was here
+		for (uint8_t k = 0; k < LAYOUT_CACHE_LEN; k++)
+			if (layout_cache[k].font == f)
+				layout_cache[k].font = NULL;
+
+		f->size = ff->size;
+		f->first = ff->first;
+		f->count = ff->count;
+		f->glyphs = g;
+		f->adv = base + ff->adv;
+		f->bits = base + ff->bits;
+
+		return 0;
+	}
+
+bad:
+	fprintf(stderr, "Font %s %d px: not in the asset bundle or damaged\n", name, size);
+	return 1;
+}
+
+int scr_image_get(const scr_assets_t *as, Image *img, const char *name)
+{
+	const bd_header_t *hdr = as->map;
+	const bd_image_t *im = (const bd_image_t *)((const bd_font_t *)(hdr + 1) + hdr->num_fonts);
+
+	for (uint16_t i = 0; i < hdr->num_images; i++, im++)
+	{
+		if (strncmp(im->name, name, BD_NAME_LEN) != 0)
+			continue;
+
+		if ((uint64_t)im->data + (uint64_t)im->w * im->h * 4 > as->len)
+			break;
+
+		// read-only, in the bundle - not for UnloadImage()
+		*img = (Image){(uint8_t *)as->map + im->data, im->w, im->h, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8};
+		return 0;
+	}
+
+	fprintf(stderr, "Image %s: not in the asset bundle or damaged\n", name);
+	return 1;
+}
+
+static scr_widget_t *add(scr_t *scr, uint8_t id, uint8_t kind, int x, int y, int w, int h)
+{
+	scr_widget_t *wg = &scr->wg[id];
+
+	memset(wg, 0, sizeof(*wg));
+	wg->kind = kind;
+	wg->visible = true;
+	wg->box = (scr_rect_t){x, y, w, h};
+	wg->color = WHITE;
+
+	return wg;
+}
+
+void scr_fill(scr_t *scr, uint8_t id, int x, int y, int w, int h, Color color)
+{
+	scr_widget_t *wg = add(scr, id, SCR_FILL, x, y, w, h);
+
+	wg->color = color;
+	changed(scr, wg);
+}
+
+void scr_text(scr_t *scr, uint8_t id, const scr_font_t *f, int x, int y, uint8_t align, int spacing)
+{
+	scr_widget_t *wg = add(scr, id, SCR_TEXT, x, y, 0, 0);
+
+	wg->font = f;
+	wg->align = align;
+	wg->spacing = spacing;
+}
+
+void scr_icon(scr_t *scr, uint8_t id, const Image *img, int x, int y)
+{
+	scr_widget_t *wg = add(scr, id, SCR_ICON, x, y, 0, 0);
+
+	wg->img = img;
+	changed(scr, wg);
+}
+
+void scr_textbox(scr_t *scr, uint8_t id, const scr_font_t *f, int x, int y, int w, int h)
+{
+	scr_widget_t *wg = add(scr, id, SCR_TEXTBOX, x, y, w, h);
+
+	wg->font = f;
+}
+
+void scr_set_text(scr_t *scr, uint8_t id, const char *text, Color color)
+{
+	scr_widget_t *wg = &scr->wg[id];
+
+	if (strncmp(wg->text, text, SCR_TEXT_MAX - 1) == 0 && memcmp(&wg->color, &color, sizeof(color)) == 0)
+		return;
+
+	snprintf(wg->text, sizeof(wg->text), "%s", text);
+	wg->color = color;
+	changed(scr, wg);
+}
+
+void scr_set_box(scr_t *scr, uint8_t id, int x, int y, int w, int h)
+{
+	scr_widget_t *wg = &scr->wg[id];
+	scr_rect_t box = {x, y, w, h};
+
+	if (wg->kind == SCR_TEXT || wg->kind == SCR_ICON)
+		box.w = box.h = 0;
+
+	if (memcmp(&wg->box, &box, sizeof(box)) == 0)
+		return;
+
+	wg->box = box;
+	changed(scr, wg);
+}
+
+void scr_set_color(scr_t *scr, uint8_t id, Color color)
+{
+	scr_widget_t *wg = &scr->wg[id];
+
+	if (memcmp(&wg->color, &color, sizeof(color)) == 0)
+		return;
+
+	wg->color = color;
+	changed(scr, wg);
+}
+
+void scr_set_visible(scr_t *scr, uint8_t id, bool visible)
+{
+	scr_widget_t *wg = &scr->wg[id];
+
+	if (wg->visible == visible)
+		return;
+
+	wg->visible = visible;
+	changed(scr, wg);
+}
+
+void scr_render(scr_t *scr)
+{
+	if (scr->num_dirty == 0)
+		return;
+
+	uint64_t t0 = now_ns();
+
+	// repaint the dirty areas in the back buffer
+	for (uint8_t i = 0; i < scr->num_dirty; i++)
+	{
+		scr_rect_t d = scr->dirty[i];
+
+		draw_fill(scr, d, scr->bkg, d);
+
+		for (uint8_t k = 0; k < SCR_MAX_WIDGETS; k++)
+			if (scr->wg[k].visible && intersect(scr->wg[k].drawn, d).w)
+				draw_widget(scr, &scr->wg[k], d);
+	}
+
+	// copy what differs from the screen, line by line
+	size_t fb_bytes = 0;
+	size_t first = SIZE_MAX, last = 0; // framebuffer pages written
+
+	for (uint8_t i = 0; i < scr->num_dirty; i++)
+	{
+		scr_rect_t d = scr->dirty[i];
+
+		for (int y = d.y; y < d.y + d.h; y++)
+		{
+			const uint32_t *b = &scr->back[y * scr->w];
+			uint32_t *f = &scr->front[y * scr->w];
+			int x0 = d.x, x1 = d.x + d.w - 1;
+
+			while (x0 <= x1 && b[x0] == f[x0])
+				x0++;
+			while (x1 >= x0 && b[x1] == f[x1])
+				x1--;
+			if (x0 > x1)
+				continue;
+
+			memcpy(&f[x0], &b[x0], (x1 - x0 + 1) * sizeof(uint32_t));
+			memcpy(&scr->fb[y * scr->stride + x0], &b[x0], (x1 - x0 + 1) * sizeof(uint32_t));
+
+			size_t off = (size_t)(y * scr->stride + x0) * 4;
+			fb_bytes += (x1 - x0 + 1) * 4;
+			if (off / FB_PAGE < first)
+				first = off / FB_PAGE;
+			if ((off + (x1 - x0) * 4) / FB_PAGE > last)
+				last = (off + (x1 - x0) * 4) / FB_PAGE;
+		}
+	}
+
+	scr->num_dirty = 0;
+
+	if (fb_bytes == 0)
+		return;
+
+	// the display driver sends the whole lines between the first and the
+	// last page written, as fbdev deferred I/O does
+	int line = scr->stride * 4;
+	int y0 = first * FB_PAGE / line;
+	int y1 = ((last + 1) * FB_PAGE - 1) / line;
+	if (y1 > scr->h - 1)
+		y1 = scr->h - 1;
+
+	uint64_t ns = now_ns() - t0;
+	scr->stats.updates++;
+	scr->stats.ns += ns;
+	if (ns > scr->stats.ns_max)
+		scr->stats.ns_max = ns;
+	scr->stats.fb_bytes += fb_bytes;
+	scr->stats.bus_bytes += (uint64_t)(y1 - y0 + 1) * scr->w * BUS_BPP;
+}
+
+void scr_print_stats(const scr_t *scr, FILE *f)
+{
+	const scr_stats_t *s = &scr->stats;
+
+	if (s->updates == 0)
+		return;
+
+	fprintf(f, "Display: %u updates, %.0f us mean, %.0f us max; per update %.0f B to the framebuffer, "
+			   "~%.0f B on the display bus (whole screen: %d B)\n",
+			s->updates, s->ns * 1e-3 / s->updates, s->ns_max * 1e-3, (double)s->fb_bytes / s->updates,
+			(double)s->bus_bytes / s->updates, scr->w * scr->h * BUS_BPP);
+	fprintf(f, "Text layout cache: %u hits, %u misses\n", layout_hits, layout_misses);
+}
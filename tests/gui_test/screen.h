@@ -0,0 +1,138 @@
+// Retained-mode widgets drawn straight into the framebuffer
+//
+// The screen is a list of widgets - filled rectangles, text, icons, wrapped
+// text - each keeping what it shows. Setting a widget to what it already
+// shows costs a compare; a change marks the area it covered and the area
+// it is going to cover as dirty. scr_render() repaints only the dirty areas:
+// every widget reaching into one is drawn again, clipped to it and in the
+// order of the widget ids, into a back buffer. Only pixels that differ
+// from the screen are then copied to the mmapped /dev/fb0, so a clock
+// update writes a few framebuffer lines instead of the whole screen.
+//
+// Everything is drawn by the CPU, no GPU context is needed. Icons and fonts
+// come ready to draw from the asset bundle mkbundle makes at build time,
+// and the layout of short text is cached, so an unchanged label is not
+// measured again.
+#ifndef SCREEN_H
+#define SCREEN_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <raylib.h>
+
+#include "bundle.h"
+
+#define SCR_MAX_WIDGETS 32
+#define SCR_MAX_DIRTY 16
+#define SCR_TEXT_MAX 832 // an M17 text message fits
+
+typedef struct
+{
+	int16_t x, y, w, h;
+} scr_rect_t;
+
+// widget kinds
+enum
+{
+	SCR_FILL,
+	SCR_TEXT,
+	SCR_ICON,
+	SCR_TEXTBOX // word-wrapped text
+};
+
+// SCR_TEXT alignment to its x position
+enum
+{
+	SCR_LEFT,
+	SCR_CENTER,
+	SCR_RIGHT
+};
+
+// font of one size, in the mmapped asset bundle
+typedef struct
+{
+	int size;				  // line height, px
+	int first, count;		  // codepoints first .. first + count - 1
+	const bd_glyph_t *glyphs; // ink boxes
+	const uint8_t *adv;		  // pen advance per glyph, px
+	const uint8_t *bits;	  // 8-bit coverage
+} scr_font_t;
+
+// asset bundle file
+typedef struct
+{
+	void *map;
+	size_t len;
+} scr_assets_t;
+
+typedef struct
+{
+	uint8_t kind;
+	bool visible;
+	scr_rect_t box;	 // FILL, TEXTBOX: the area; TEXT, ICON: the position
+	uint8_t align;	 // TEXT
+	int8_t spacing;	 // TEXT, TEXTBOX: extra px between glyphs
+	Color color;
+	const scr_font_t *font;
+	const Image *img; // ICON, R8G8B8A8
+	char text[SCR_TEXT_MAX];
+	scr_rect_t drawn; // area covered on the screen, w = 0 - none
+} scr_widget_t;
+
+// per scr_render() call that changed something
+typedef struct
+{
+	uint32_t updates;
+	uint64_t ns, ns_max; // rendering and copying
+	uint64_t fb_bytes;	 // written to the framebuffer
+	uint64_t bus_bytes;	 // estimated to be sent to the display
+} scr_stats_t;
+
+typedef struct
+{
+	int w, h;
+	Color bkg;
+
+	int fb_fd;
+	uint32_t *fb; // mmapped framebuffer, XRGB8888
+	size_t fb_size;
+	int stride;	  // pixels per framebuffer line
+
+	uint32_t *back;	 // frame being drawn
+	uint32_t *front; // what the framebuffer holds
+
+	scr_widget_t wg[SCR_MAX_WIDGETS];
+	scr_rect_t dirty[SCR_MAX_DIRTY];
+	uint8_t num_dirty;
+
+	scr_stats_t stats;
+} scr_t;
+
+int scr_init(scr_t *scr, const char *fb_path, int w, int h, Color bkg);
+void scr_cleanup(scr_t *scr);
+
+int scr_assets_open(scr_assets_t *as, const char *path);
+void scr_assets_close(scr_assets_t *as);
+int scr_font_get(const scr_assets_t *as, scr_font_t *f, const char *name, int size); // name: TTF without .ttf
+int scr_image_get(const scr_assets_t *as, Image *img, const char *name);			  // name: PNG without .png
+int scr_text_width(const scr_font_t *f, const char *text, int spacing);
+
+// widgets, created visible
+void scr_fill(scr_t *scr, uint8_t id, int x, int y, int w, int h, Color color);
+void scr_text(scr_t *scr, uint8_t id, const scr_font_t *f, int x, int y, uint8_t align, int spacing);
+void scr_icon(scr_t *scr, uint8_t id, const Image *img, int x, int y);
+void scr_textbox(scr_t *scr, uint8_t id, const scr_font_t *f, int x, int y, int w, int h);
+
+// changes, nothing is redrawn if the widget already shows that
+void scr_set_text(scr_t *scr, uint8_t id, const char *text, Color color);
+void scr_set_box(scr_t *scr, uint8_t id, int x, int y, int w, int h); // w, h: FILL and TEXTBOX only
+void scr_set_color(scr_t *scr, uint8_t id, Color color);
+void scr_set_visible(scr_t *scr, uint8_t id, bool visible);
+
+// draw the changes
+void scr_render(scr_t *scr);
+
+void scr_print_stats(const scr_t *scr, FILE *f);
+
+#endif
@@ -10,18 +10,27 @@
 #include <sys/mman.h>
 #include <sys/wait.h>
 #include <sys/prctl.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+#include <signal.h>
 #include <linux/fb.h>
 #include <time.h>
+#include <pthread.h>
 #include <m17.h>
 #include <raylib.h>
 #include <linux/input.h>
 #include <zmq.h>
-#include <arpa/inet.h>
 #include <sx1255.h>
+#include <sx1255-ctrl.h>
+#include <pmt.h>
 #include <liblinht-ctrl.h>
 #include <cyaml/cyaml.h>
 #include <sqlite3.h>
+#include <msgdb.h>
+#include <ledsched.h>
 #include "settings.h"
+#include "screen.h"
 
 // keymap states
 #define KEY_PRESS 0
@@ -32,9 +41,7 @@
 // GFX
 #define RES_X 160
 #define RES_Y 128
-#define IMG_PATH "/usr/share/linht/icons"
-
-bool raylib_debug = false;
+#define ASSETS "/usr/share/linht/assets.bin" // icons and fonts, made by mkbundle - see the Makefile
 
 enum
 {
@@ -47,7 +54,7 @@ enum
 	IMG_COUNT
 };
 
-Texture2D texture[IMG_COUNT];
+Image image[IMG_COUNT]; // R8G8B8A8, in the asset bundle
 
 enum
 {
@@ -57,7 +64,8 @@ enum
 
 uint8_t disp_state = DISP_VFO;
 
-Font customFont, customFont10, customFont12, customFont38, customFont14;
+scr_assets_t assets;
+scr_font_t font14, font28, font38;
 
 // settings
 config_t *conf;
@@ -71,12 +79,59 @@ int rval;
 const uint16_t rst_pin_offset = 22;
 const char *spi_device = "/dev/spidev0.0";
 const char *gpio_chip_path = "/dev/gpiochip0";
+sx1255_ctrl_t rf; // via the sx1255d broker if running, direct otherwise
+
+// LEDs - patterns are played from the main loop, never with usleep()
+enum
+{
+	LED_GREEN,
+	LED_RED,
+	LED_COUNT
+};
+
+ledsched_t leds;
+const ledsched_pattern_t msg_blink = {{100}, 1, 1}; // 100 ms on
+
+void led_out(uint8_t led, bool on)
+{
+	if (led == LED_GREEN)
+		linht_ctrl_green_led_set(on);
+	else if (led == LED_RED)
+		linht_ctrl_red_led_set(on);
+}
 
 // screen
-int fb;				   // framebuffer file handle
-size_t ssize;		   // screen size
-uint32_t *framebuffer; // framebuffer
-uint16_t cnt;
+const char *fb_path = "/dev/fb0";
+scr_t scr;
+
+// widgets, drawn in this order
+enum
+{
+	W_HEADER,
+	W_HEADER_LINE,
+	W_TIME,
+	W_GNSS,
+	W_BATT,
+
+	// VFO screen
+	W_MODE,
+	W_CAN,
+	W_SRC,
+	W_DST,
+	W_FREQ,
+	W_FREQ_10HZ, // last two digits, smaller
+	W_STR_SRC,
+	W_STR_DST,
+	W_ECD_SRC,
+	W_ECD_DST,
+	W_KNOB,
+
+	// message screen
+	W_MSG_FROM,
+	W_MSG_TEXT,
+
+	W_COUNT
+};
 
 // keyboard
 const char *kbd_path = "/dev/input/event0";
@@ -109,6 +164,7 @@ bool esc_pressed = false;
 // spawning flowgraphs (python)
 char *fg_path;
 pid_t fg_pid;
+sigset_t sigchld_mask; // SIGCHLD is blocked and read from a signalfd instead
 
 // messaging
 const char db_path[128] = "/var/lib/linht/messages.db";
@@ -158,6 +214,26 @@ const char knob_volt[] = "/sys/bus/iio/devices/iio:device0/in_voltage0_raw";
 int knob_fd;
 uint8_t knob_pos;
 
+// main loop - it sleeps in epoll_wait() until one of these is readable
+enum
+{
+	EVSRC_KBD,	 // keypad
+	EVSRC_ZMQ,	 // aux data from the flowgraph (ZMQ_FD)
+	EVSRC_LED,	 // LED scheduler timer
+	EVSRC_CHILD, // SIGCHLD - the flowgraph may have stopped
+	EVSRC_KNOB,	 // volume knob readout timer
+	EVSRC_TICK,	 // clock and battery voltage timer
+	EVSRC_COUNT
+};
+
+#define KNOB_MS 100	 // the ADC has no interrupt, so the knob is still polled
+#define TICK_MS 1000
+
+int epfd;
+int sig_fd;
+int knob_tfd;
+int tick_tfd;
+
 // misc
 uint8_t redraw_req = 1;
 const Color bkg_color = BLACK;
@@ -171,39 +247,52 @@ uint8_t disp_vfo_b, disp_aux_data = 1;
 char bv[8], bv_last[8];
 Color bv_col = WHITE;
 
-void load_gfx(void)
+int load_gfx(void)
 {
-	Image img;
-
-	img = LoadImage(IMG_PATH "/wallpaper.png");
-	ImageFormat(&img, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
-	texture[IMG_WALLPAPER] = LoadTextureFromImage(img);
-	UnloadImage(img);
-
-	img = LoadImage(IMG_PATH "/mute.png");
-	ImageFormat(&img, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
-	texture[IMG_MUTE] = LoadTextureFromImage(img);
-	UnloadImage(img);
-
-	img = LoadImage(IMG_PATH "/gnss.png");
-	ImageFormat(&img, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
-	texture[IMG_GNSS] = LoadTextureFromImage(img);
-	UnloadImage(img);
+	// PNG names in the icons directory
+	const char *name[IMG_COUNT] = {
+		[IMG_WALLPAPER] = "wallpaper",
+		[IMG_MUTE] = "mute",
+		[IMG_GNSS] = "gnss",
+		[IMG_BATT_100] = "batt_100",
+		[IMG_VFO_ACT] = "vfo_act",
+		[IMG_VFO_INACT] = "vfo_inact",
+	};
 
-	img = LoadImage(IMG_PATH "/batt_100.png");
-	ImageFormat(&img, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
-	texture[IMG_BATT_100] = LoadTextureFromImage(img);
-	UnloadImage(img);
+	// already decoded, drawn by the CPU straight from the bundle
+	for (uint8_t i = 0; i < IMG_COUNT; i++)
+		if (scr_image_get(&assets, &image[i], name[i]) != 0)
+			return 1;
 
-	img = LoadImage(IMG_PATH "/vfo_act.png");
-	ImageFormat(&img, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
-	texture[IMG_VFO_ACT] = LoadTextureFromImage(img);
-	UnloadImage(img);
+	return 0;
+}
 
-	img = LoadImage(IMG_PATH "/vfo_inact.png");
-	ImageFormat(&img, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
-	texture[IMG_VFO_INACT] = LoadTextureFromImage(img);
-	UnloadImage(img);
+// the screen's widgets, positions as they were drawn with raylib
+void layout_init(void)
+{
+	// header
+	scr_fill(&scr, W_HEADER, 0, 0, RES_X - 1, 17, top_bar_color);
+	scr_fill(&scr, W_HEADER_LINE, 0, 17, RES_X, 1, line_color);
+	scr_text(&scr, W_TIME, &font14, 2, 2, SCR_LEFT, 0);
+	scr_icon(&scr, W_GNSS, &image[IMG_GNSS], RES_X - 40, 1);
+	scr_text(&scr, W_BATT, &font14, RES_X - 2, 2, SCR_RIGHT, 0);
+
+	// VFO screen
+	scr_text(&scr, W_MODE, &font14, RES_X / 4, 20, SCR_CENTER, 1);
+	scr_text(&scr, W_CAN, &font14, RES_X / 4, 34, SCR_CENTER, 1);
+	scr_text(&scr, W_SRC, &font14, 3 * RES_X / 4, 20, SCR_CENTER, 1);
+	scr_text(&scr, W_DST, &font14, 3 * RES_X / 4, 34, SCR_CENTER, 1);
+	scr_text(&scr, W_FREQ, &font38, 0, 45, SCR_LEFT, 0);	   // moved as the width changes
+	scr_text(&scr, W_FREQ_10HZ, &font28, 0, 53, SCR_LEFT, 0); // ditto
+	scr_text(&scr, W_STR_SRC, &font14, RES_X / 4, 81, SCR_CENTER, 0);
+	scr_text(&scr, W_STR_DST, &font14, RES_X / 4, 95, SCR_CENTER, 0);
+	scr_text(&scr, W_ECD_SRC, &font14, 3 * RES_X / 4, 81, SCR_CENTER, 0);
+	scr_text(&scr, W_ECD_DST, &font14, 3 * RES_X / 4, 95, SCR_CENTER, 0);
+	scr_fill(&scr, W_KNOB, 2, RES_Y - 2 - 2, 2, 2, GRAY);
+
+	// message screen
+	scr_text(&scr, W_MSG_FROM, &font14, 2, 20, SCR_LEFT, 0);
+	scr_textbox(&scr, W_MSG_TEXT, &font14, 2, 40, RES_X - 1 - 2, RES_Y - 1 - 2);
 }
 
 /*Texture2D RenderTextToTexture(const char *text, Font font, int fontSize, Color color)
@@ -245,359 +334,81 @@ void kbd_cleanup(int fhandle)
 	close(fhandle);
 }
 
-uint8_t string_to_pmt(uint8_t *pmt, const char *msg)
+// periodic timer, first expiry right away
+int timer_open(uint32_t period_ms)
 {
-	pmt[0] = 2;						 // pmt type - zmq message
-	uint16_t l = htons(strlen(msg)); // length
-	memcpy(&pmt[1], &l, sizeof(l));
-	strcpy((char *)&pmt[3], msg);
+	int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	struct itimerspec its = {{period_ms / 1000, (period_ms % 1000) * 1000000L}, {0, 1}};
 
-	return 3 + strlen(msg);
-}
+	if (fd >= 0)
+		timerfd_settime(fd, 0, &its, NULL);
 
-void sx1255_pa_enable(bool ena)
-{
-	if (ena)
-	{
-		uint8_t tmp = sx1255_read_reg(0x00);
-		tmp |= (1 << 3);
-		sx1255_write_reg(0x00, tmp);
-	}
-	else
-	{
-		uint8_t tmp = sx1255_read_reg(0x00);
-		tmp &= (uint8_t)~(1 << 3);
-		sx1255_write_reg(0x00, tmp);
-	}
+	return fd;
 }
 
-// display misc stuff
-static void DrawTextBoxedSelectable(Font font, const char *text, Rectangle rec, float fontSize, float spacing, bool wordWrap, Color tint, int selectStart, int selectLength, Color selectTint, Color selectBackTint)
+int evsrc_add(int fd, uint32_t src)
 {
-	int length = TextLength(text); // Total length in bytes of the text, scanned by codepoints in loop
-
-	float textOffsetY = 0;	  // Offset between lines (on line break '\n')
-	float textOffsetX = 0.0f; // Offset X to next character to draw
-
-	float scaleFactor = fontSize / (float)font.baseSize; // Character rectangle scaling factor
-
-	// Word/character wrapping mechanism variables
-	enum
-	{
-		MEASURE_STATE = 0,
-		DRAW_STATE = 1
-	};
-	int state = wordWrap ? MEASURE_STATE : DRAW_STATE;
+	struct epoll_event ev = {.events = EPOLLIN, .data.u32 = src};
 
-	int startLine = -1; // Index where to begin drawing (where a line begins)
-	int endLine = -1;	// Index where to stop drawing (where a line ends)
-	int lastk = -1;		// Holds last value of the character position
-
-	for (int i = 0, k = 0; i < length; i++, k++)
-	{
-		// Get next codepoint from byte string and glyph index in font
-		int codepointByteCount = 0;
-		int codepoint = GetCodepoint(&text[i], &codepointByteCount);
-		int index = GetGlyphIndex(font, codepoint);
-
-		// NOTE: Normally we exit the decoding sequence as soon as a bad byte is found (and return 0x3f)
-		// but we need to draw all of the bad bytes using the '?' symbol moving one byte
-		if (codepoint == 0x3f)
-			codepointByteCount = 1;
-		i += (codepointByteCount - 1);
-
-		float glyphWidth = 0;
-		if (codepoint != '\n')
-		{
-			glyphWidth = (font.glyphs[index].advanceX == 0) ? font.recs[index].width * scaleFactor : font.glyphs[index].advanceX * scaleFactor;
-
-			if (i + 1 < length)
-				glyphWidth = glyphWidth + spacing;
-		}
-
-		// NOTE: When wordWrap is ON we first measure how much of the text we can draw before going outside of the rec container
-		// We store this info in startLine and endLine, then we change states, draw the text between those two variables
-		// and change states again and again recursively until the end of the text (or until we get outside of the container)
-		// When wordWrap is OFF we don't need the measure state so we go to the drawing state immediately
-		// and begin drawing on the next line before we can get outside the container
-		if (state == MEASURE_STATE)
-		{
-			// TODO: There are multiple types of spaces in UNICODE, maybe it's a good idea to add support for more
-			// Ref: http://jkorpela.fi/chars/spaces.html
-			if ((codepoint == ' ') || (codepoint == '\t') || (codepoint == '\n'))
-				endLine = i;
-
-			if ((textOffsetX + glyphWidth) > rec.width)
-			{
-				endLine = (endLine < 1) ? i : endLine;
-				if (i == endLine)
-					endLine -= codepointByteCount;
-				if ((startLine + codepointByteCount) == endLine)
-					endLine = (i - codepointByteCount);
-
-				state = !state;
-			}
-			else if ((i + 1) == length)
-			{
-				endLine = i;
-				state = !state;
-			}
-			else if (codepoint == '\n')
-				state = !state;
-
-			if (state == DRAW_STATE)
-			{
-				textOffsetX = 0;
-				i = startLine;
-				glyphWidth = 0;
-
-				// Save character position when we switch states
-				int tmp = lastk;
-				lastk = k - 1;
-				k = tmp;
-			}
-		}
-		else
-		{
-			if (codepoint == '\n')
-			{
-				if (!wordWrap)
-				{
-					textOffsetY += (font.baseSize + font.baseSize / 2) * scaleFactor / 1.5;
-					textOffsetX = 0;
-				}
-			}
-			else
-			{
-				if (!wordWrap && ((textOffsetX + glyphWidth) > rec.width))
-				{
-					textOffsetY += (font.baseSize + font.baseSize / 2) * scaleFactor / 1.5;
-					textOffsetX = 0;
-				}
-
-				// When text overflows rectangle height limit, just stop drawing
-				if ((textOffsetY + font.baseSize * scaleFactor) > rec.height)
-					break;
-
-				// Draw selection background
-				bool isGlyphSelected = false;
-				if ((selectStart >= 0) && (k >= selectStart) && (k < (selectStart + selectLength)))
-				{
-					DrawRectangleRec((Rectangle){rec.x + textOffsetX - 1, rec.y + textOffsetY, glyphWidth, (float)font.baseSize * scaleFactor}, selectBackTint);
-					isGlyphSelected = true;
-				}
-
-				// Draw current character glyph
-				if ((codepoint != ' ') && (codepoint != '\t'))
-				{
-					DrawTextCodepoint(font, codepoint, (Vector2){rec.x + textOffsetX, rec.y + textOffsetY}, fontSize, isGlyphSelected ? selectTint : tint);
-				}
-			}
-
-			if (wordWrap && (i == endLine))
-			{
-				textOffsetY += (font.baseSize + font.baseSize / 2) * scaleFactor / 1.5;
-				textOffsetX = 0;
-				startLine = endLine;
-				endLine = -1;
-				glyphWidth = 0;
-				selectStart += lastk - k;
-				k = lastk;
-
-				state = !state;
-			}
-		}
-
-		if ((textOffsetX != 0) || (codepoint != ' '))
-			textOffsetX += glyphWidth; // avoid leading spaces
-	}
+	return epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
 }
 
-static void DrawTextBoxed(Font font, const char *text, Rectangle rec, float fontSize, float spacing, bool wordWrap, Color tint)
-{
-	DrawTextBoxedSelectable(font, text, rec, fontSize, spacing, wordWrap, tint, 0, 0, WHITE, WHITE);
-}
-
-void displayMessage(const char *src, const char *dst, const char *msg)
+void sx1255_pa_enable(bool ena)
 {
-	char src_line[32], dst_line[32];
-
-	sprintf(src_line, "From: %s\n", src);
-	(void)dst;
-	(void)dst_line;
-
-	// clear drawing area
-	DrawRectangle(0, 18, RES_X - 1, RES_Y - 1, bkg_color);
-
-	DrawTextEx(customFont, src_line, (Vector2){2.0f, 20.0f}, 14.0f, 0, ORANGE);
-	DrawTextBoxed(customFont, msg, (Rectangle){2, 40, RES_X - 1 - 2, RES_Y - 1 - 2}, 14.0f, 0, true, WHITE);
+	// single read-modify-write, nobody else can touch reg 0x00 in between
+	sx1255_ctrl_update_reg(&rf, 0x00, (1 << 3), ena ? (1 << 3) : 0);
 }
 
-static inline uint16_t rd_u16(const uint8_t *p)
+// extract message data (SRC, DST, TYPE, META, SMS) from the decoder's PMT dict
+void getMsgData(message_t *m, uint16_t *type, const uint8_t *buf, size_t len)
 {
-	uint16_t v = ((uint16_t)p[0] << 8) | p[1];
-	return v;
-}
+	pmt_reader_t r;
+	pmt_item_t key, val;
 
-static inline uint32_t rd_u32(const uint8_t *p)
-{
-	uint32_t v = ((uint32_t)p[0] << 24) |
-				 ((uint32_t)p[1] << 16) |
-				 ((uint32_t)p[2] << 8) |
-				 p[3];
-	return v;
-}
+	m->src[0] = 0;
+	m->dst[0] = 0;
+	m->message[0] = 0;
+	*type = 0xFFFF;
 
-// extract message data (SRC, DST, TYPE, META, SMS)
-void getMsgData(char *src, char *dst, uint16_t *type, uint8_t meta[14], char *msg, const uint8_t *buf, size_t len)
-{
-	uint16_t idx = 0;
-	uint32_t field_len = 0;
-	char key[16] = {0};
-
-	if (src != NULL)
-		src[0] = 0;
-	if (dst != NULL)
-		dst[0] = 0;
-	if (msg != NULL)
-		msg[0] = 0;
-	if (type != NULL)
-		*type = 0xFFFF;
-
-	// NOTE: the parser below is based on reverse-engineered PMT format...
-	// TODO: fix it
-	while (idx < len - 1)
+	pmt_reader_init(&r, buf, len);
+	while (pmt_next_kv(&r, &key, &val) == 1)
 	{
-		if (buf[idx] == 0x09) // 0x09 - PMT_PAIR
+		if (pmt_symbol_eq(&key, "src"))
+			pmt_symbol_str(&val, m->src, sizeof(m->src));
+		else if (pmt_symbol_eq(&key, "dst"))
+			pmt_symbol_str(&val, m->dst, sizeof(m->dst));
+		else if (pmt_symbol_eq(&key, "sms"))
+			pmt_symbol_str(&val, m->message, sizeof(m->message));
+		else if (pmt_symbol_eq(&key, "type"))
 		{
-			idx++;
-			// omit serialization depth marker byte
-			idx++;
+			if (val.tag == PMT_UNIFORM_VECTOR && val.uv_type == PMT_UV_U8 && val.len >= 2)
+				*type = ((uint16_t)val.data[0] << 8) | val.data[1];
 		}
-		else if (buf[idx] == 0x02) // 0x02 - PMT_SYMBOL
+		else if (pmt_symbol_eq(&key, "meta"))
 		{
-			idx++;
-			field_len = rd_u16(&buf[idx]);
-			idx += 2;
-			memset(key, 0, field_len + 1); // +1 for the terminating null
-			memcpy(key, &buf[idx], field_len);
-			idx += field_len;
-			if (memcmp(key, "src", 3) == 0)
-			{
-				idx++; // omit the 0x02 byte for the value field of this pair
-				field_len = rd_u16(&buf[idx]);
-				idx += 2;
-				if (src != NULL)
-				{
-					memset(src, 0, field_len + 1); // +1 for the terminating null
-					memcpy(src, &buf[idx], field_len);
-				}
-				idx += field_len;
-			}
-			else if (memcmp(key, "dst", 3) == 0)
-			{
-				idx++; // omit the 0x02 byte for the value field of this pair
-				field_len = rd_u16(&buf[idx]);
-				idx += 2;
-				if (dst != NULL)
-				{
-					memset(dst, 0, field_len + 1); // +1 for the terminating null
-					memcpy(dst, &buf[idx], field_len);
-				}
-				idx += field_len;
-			}
-			else if (memcmp(key, "sms", 3) == 0)
-			{
-				idx++; // omit the 0x02 byte for the value field of this pair
-				field_len = rd_u16(&buf[idx]);
-				idx += 2;
-				if (msg != NULL)
-				{
-					memset(msg, 0, field_len + 1); // +1 for the terminating null
-					memcpy(msg, &buf[idx], field_len);
-				}
-				idx += field_len;
-			}
-			else if (memcmp(key, "type", 4) == 0)
-			{
-				idx++; // omit the 0x0A byte for the value field of this pair
-				idx++; // omit 1 byte
-				field_len = rd_u32(&buf[idx]);
-				idx += 4;
-				idx += 2; // omit 2 bytes
-				if (type != NULL)
-					*type = ((uint16_t)buf[idx] << 8) | buf[idx + 1]; // expected 2 bytes
-				idx += field_len;
-			}
-			else if (memcmp(key, "meta", 4) == 0)
-			{
-				idx++; // omit the 0x0A byte for the value field of this pair
-				idx++; // omit 1 byte
-				field_len = rd_u32(&buf[idx]);
-				idx += 4;
-				idx += 2; // omit 2 bytes
-				if (meta != NULL)
-					memcpy(meta, &buf[idx], field_len);
-				idx += field_len;
-			}
-			else // unexpected key
-			{
-				; // TODO: handle this properly
-			}
+			if (val.tag == PMT_UNIFORM_VECTOR && val.uv_type == PMT_UV_U8)
+				memcpy(m->meta, val.data, val.len < sizeof(m->meta) ? val.len : sizeof(m->meta));
 		}
+		// other keys are ignored
 	}
 
-	if (src != NULL)
-		if (src[0] == 0)
-			strcpy(src, "<unknown>");
-	if (dst != NULL)
-		if (dst[0] == 0)
-			strcpy(dst, "<unknown>");
-	if (msg != NULL)
-		if (msg[0] == 0)
-			strcpy(msg, "<empty>");
+	if (m->src[0] == 0)
+		strcpy(m->src, "<unknown>");
+	if (m->dst[0] == 0)
+		strcpy(m->dst, "<unknown>");
+	if (m->message[0] == 0)
+		strcpy(m->message, "<empty>");
 }
 
 // message database handlers
 int db_init(sqlite3 **db, const char *db_path)
 {
-	char *err_msg = NULL;
-
-	if (sqlite3_open(db_path, db) != SQLITE_OK)
-	{
-		fprintf(stderr, "Cannot open database: %s\n", sqlite3_errmsg(*db));
-		return 1;
-	}
-
-	sqlite3_busy_timeout(*db, 1000);
-	sqlite3_exec(*db, "PRAGMA journal_mode=WAL;", NULL, NULL, NULL);
-	sqlite3_exec(*db, "PRAGMA synchronous=NORMAL;", NULL, NULL, NULL);
-
-	const char *create_sql =
-		"CREATE TABLE IF NOT EXISTS messages ("
-		"id INTEGER PRIMARY KEY,"
-		"timestamp INTEGER,"
-		"protocol TEXT,"
-		"source TEXT,"
-		"destination TEXT,"
-		"meta BLOB,"
-		"message TEXT,"
-		"read INTEGER"
-		");";
-
-	if (sqlite3_exec(*db, create_sql, NULL, NULL, &err_msg) != SQLITE_OK)
-	{
-		fprintf(stderr, "Failed to ensure table exists: %s\n", err_msg);
-		sqlite3_free(err_msg);
-		sqlite3_close(*db);
+	// creates the table and applies any pending schema migrations
+	if (msgdb_open(db, db_path) != 0)
 		return 1;
-	}
 
 	// prepare SQL with placeholders
-	const char *sql = "INSERT INTO messages (timestamp, protocol, source, destination, meta, message, read) "
-					  "VALUES (?, ?, ?, ?, ?, ?, ?);";
-
-	if (sqlite3_prepare_v2(*db, sql, -1, &insert_msg_stmt, 0) != SQLITE_OK)
+	if (sqlite3_prepare_v2(*db, MSGDB_INSERT_SQL, -1, &insert_msg_stmt, 0) != SQLITE_OK)
 	{
 		fprintf(stderr, "Failed to prepare placeholder statement: %s\n", sqlite3_errmsg(*db));
 		sqlite3_close(*db);
@@ -605,18 +416,14 @@ int db_init(sqlite3 **db, const char *db_path)
 	}
 
 	// total message count
-	const char *sql2 = "SELECT COUNT(*) FROM messages;";
-
-	if (sqlite3_prepare_v2(*db, sql2, -1, &count_msg_stmt, 0) != SQLITE_OK)
+	if (sqlite3_prepare_v2(*db, MSGDB_COUNT_SQL, -1, &count_msg_stmt, 0) != SQLITE_OK)
 	{
 		fprintf(stderr, "Failed to prepare count statement: %s\n", sqlite3_errmsg(*db));
 		return 1;
 	}
 
-	// unread message count
-	const char *sql3 = "SELECT COUNT(*) FROM messages WHERE read = 0;";
-
-	if (sqlite3_prepare_v2(*db, sql3, -1, &unread_msg_count_stmt, 0) != SQLITE_OK)
+	// unread message count, O(1) - kept up to date by triggers
+	if (sqlite3_prepare_v2(*db, MSGDB_UNREAD_COUNT_SQL, -1, &unread_msg_count_stmt, 0) != SQLITE_OK)
 	{
 		fprintf(stderr, "Failed to prepare unread count statement: %s\n", sqlite3_errmsg(*db));
 		return 1;
@@ -692,31 +499,159 @@ int get_unread_message_count(void)
 // messaging
 void m17_send_sms(const char *msg)
 {
-	sx1255_enable_rx(false);
+	sx1255_ctrl_enable_rx(&rf, false);
 	sx1255_pa_enable(true);
 	linht_ctrl_tx_rx_switch_set(true);
-	linht_ctrl_red_led_set(true);
+	ledsched_base(&leds, LED_RED, true);
 
 	// transmission start
 	zmq_send(zmq_ptt_pub, sot_pmt, pmt_len, 0); // notify the ZMQ proxy
 	usleep(50 * 1000); // let the proxy switch
 	
 	// "SMS":"msg" PMT pair
-	uint8_t pmt[1024] = {0x07, 0x02, 0x00, 0x03, 0x53, 0x4D, 0x53, 0x02};
-	memcpy(&pmt[10], msg, strlen(msg)); // TODO: add 821-char limit
-	uint16_t l = htons(strlen(msg));	// length
-	memcpy(&pmt[8], &l, sizeof(l));
-	zmq_send(zmq_fg_pub, pmt, 8 + 2 + l, 0); // trigger baseband generation
+	uint8_t pmt[1024];
+	pmt_writer_t w;
+	size_t l = strnlen(msg, 821); // SMS payload limit
+	pmt_writer_init(&w, pmt, sizeof(pmt));
+	pmt_put_pair(&w);
+	pmt_put_symbol(&w, "SMS");
+	pmt_put_symbol_n(&w, msg, l);
+	zmq_send(zmq_fg_pub, pmt, w.len, 0); // trigger baseband generation
 
-	usleep(((3 + (1 + strlen(msg) + 1 + 2) / 25) * 40 + 20) * 1000); // 20ms extra
+	usleep(((3 + (1 + l + 1 + 2) / 25) * 40 + 20) * 1000); // 20ms extra
 
 	// transmission end
 	zmq_send(zmq_ptt_pub, eot_pmt, pmt_len, 0); // notify the ZMQ proxy
 
-	sx1255_enable_rx(true);
+	sx1255_ctrl_enable_rx(&rf, true);
 	sx1255_pa_enable(false);
 	linht_ctrl_tx_rx_switch_set(false);
-	linht_ctrl_red_led_set(false);
+	ledsched_base(&leds, LED_RED, false);
+}
+
+// aux data from the flowgraph (M17 messages etc.) - ZMQ_FD only signals
+// that something changed, so read until ZMQ_EVENTS says there is nothing left
+void zmq_rx(void)
+{
+	uint32_t events;
+	size_t sz = sizeof(events);
+
+	while (zmq_getsockopt(zmq_sub, ZMQ_EVENTS, &events, &sz) == 0 && (events & ZMQ_POLLIN))
+	{
+		uint8_t buf[1024];
+		int len = zmq_recv(zmq_sub, buf, sizeof(buf), ZMQ_DONTWAIT);
+		if (len > (int)sizeof(buf))
+			len = sizeof(buf); // truncated by zmq_recv
+		if (len > 0)
+		{
+			uint16_t type;
+			getMsgData(&msg, &type, buf, len);
+
+			// save to the database and display the contents only if it's a packet
+			if ((type & 1) == 0 && strlen(msg.message))
+			{
+				msg.timestamp = time(NULL);
+				sprintf(msg.protocol, "M17");
+				msg.read = 1;
+
+				// dump to database
+				fprintf(stderr, "Message from %s: %s\n", msg.src, msg.message);
+				push_message(&msg);
+
+				// prepare for display
+				strcpy(last_msg.src, msg.src);
+				strcpy(last_msg.dst, msg.dst);
+				strcpy(last_msg.text, msg.message);
+
+				// clear the struct for a new message
+				memset((uint8_t *)&msg, 0, sizeof(message_t));
+
+				// blink
+				ledsched_play(&leds, LED_GREEN, &msg_blink, 0);
+
+				disp_state = DISP_MSG;
+				redraw_req = 1;
+			}
+
+			// if it's a stream
+			else if (type & 1)
+			{
+				// extract data
+				strcpy(last_str.src, msg.src);
+				strcpy(last_str.dst, msg.dst);
+				memcpy(&last_str.type, &type, sizeof(type));
+				memcpy(last_str.meta, &msg.meta, sizeof(msg.meta));
+				redraw_req = 1;
+			}
+		}
+	}
+}
+
+// volume knob position
+void knob_update(void)
+{
+	char buf[16] = {0};
+
+	lseek(knob_fd, 0, SEEK_SET);
+	ssize_t n = read(knob_fd, buf, sizeof(buf) - 1);
+
+	if (n > 0)
+	{
+		buf[n] = 0;
+		int value = atoi(buf);
+		uint8_t tmp = (uint8_t)(255.0f * value / 3000.0f); // 3000 is slightly more than maximum
+		if (abs(knob_pos - tmp) > 5)					   // reduce wiggle
+		{
+			knob_pos = tmp;
+			redraw_req = 1;
+		}
+	}
+}
+
+// current time and battery voltage
+void status_update(void)
+{
+	char buf[16] = {0};
+
+	// battery voltage display
+	lseek(batt_fd, 0, SEEK_SET);
+	ssize_t n = read(batt_fd, buf, sizeof(buf) - 1);
+	uint16_t batt_mv = 0;
+
+	if (n > 0)
+	{
+		buf[n] = 0;
+		int value = atoi(buf);
+		batt_mv = (uint16_t)((float)value / 4096.0f * 1.8f * (39.0f + 10.0f) / 10.0f * 1000.0f);
+		snprintf(bv, sizeof(bv), "%d.%dV", batt_mv / 1000, (batt_mv % 1000) / 100);
+	}
+	else
+	{
+		snprintf(bv, sizeof(bv), "?.?V");
+	}
+
+	if (batt_mv >= 7400)
+		bv_col = GREEN;
+	else if (batt_mv >= 7000)
+		bv_col = ORANGE;
+	else
+		bv_col = RED;
+
+	if (strcmp(bv, bv_last))
+	{
+		strcpy(bv_last, bv);
+		redraw_req = 1;
+	}
+
+	// time display
+	t = time(NULL);
+	localtime_r(&t, &time_info);
+	snprintf(time_s, sizeof(time_s), "%02d:%02d", time_info.tm_hour, time_info.tm_min);
+	if (strcmp(time_s, time_s_last))
+	{
+		strcpy(time_s_last, time_s);
+		redraw_req = 1;
+	}
 }
 
 void fg_check(void)
@@ -736,9 +671,9 @@ void fg_check(void)
 	// if it died - resurrect it
 	// re-set RF hardware to RX mode
 	sx1255_pa_enable(false);
-	sx1255_enable_rx(true);
+	sx1255_ctrl_enable_rx(&rf, true);
 	linht_ctrl_tx_rx_switch_set(false);
-	linht_ctrl_red_led_set(false);
+	ledsched_base(&leds, LED_RED, false);
 	vfo_a_tx = false;
 
 	fprintf(stderr, "Flowgraph stopped");
@@ -763,6 +698,7 @@ void fg_check(void)
 		close(devnull);
 
 		prctl(PR_SET_PDEATHSIG, SIGTERM);
+		sigprocmask(SIG_UNBLOCK, &sigchld_mask, NULL); // the mask survives exec
 
 		execlp("python", "python",
 			   conf->channels.vfo_0.fg,
@@ -777,8 +713,166 @@ void fg_check(void)
 	}
 }
 
+// startup trace - each phase is timed where it runs, some run at the same time
+enum
+{
+	PH_SETTINGS,
+	PH_DB,
+	PH_HW,
+	PH_INPUT,
+	PH_ZMQ,
+	PH_DISPLAY,
+	PH_FG,
+	PH_EVENTS,
+	PH_COUNT
+};
+
+const char *ph_name[PH_COUNT] = {
+	[PH_SETTINGS] = "settings",
+	[PH_DB] = "message database",
+	[PH_HW] = "RF front end, LEDs",
+	[PH_INPUT] = "keyboard, ADCs",
+	[PH_ZMQ] = "ZeroMQ",
+	[PH_DISPLAY] = "display",
+	[PH_FG] = "flowgraph start",
+	[PH_EVENTS] = "main loop events",
+};
+
+uint64_t ph_start[PH_COUNT], ph_end[PH_COUNT]; // us
+uint64_t t_main, t_main_boot;				   // us at main(), since boot
+
+uint64_t clock_us(clockid_t clk)
+{
+	struct timespec ts;
+	clock_gettime(clk, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void phase_begin(uint8_t ph)
+{
+	ph_start[ph] = clock_us(CLOCK_MONOTONIC);
+}
+
+void phase_end(uint8_t ph)
+{
+	ph_end[ph] = clock_us(CLOCK_MONOTONIC);
+}
+
+void startup_report(void)
+{
+	uint64_t now = clock_us(CLOCK_MONOTONIC);
+
+	fprintf(stderr, "Startup (ms since start):\n");
+	for (uint8_t i = 0; i < PH_COUNT; i++)
+		fprintf(stderr, "  %-20s %7.1f - %7.1f  %7.1f\n", ph_name[i], (ph_start[i] - t_main) * 1e-3,
+				(ph_end[i] - t_main) * 1e-3, (ph_end[i] - ph_start[i]) * 1e-3);
+	fprintf(stderr, "Usable %.1f ms after start, %.1f ms after the kernel booted\n",
+			(now - t_main) * 1e-3, (t_main_boot + now - t_main) * 1e-3);
+}
+
+// the slow part of the startup, SPI and GPIO - run next to the rest of it
+int hw_err;
+
+void *hw_init_thread(void *arg)
+{
+	uint16_t rf_rate = conf->frontend.rf_sample_rate;
+	float freq_corr = conf->settings.rf.freq_corr;
+
+	(void)arg;
+	phase_begin(PH_HW);
+
+	// LEDs
+	if (ledsched_init(&leds, LED_COUNT, led_out) != 0)
+	{
+		fprintf(stderr, "Unable to set up the LED scheduler.\n");
+		hw_err = 1;
+		return NULL;
+	}
+
+	// SX1255 init and config
+	if (sx1255_ctrl_open(&rf, zmq_ctx, NULL, spi_device, gpio_chip_path, rst_pin_offset) != 0)
+	{
+		fprintf(stderr, "Can not initialize SX1255 device.\n");
+		hw_err = 1;
+		return NULL;
+	}
+
+	if (sx1255_ctrl_brokered(&rf))
+		fprintf(stderr, "Using SX1255 broker at %s\n", SX1255_CTRL_IPC);
+
+	sx1255_ctrl_reset(&rf);
+	if (rf_rate == 500)
+		sx1255_ctrl_set_rate(&rf, SX1255_RATE_500K);
+	else if (rf_rate == 250)
+		sx1255_ctrl_set_rate(&rf, SX1255_RATE_250K);
+	else if (rf_rate == 125)
+		sx1255_ctrl_set_rate(&rf, SX1255_RATE_125K);
+	sx1255_ctrl_set_rx_freq(&rf, conf->channels.vfo_0.rx_freq * (1.0 + freq_corr * 1e-6));
+	sx1255_ctrl_set_tx_freq(&rf, conf->channels.vfo_0.tx_freq * (1.0 + freq_corr * 1e-6));
+	sx1255_ctrl_set_lna_gain(&rf, conf->frontend.lna_gain);
+	sx1255_ctrl_set_pga_gain(&rf, conf->frontend.pga_gain);
+	sx1255_ctrl_set_dac_gain(&rf, conf->frontend.dac_gain);
+	sx1255_ctrl_set_mixer_gain(&rf, conf->frontend.mix_gain);
+	sx1255_ctrl_enable_rx(&rf, true);
+	sx1255_ctrl_enable_tx(&rf, true);
+	sx1255_pa_enable(false);
+
+    // Init and set Attenuators
+	linht_ctrl_atten_init();
+	linht_ctrl_atten_set(1, 0.0);
+    linht_ctrl_atten_set(2, 0.0);
+
+	// Disable PA on startup
+	linht_ctrl_pa_enable_set(false);
+
+	// Set to RF Switch to RX
+	linht_ctrl_tx_rx_switch_set(false);
+
+	fprintf(stderr, "SX1255 setup finished\n");
+
+	phase_end(PH_HW);
+	return NULL;
+}
+
+void *db_init_thread(void *arg)
+{
+	(void)arg;
+	phase_begin(PH_DB);
+
+	// initialize text message database
+	if (db_init(&msg_db, db_path) != 0)
+	{
+		fprintf(stderr, "Database initialization failed. Check permissions or path.\n");
+	}
+
+	phase_end(PH_DB);
+	return NULL;
+}
+
 int main(void)
 {
+	pthread_t hw_tid, db_tid;
+
+	t_main = clock_us(CLOCK_MONOTONIC);
+	t_main_boot = clock_us(CLOCK_BOOTTIME);
+
+	// SIGCHLD is taken from a signalfd in the main loop - blocked before any
+	// thread is started, so none of them gets it, and before the flowgraph is
+	// forked, so that one failing right away is not missed
+	sigemptyset(&sigchld_mask);
+	sigaddset(&sigchld_mask, SIGCHLD);
+	sigprocmask(SIG_BLOCK, &sigchld_mask, NULL);
+	sig_fd = signalfd(-1, &sigchld_mask, SFD_NONBLOCK | SFD_CLOEXEC);
+
+	// the database needs nothing else
+	if (pthread_create(&db_tid, NULL, db_init_thread, NULL) != 0)
+	{
+		fprintf(stderr, "Unable to start the database setup.\nExiting.\n");
+		return -1;
+	}
+
+	phase_begin(PH_SETTINGS);
+
 	// load settings
 	cyaml_config_t cfg =
 		{
@@ -830,9 +924,19 @@ int main(void)
 		fprintf(stderr, "-----------------------------\n");
 	}
 
-	// LEDs
-	linht_ctrl_green_led_set(false);
-	linht_ctrl_red_led_set(false);
+	phase_end(PH_SETTINGS);
+
+	// ZeroMQ, the SX1255 broker is reached through it too
+	zmq_ctx = zmq_ctx_new();
+
+	// the RF front end needs the settings, then nothing else
+	if (pthread_create(&hw_tid, NULL, hw_init_thread, NULL) != 0)
+	{
+		fprintf(stderr, "Unable to start the RF front end setup.\nExiting.\n");
+		return -1;
+	}
+
+	phase_begin(PH_INPUT);
 
 	// battery voltage
 	batt_fd = open(batt_volt, O_RDONLY | O_CLOEXEC);
@@ -850,58 +954,16 @@ int main(void)
 		return -1;
 	}
 
-	// SX1255 init and config
-	if (sx1255_init(spi_device, gpio_chip_path, rst_pin_offset) != 0)
-	{
-		fprintf(stderr, "Can not initialize SX1255 device.\nExiting.\n");
-		return -1;
-	}
-
-	sx1255_reset();
-	if (rf_rate == 500)
-		sx1255_set_rate(SX1255_RATE_500K);
-	else if (rf_rate == 250)
-		sx1255_set_rate(SX1255_RATE_250K);
-	else if (rf_rate == 125)
-		sx1255_set_rate(SX1255_RATE_125K);
-	sx1255_set_rx_freq(vfo_a_rx_f * (1.0 + freq_corr * 1e-6));
-	sx1255_set_tx_freq(vfo_a_tx_f * (1.0 + freq_corr * 1e-6));
-	sx1255_set_lna_gain(lna_gain);
-	sx1255_set_pga_gain(pga_gain);
-	sx1255_set_dac_gain(dac_gain);
-	sx1255_set_mixer_gain(mix_gain);
-	sx1255_enable_rx(true);
-	sx1255_enable_tx(true);
-	sx1255_pa_enable(false);
-
-    // Init and set Attenuators
-	linht_ctrl_atten_init();
-	linht_ctrl_atten_set(1, 0.0);
-    linht_ctrl_atten_set(2, 0.0);
-
-	// Disable PA on startup
-	linht_ctrl_pa_enable_set(false);
-
-	// Set to RF Switch to RX
-	linht_ctrl_tx_rx_switch_set(false);
-
-	fprintf(stderr, "SX1255 setup finished\n");
-
-	// initialize text message database
-	if (db_init(&msg_db, db_path) != 0)
-	{
-		fprintf(stderr, "Database initialization failed. Check permissions or path.\n");
-	}
-
 	// keyboard
 	if ((rval = kbd_init(&kbd, kbd_path)) != 0)
 	{
 		return rval;
 	}
 
-	// ZeroMQ and PMT
-	zmq_ctx = zmq_ctx_new();
+	phase_end(PH_INPUT);
+	phase_begin(PH_ZMQ);
 
+	// ZeroMQ and PMT
 	// PTT control (SOT/EOT for the ZMQ proxy)
 	zmq_ptt_pub = zmq_socket(zmq_ctx, ZMQ_PUB);
 
@@ -941,27 +1003,45 @@ int main(void)
 		return -1;
 	}
 
-	pmt_len = string_to_pmt(sot_pmt, "SOT");
-	string_to_pmt(eot_pmt, "EOT");
+	pmt_len = pmt_symbol(sot_pmt, sizeof(sot_pmt), "SOT");
+	pmt_symbol(eot_pmt, sizeof(eot_pmt), "EOT");
 
-	// init Raylib
-	fprintf(stderr, "Initializing Raylib...\n");
-	if (!raylib_debug)
-		SetTraceLogLevel(LOG_NONE);
-	InitWindow(RES_X, RES_Y, "GUI test");
-	SetWindowState(FLAG_VSYNC_HINT);
+	phase_end(PH_ZMQ);
+	phase_begin(PH_DISPLAY);
 
-	customFont = LoadFontEx("/usr/share/linht/fonts/Ubuntu-Regular.ttf", 28, 0, 250);
-	customFont10 = LoadFontEx("/usr/share/linht/fonts/UbuntuCondensed-Regular.ttf", 10, 0, 250);
-	customFont12 = LoadFontEx("/usr/share/linht/fonts/UbuntuCondensed-Regular.ttf", 12, 0, 250);
-	customFont14 = LoadFontEx("/usr/share/linht/fonts/Ubuntu-Regular.ttf", 14, 0, 250);
-	customFont38 = LoadFontEx("/usr/share/linht/fonts/Ubuntu-Regular.ttf", 38, 0, 250);
+	// display - drawn straight into the framebuffer
+	fprintf(stderr, "Initializing display...\n");
 
-	// load images
-	load_gfx();
+	if (scr_init(&scr, fb_path, RES_X, RES_Y, bkg_color) != 0)
+	{
+		fprintf(stderr, "Unable to use the framebuffer %s.\nExiting.\n", fb_path);
+		return -1;
+	}
 
-	// set FPS
-	SetTargetFPS(15);
+	// icons and fonts ready to draw, nothing to decode or rasterize
+	if (scr_assets_open(&assets, ASSETS) != 0 ||
+		scr_font_get(&assets, &font14, "Ubuntu-Regular", 14) != 0 ||
+		scr_font_get(&assets, &font28, "Ubuntu-Regular", 28) != 0 ||
+		scr_font_get(&assets, &font38, "Ubuntu-Regular", 38) != 0 ||
+		load_gfx() != 0)
+	{
+		fprintf(stderr, "Unable to load the assets from %s.\nExiting.\n", ASSETS);
+		return -1;
+	}
+
+	layout_init();
+
+	phase_end(PH_DISPLAY);
+
+	// the flowgraph talks to the SX1255 - it has to be set up first
+	pthread_join(hw_tid, NULL);
+	if (hw_err)
+	{
+		fprintf(stderr, "Exiting.\n");
+		return -1;
+	}
+
+	phase_begin(PH_FG);
 
 	// execute FG, TODO: the parameters are only OK for M17 FG
 	fg_path = conf->channels.vfo_0.fg;
@@ -986,6 +1066,7 @@ int main(void)
 		close(devnull); // close /dev/null
 
 		prctl(PR_SET_PDEATHSIG, SIGTERM);
+		sigprocmask(SIG_UNBLOCK, &sigchld_mask, NULL); // the mask survives exec
 		execlp("python", "python",
 			   fg_path,
 			   "-o", offs_str,
@@ -999,91 +1080,109 @@ int main(void)
 		exit(EXIT_FAILURE);
 	}
 
+	phase_end(PH_FG);
+
+	pthread_join(db_tid, NULL);
+
+	phase_begin(PH_EVENTS);
+
+	// event sources of the main loop
+	int zmq_fd;
+	size_t zmq_fd_len = sizeof(zmq_fd);
+	zmq_getsockopt(zmq_sub, ZMQ_FD, &zmq_fd, &zmq_fd_len);
+	knob_tfd = timer_open(KNOB_MS);
+	tick_tfd = timer_open(TICK_MS);
+	epfd = epoll_create1(EPOLL_CLOEXEC);
+
+	if (sig_fd < 0 || knob_tfd < 0 || tick_tfd < 0 || epfd < 0 ||
+		evsrc_add(kbd, EVSRC_KBD) != 0 ||
+		evsrc_add(zmq_fd, EVSRC_ZMQ) != 0 ||
+		evsrc_add(ledsched_fd(&leds), EVSRC_LED) != 0 ||
+		evsrc_add(sig_fd, EVSRC_CHILD) != 0 ||
+		evsrc_add(knob_tfd, EVSRC_KNOB) != 0 ||
+		evsrc_add(tick_tfd, EVSRC_TICK) != 0)
+	{
+		fprintf(stderr, "Unable to set up the main loop events.\nExiting.\n");
+		return -1;
+	}
+
+	// whatever arrived before ZMQ_FD was watched would not wake us up
+	zmq_rx();
+
+	phase_end(PH_EVENTS);
+
 	// ready!
+	startup_report();
 	fprintf(stderr, "Ready! Awaiting commands...\n");
 
 	// get time
 	esc_start = time(NULL);
 
-	// main loop
-	while (!WindowShouldClose())
+	// main loop - nothing happens between events, not even a redraw
+	while (1)
 	{
-		// check if the flowgraph is still running
-		fg_check();
-
-		// poll for terminal events even if no redrawing is required
-		PollInputEvents();
+		struct epoll_event evs[EVSRC_COUNT];
+		int nev = epoll_wait(epfd, evs, EVSRC_COUNT, -1);
+		bool kbd_ready = false;
 
-		// poll ZMQ (M17 messages etc.)
-		zmq_pollitem_t items[] = {{zmq_sub, 0, ZMQ_POLLIN, 0}};
-
-		int rc = zmq_poll(items, 1, 0); // timeout 0 = non-blocking
-		if (rc > 0 && (items[0].revents & ZMQ_POLLIN))
+		for (int e = 0; e < nev; e++)
 		{
-			uint8_t buf[1024];
-			int len = zmq_recv(zmq_sub, buf, sizeof(buf), 0);
-			if (len > 0)
+			struct signalfd_siginfo si;
+			uint64_t expired;
+
+			switch (evs[e].data.u32)
 			{
-				uint16_t type;
-				getMsgData(msg.src, msg.dst, &type, msg.meta, msg.message, buf, len);
+			case EVSRC_KBD:
+				kbd_ready = true;
+				break;
 
-				// save to the database and display the contents only if it's a packet
-				if ((type & 1) == 0 && strlen(msg.message))
-				{
-					msg.timestamp = time(NULL);
-					sprintf(msg.protocol, "M17");
-					msg.read = 1;
-
-					// dump to database
-					fprintf(stderr, "Message from %s: %s\n", msg.src, msg.message);
-					push_message(&msg);
-
-					// prepare for display
-					strcpy(last_msg.src, msg.src);
-					strcpy(last_msg.dst, msg.dst);
-					strcpy(last_msg.text, msg.message);
-
-					// clear the struct for a new message
-					memset((uint8_t *)&msg, 0, sizeof(message_t));
-
-					// blink
-					// TODO: this is bad - blocking, fix it
-					/*linht_ctrl_green_led_set(true);
-					usleep(100e3);
-					linht_ctrl_green_led_set(false);*/
-
-					disp_state = DISP_MSG;
-					redraw_req = 1;
-				}
+			case EVSRC_ZMQ:
+				zmq_rx();
+				break;
 
-				// if it's a stream
-				else if (type & 1)
-				{
-					// extract data
-					strcpy(last_str.src, msg.src);
-					strcpy(last_str.dst, msg.dst);
-					memcpy(&last_str.type, &type, sizeof(type));
-					memcpy(last_str.meta, &msg.meta, sizeof(msg.meta));
-					redraw_req = 1;
-				}
+			case EVSRC_LED:
+				ledsched_dispatch(&leds);
+				break;
+
+			case EVSRC_CHILD:
+				// check if the flowgraph is still running
+				while (read(sig_fd, &si, sizeof(si)) == sizeof(si))
+					;
+				fg_check();
+				break;
+
+			case EVSRC_KNOB:
+				if (read(knob_tfd, &expired, sizeof(expired)) > 0)
+					knob_update();
+				break;
+
+			case EVSRC_TICK:
+				if (read(tick_tfd, &expired, sizeof(expired)) > 0)
+					status_update();
+				break;
 			}
 		}
 
-		// check keypad events
-		struct input_event ev;
-		ssize_t n = read(kbd, &ev, sizeof(ev)); // non-blocking
-		if (n == (ssize_t)sizeof(ev) && ev.type == EV_KEY)
+		// check keypad events - all that are queued, not one per pass
+		struct input_event kev[64];
+		ssize_t n = kbd_ready ? read(kbd, kev, sizeof(kev)) : 0; // non-blocking
+		for (ssize_t e = 0; e < n / (ssize_t)sizeof(*kev); e++)
 		{
+			struct input_event ev = kev[e];
+
+			if (ev.type != EV_KEY)
+				continue;
+
 			if (ev.value == KEY_PRESS)
 			{
 				if (ev.code == KEY_P)
 				{
 					if (disp_state == DISP_VFO)
 					{
-						sx1255_enable_rx(false);
+						sx1255_ctrl_enable_rx(&rf, false);
 						sx1255_pa_enable(true);
 						linht_ctrl_tx_rx_switch_set(true); // TX
-						linht_ctrl_red_led_set(true);
+						ledsched_base(&leds, LED_RED, true);
 						zmq_send(zmq_ptt_pub, sot_pmt, pmt_len, 0); // notify the ZMQ proxy
 						zmq_send(zmq_fg_pub, sot_pmt, pmt_len, 0);	// notify the GR flowgraph
 						vfo_a_tx = true;
@@ -1097,8 +1196,8 @@ int main(void)
 					{
 						vfo_a_rx_f += 12500;
 						vfo_a_tx_f += 12500;
-						sx1255_set_rx_freq(vfo_a_rx_f * (1.0 + freq_corr * 1e-6));
-						sx1255_set_tx_freq(vfo_a_tx_f * (1.0 + freq_corr * 1e-6));
+						sx1255_ctrl_set_rx_freq(&rf, vfo_a_rx_f * (1.0 + freq_corr * 1e-6));
+						sx1255_ctrl_set_tx_freq(&rf, vfo_a_tx_f * (1.0 + freq_corr * 1e-6));
 						redraw_req = 1;
 					}
 				}
@@ -1108,8 +1207,8 @@ int main(void)
 					{
 						vfo_a_rx_f -= 12500;
 						vfo_a_tx_f -= 12500;
-						sx1255_set_rx_freq(vfo_a_rx_f * (1.0 + freq_corr * 1e-6));
-						sx1255_set_tx_freq(vfo_a_tx_f * (1.0 + freq_corr * 1e-6));
+						sx1255_ctrl_set_rx_freq(&rf, vfo_a_rx_f * (1.0 + freq_corr * 1e-6));
+						sx1255_ctrl_set_tx_freq(&rf, vfo_a_tx_f * (1.0 + freq_corr * 1e-6));
 						redraw_req = 1;
 					}
 				}
@@ -1166,10 +1265,10 @@ int main(void)
 						usleep(vfo_a_tx_sust * 1000);
 						zmq_send(zmq_ptt_pub, eot_pmt, pmt_len, 0); // notify the ZMQ proxy
 
-						sx1255_enable_rx(true);
+						sx1255_ctrl_enable_rx(&rf, true);
 						sx1255_pa_enable(false);
 						linht_ctrl_tx_rx_switch_set(false); // RX
-						linht_ctrl_red_led_set(false);
+						ledsched_base(&leds, LED_RED, false);
 						vfo_a_tx = false;
 						fprintf(stderr, "PTT released\n");
 						redraw_req = 1;
@@ -1202,211 +1301,81 @@ int main(void)
 			redraw_req = 1;
 		}
 
-		// less critical checks
-		char buf[16] = {0};
-		if (cnt % 20 == 0)
-		{
-			// volume knob position
-			lseek(knob_fd, 0, SEEK_SET);
-			n = read(knob_fd, buf, sizeof(buf) - 1);
-
-			if (n > 0)
-			{
-				buf[n] = 0;
-				int value = atoi(buf);
-				uint8_t tmp = (uint8_t)(255.0f * value / 3000.0f); // 3000 is slightly more than maximum
-				if (abs(knob_pos - tmp) > 5)					   // reduce wiggle
-				{
-					knob_pos = tmp;
-					redraw_req = 1;
-				}
-			}
-		}
-
-		// occasional checks - current time and battery voltage
-		if (cnt % 200 == 0)
-		{
-			// battery voltage display
-			lseek(batt_fd, 0, SEEK_SET);
-			n = read(batt_fd, buf, sizeof(buf) - 1);
-			uint16_t batt_mv = 0;
-
-			if (n > 0)
-			{
-				buf[n] = 0;
-				int value = atoi(buf);
-				batt_mv = (uint16_t)((float)value / 4096.0f * 1.8f * (39.0f + 10.0f) / 10.0f * 1000.0f);
-				snprintf(bv, sizeof(bv), "%d.%dV", batt_mv / 1000, (batt_mv % 1000) / 100);
-			}
-			else
-			{
-				snprintf(bv, sizeof(bv), "?.?V");
-			}
-
-			if (batt_mv >= 7400)
-				bv_col = GREEN;
-			else if (batt_mv >= 7000)
-				bv_col = ORANGE;
-			else
-				bv_col = RED;
-
-			if (strcmp(bv, bv_last))
-			{
-				strcpy(bv_last, bv);
-				redraw_req = 1;
-			}
-
-			// time display
-			t = time(NULL);
-			localtime_r(&t, &time_info);
-			snprintf(time_s, sizeof(time_s), "%02d:%02d", time_info.tm_hour, time_info.tm_min);
-			if (strcmp(time_s, time_s_last))
-			{
-				strcpy(time_s_last, time_s);
-				redraw_req = 1;
-			}
-		}
-
 		if (redraw_req)
 		{
-			BeginDrawing();
-
-			// clear screen
-			ClearBackground(bkg_color);
-
-			// draw the wallpaper
-			// DrawTexture(texture[IMG_WALLPAPER], 0, 0, WHITE);
+			// push the state into the widgets - only the ones that change are drawn again
+			scr_set_text(&scr, W_TIME, time_s, RAYWHITE);
+			scr_set_visible(&scr, W_GNSS, gnss_display);
+			scr_set_text(&scr, W_BATT, bv, bv_col);
 
-			// draw header
-			DrawRectangle(0, 0, RES_X - 1, 17, top_bar_color);
-			DrawLine(0, 17, RES_X - 1, 17, line_color);
-
-			// top to bottom, left to right (more or less)
-			DrawTextEx(customFont14, time_s, (Vector2){2, 2}, 14, 0, RAYWHITE);
-
-			// GNSS
-			if (gnss_display)
-				DrawTexture(texture[IMG_GNSS], RES_X - 40, 1, WHITE);
-
-			// battery voltage - icon or text (right-aligned)
-			// DrawTexture(texture[IMG_BATT_100], RES_X - 24, 2, WHITE);
-			Vector2 size = MeasureTextEx(customFont, bv, 14.0f, 0);
-			DrawTextEx(customFont14, bv, (Vector2){RES_X - size.x - 2.0f, 2.0f}, 14.0f, 0, bv_col);
+			for (uint8_t i = W_MODE; i <= W_KNOB; i++)
+				scr_set_visible(&scr, i, disp_state == DISP_VFO);
+			for (uint8_t i = W_MSG_FROM; i <= W_MSG_TEXT; i++)
+				scr_set_visible(&scr, i, disp_state == DISP_MSG);
 
 			if (disp_state == DISP_VFO)
 			{
-				// VFO A
-				// DrawTexture(texture[IMG_VFO_ACT], 2, 23, WHITE);
-				// DrawTextEx(customFont, "A", (Vector2){4.5f, 22.0f}, 16.0f, 0, WHITE);
-				// DrawTextEx(customFont10, "VFO", (Vector2){3.0f, 38.0f}, 10.0f, 1, WHITE);
-
-				float width = MeasureTextEx(customFont14, conf->channels.vfo_0.extra.mode, 14.0f, 1).x;
-				DrawTextEx(customFont14, conf->channels.vfo_0.extra.mode, (Vector2){(RES_X / 4 - width / 2), 20.0f}, 14.0f, 1, BLUE);
+				// VFO A (VFO B is not displayed yet)
 				char can_line[8];
 				sprintf(can_line, "CAN %d", conf->channels.vfo_0.extra.can);
-				width = MeasureTextEx(customFont14, can_line, 14.0f, 1).x;
-				DrawTextEx(customFont14, can_line, (Vector2){RES_X / 4 - width / 2, 34.0f}, 14.0f, 1, BLUE);
-
-				width = MeasureTextEx(customFont14, conf->channels.vfo_0.extra.src, 14.0f, 1).x;
-				DrawTextEx(customFont14, conf->channels.vfo_0.extra.src, (Vector2){(3 * RES_X / 4 - width / 2), 20.0f}, 14.0f, 1, BLUE);
-				width = MeasureTextEx(customFont14, conf->channels.vfo_0.extra.dst, 14.0f, 1).x;
-				DrawTextEx(customFont14, conf->channels.vfo_0.extra.dst, (Vector2){3 * RES_X / 4 - width / 2, 34.0f}, 14.0f, 1, BLUE);
-				// DrawTexture(texture[IMG_MUTE], 140, 28, WHITE); //'vfo a mute' icon
+				scr_set_text(&scr, W_MODE, conf->channels.vfo_0.extra.mode, BLUE);
+				scr_set_text(&scr, W_CAN, can_line, BLUE);
+				scr_set_text(&scr, W_SRC, conf->channels.vfo_0.extra.src, BLUE);
+				scr_set_text(&scr, W_DST, conf->channels.vfo_0.extra.dst, BLUE);
 
 				char freq_a_str_1[10];
 				char freq_a_str_2[3];
 				uint32_t freq_a = vfo_a_tx ? vfo_a_tx_f : vfo_a_rx_f;
+				Color freq_col = vfo_a_tx ? RED : (Color){230, 230, 230, 255};
 				snprintf(freq_a_str_1, sizeof(freq_a_str_1), "%d.%03d", freq_a / 1000000, (freq_a % 1000000) / 1000);
 				snprintf(freq_a_str_2, sizeof(freq_a_str_2), "%02d", (freq_a % 1000) / 10);
-				width = MeasureTextEx(customFont38, freq_a_str_1, 38.0f, 0).x + 2 + MeasureTextEx(customFont, freq_a_str_2, 28.0f, 0).x;
-				DrawTextEx(customFont38, freq_a_str_1, (Vector2){(RES_X - width) / 2.0f, 45.0f}, 38.0f, 0, vfo_a_tx ? RED : (Color){230, 230, 230, 255});
-				DrawTextEx(customFont, freq_a_str_2, (Vector2){(RES_X - width) / 2.0f + MeasureTextEx(customFont38, freq_a_str_1, 38.0f, 0).x + 2, 53.0f}, 28.0f, 0, vfo_a_tx ? RED : (Color){230, 230, 230, 255});
-
-				/*if (disp_vfo_b)
-				{
-					// horizontal separating bar
-					DrawLine(0, 74, RES_X - 1, 74, (Color){0x60, 0x60, 0x60, 0xFF});
-
-					// VFO B
-					DrawTexture(texture[IMG_VFO_ACT], 2, 79, WHITE);
-					DrawTextEx(customFont, "B", (Vector2){4.5f, 78.0f}, 16.0f, 0, WHITE);
-					DrawTextEx(customFont10, "VFO", (Vector2){3.0f, 94.0f}, 10.0f, 1, WHITE);
-					char freq_b_str[10];
-					uint32_t freq_b = vfo_b_tx ? vfo_b_tx_f : vfo_b_rx_f;
-					snprintf(freq_b_str, sizeof(freq_b_str), "%d.%03d", freq_b / 1000000, (freq_b % 1000000) / 1000);
-					DrawTextEx(customFont, freq_b_str, (Vector2){21.0f, 74.0f}, (float)customFont.baseSize, 0, WHITE);
-					snprintf(freq_b_str, sizeof(freq_b_str), "%02d", (freq_b % 1000) / 10);
-					DrawTextEx(customFont, freq_b_str, (Vector2){113.0f, 84.0f}, 16.0f, 0, WHITE);
-					DrawTextEx(customFont12, "12.5k", (Vector2){21.0f, 100.0f}, 12.0f, 1, BLUE);
-					DrawTextEx(customFont12, "127.3", (Vector2){50.0f, 100.0f}, 12.0f, 1, BLUE);
-					DrawTextEx(customFont12, "-7.6M", (Vector2){79.0f, 100.0f}, 12.0f, 1, BLUE);
-					DrawTextEx(customFont12, "FM", (Vector2){21.0f, 112.0f}, 12.0f, 1, GREEN);
-					DrawTexture(texture[IMG_MUTE], 140, 84, WHITE); //'vfo b mute' icon
-				}*/
-
-				if (disp_aux_data)
+				int width_1 = scr_text_width(&font38, freq_a_str_1, 0);
+				int width = width_1 + 2 + scr_text_width(&font28, freq_a_str_2, 0);
+				scr_set_text(&scr, W_FREQ, freq_a_str_1, freq_col);
+				scr_set_box(&scr, W_FREQ, (RES_X - width) / 2, 45, 0, 0);
+				scr_set_text(&scr, W_FREQ_10HZ, freq_a_str_2, freq_col);
+				scr_set_box(&scr, W_FREQ_10HZ, (RES_X - width) / 2 + width_1 + 2, 53, 0, 0);
+
+				// if SRC and DST fields are valid - display them
+				bool str_valid = disp_aux_data && last_str.src[0] != 0 && last_str.dst[0] != 0;
+				scr_set_text(&scr, W_STR_SRC, str_valid ? last_str.src : "", MAGENTA);
+				scr_set_text(&scr, W_STR_DST, str_valid ? last_str.dst : "", MAGENTA);
+
+				// if ECD present, display it
+				char ext_src[10] = "", ext_dst[10] = "";
+				if (disp_aux_data && ((last_str.type >> 5) & 3) == 2)
 				{
-					char line[64] = {0};
-					Vector2 size;
-
-					// if SRC and DST fields are valid - display them
-					if (last_str.src[0] != 0 && last_str.dst[0] != 0)
-					{
-						sprintf(line, "%s", last_str.src);
-						size = MeasureTextEx(customFont14, line, 14.0f, 0);
-						DrawTextEx(customFont14, line, (Vector2){(RES_X / 4 - size.x / 2), 81.0f}, 14.0f, 0, MAGENTA);
-						sprintf(line, "%s", last_str.dst);
-						size = MeasureTextEx(customFont14, line, 14.0f, 0);
-						DrawTextEx(customFont14, line, (Vector2){(RES_X / 4 - size.x / 2), 95.0f}, 14.0f, 0, MAGENTA);
-					}
-
-					// if ECD present, display it
-					if (((last_str.type >> 5) & 3) == 2)
-					{
-						char ext_src[10] = "", ext_dst[10] = "";
-						decode_callsign_bytes(ext_src, &last_str.meta[0]);
-						decode_callsign_bytes(ext_dst, &last_str.meta[6]);
-
-						sprintf(line, "%s", ext_src);
-						size = MeasureTextEx(customFont14, line, 14.0f, 0);
-						DrawTextEx(customFont14, line, (Vector2){3 * RES_X / 4 - size.x / 2, 81.0f}, 14.0f, 0, MAGENTA);
-						sprintf(line, "%s", ext_dst);
-						size = MeasureTextEx(customFont14, line, 14.0f, 0);
-						DrawTextEx(customFont14, line, (Vector2){3 * RES_X / 4 - size.x / 2, 95.0f}, 14.0f, 0, MAGENTA);
-					}
+					decode_callsign_bytes(ext_src, &last_str.meta[0]);
+					decode_callsign_bytes(ext_dst, &last_str.meta[6]);
 				}
+				scr_set_text(&scr, W_ECD_SRC, ext_src, MAGENTA);
+				scr_set_text(&scr, W_ECD_DST, ext_dst, MAGENTA);
 
-				DrawRectangle(2, RES_Y - 2 - 2, 2 + knob_pos / 255.0f * (RES_X - 4 - 2), 2, GRAY);
+				scr_set_box(&scr, W_KNOB, 2, RES_Y - 2 - 2, 2 + knob_pos / 255.0f * (RES_X - 4 - 2), 2);
 			}
 			else if (disp_state == DISP_MSG)
 			{
-				displayMessage(last_msg.src, last_msg.dst, last_msg.text);
+				char src_line[32];
+				snprintf(src_line, sizeof(src_line), "From: %s", last_msg.src);
+				scr_set_text(&scr, W_MSG_FROM, src_line, ORANGE);
+				scr_set_text(&scr, W_MSG_TEXT, last_msg.text, WHITE);
 			}
 
-			EndDrawing();
+			scr_render(&scr);
 
 			redraw_req = 0;
 		}
-
-		// frame counter
-		cnt++;
-		cnt %= 5 * 200;
-
-		// reduce CPU congestion
-		usleep(5e3);
 	}
 
 	// cleanup
 	fprintf(stderr, "Exit code caught. Cleaning up...\n");
-	for (uint8_t i = 0; i < IMG_COUNT; i++)
-	UnloadTexture(texture[i]);
-	UnloadFont(customFont);
-	UnloadFont(customFont10);
-	UnloadFont(customFont12);
-	UnloadFont(customFont38);
-	UnloadFont(customFont14);
+	scr_print_stats(&scr, stderr);
 	kbd_cleanup(kbd);
-	sx1255_cleanup();
+	close(epfd);
+	close(sig_fd);
+	close(knob_tfd);
+	close(tick_tfd);
+	sx1255_ctrl_close(&rf);
 
 	linht_ctrl_atten_cleanup(); // Cleanup attenuator control
 	linht_ctrl_pa_enable_set(false); // Disable PA
@@ -1419,7 +1388,8 @@ int main(void)
 	zmq_ctx_destroy(zmq_ctx);
 	cyaml_free(&cfg, &config_schema, conf, 0);
 	db_cleanup();
-	CloseWindow();
+	scr_cleanup(&scr);
+	scr_assets_close(&assets);
 	fprintf(stderr, "Cleanup done. Exiting.\n");
 
 	return 0;
@@ -0,0 +1,38 @@
+#include "crc16.h"
+
+#define POLY 0x5935
+
+// tab[k][b]: CRC contribution of byte b followed by k zero bytes
+static uint16_t tab[8][256];
+
+void crc16_init(void)
+{
+    for (uint16_t b = 0; b < 256; b++)
+    {
+        uint16_t crc = b << 8;
+        for (uint8_t i = 0; i < 8; i++)
+            crc = (crc & 0x8000) ? (crc << 1) ^ POLY : crc << 1;
+        tab[0][b] = crc;
+    }
+
+    for (uint8_t k = 1; k < 8; k++)
+        for (uint16_t b = 0; b < 256; b++)
+            tab[k][b] = (tab[k - 1][b] << 8) ^ tab[0][tab[k - 1][b] >> 8];
+}
+
+uint16_t crc16_m17(uint16_t crc, const uint8_t *data, uint16_t len)
+{
+    // the CRC only overlaps the first two bytes of a block
+    for (; len >= 8; len -= 8, data += 8)
+    {
+        crc ^= ((uint16_t)data[0] << 8) | data[1];
+        crc = tab[7][crc >> 8] ^ tab[6][crc & 0xFF] ^
+              tab[5][data[2]] ^ tab[4][data[3]] ^ tab[3][data[4]] ^
+              tab[2][data[5]] ^ tab[1][data[6]] ^ tab[0][data[7]];
+    }
+
+    for (; len; len--, data++)
+        crc = (crc << 8) ^ tab[0][(crc >> 8) ^ *data];
+
+    return crc;
+}
@@ -0,0 +1,20 @@
+// M17 CRC-16 (polynomial 0x5935, initial value 0xFFFF), slice-by-8
+//
+// Same result as libm17's CRC_M17(), which goes bit by bit. Here 8 bytes
+// take 8 table lookups, and the CRC can be carried on across calls, so a
+// packet is checked frame by frame as it comes in.
+#ifndef CRC16_H
+#define CRC16_H
+
+#include <stdint.h>
+
+#define CRC16_M17_INIT 0xFFFF
+
+// Build the tables, call once before use
+void crc16_init(void);
+
+// CRC of `data` continued from `crc` (CRC16_M17_INIT for a new one).
+// Over data followed by its own CRC (big-endian) the result is 0
+uint16_t crc16_m17(uint16_t crc, const uint8_t *data, uint16_t len);
+
+#endif
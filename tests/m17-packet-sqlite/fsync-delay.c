@@ -0,0 +1,40 @@
+// LD_PRELOAD shim for m17-db-bench: every fsync()/fdatasync() takes an
+// extra FSYNC_DELAY_US (default 500 us), standing in for slow flash, so the
+// cost of a commit shows even on tmpfs.
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <unistd.h>
+#include <dlfcn.h>
+
+static void delay(void)
+{
+    static int us = -1;
+
+    if (us < 0)
+    {
+        const char *e = getenv("FSYNC_DELAY_US");
+        us = e ? atoi(e) : 500;
+    }
+
+    usleep(us);
+}
+
+int fsync(int fd)
+{
+    static int (*real)(int);
+
+    if (!real)
+        real = (int (*)(int))dlsym(RTLD_NEXT, "fsync");
+    delay();
+    return real(fd);
+}
+
+int fdatasync(int fd)
+{
+    static int (*real)(int);
+
+    if (!real)
+        real = (int (*)(int))dlsym(RTLD_NEXT, "fdatasync");
+    delay();
+    return real(fd);
+}
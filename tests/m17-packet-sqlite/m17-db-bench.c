@@ -0,0 +1,193 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sqlite3.h>
+#include <msgdb.h>
+
+#include "sink.h"
+
+char db_path[128] = "/dev/shm/m17-db-bench.db";
+uint32_t num_msgs = 10000;
+bool old_path = false;
+
+const char text[] = "Hello world, this is a test message of moderate length.";
+
+void print_help(const char *program_name)
+{
+    printf("Message database insert benchmark\n\n");
+    printf("Inserts text messages the way m17-packet-sqlite does and prints the\n");
+    printf("time per message. The database is deleted first.\n\n");
+    printf("Usage: %s [OPTIONS]\n\n", program_name);
+    printf("Optional options:\n");
+    printf("  -n, --messages            Number of messages (default 10000)\n");
+    printf("  -d, --database            Database file (default %s)\n", db_path);
+    printf("  -o, --old                 Open, prepare, insert and close per message, as before\n");
+    printf("                            the sink thread (original table, rollback journal)\n");
+    printf("  -h, --help                Display this help message and exit\n");
+    printf("\n");
+    printf("Without -o the messages go through sink_publish() to the sqlite sink,\n");
+    printf("which batches them into transactions on its own thread.\n");
+    printf("\n");
+    printf("Slow storage can be simulated with the fsync-delay.so shim:\n");
+    printf("  LD_PRELOAD=./fsync-delay.so FSYNC_DELAY_US=500 %s -n 100000\n", program_name);
+}
+
+double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// the insert path before the sink thread, one connection per message
+int push_message_old(const message_t *msg)
+{
+    sqlite3 *db;
+    sqlite3_stmt *stmt;
+    int retval;
+
+    if (sqlite3_open(db_path, &db) != SQLITE_OK ||
+        sqlite3_prepare_v2(db, MSGDB_INSERT_SQL, -1, &stmt, 0) != SQLITE_OK)
+    {
+        printf("Cannot insert: %s\n", sqlite3_errmsg(db));
+        sqlite3_close(db);
+        return 1;
+    }
+
+    sqlite3_bind_int64(stmt, 1, (sqlite3_int64)msg->timestamp);
+    sqlite3_bind_text(stmt, 2, sink_protocol(msg->type), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 3, msg->src, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 4, msg->dst, -1, SQLITE_STATIC);
+    sqlite3_bind_blob(stmt, 5, msg->meta, sizeof(msg->meta), SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 6, (const char *)msg->data, msg->len, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 7, 0);
+
+    retval = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+
+    return retval != SQLITE_DONE;
+}
+
+int main(int argc, char *argv[])
+{
+    static struct option long_options[] =
+        {
+            {"messages", required_argument, 0, 'n'},
+            {"database", required_argument, 0, 'd'},
+            {"old", no_argument, 0, 'o'},
+            {"help", no_argument, 0, 'h'},
+            {0, 0, 0, 0}};
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "n:d:oh", long_options, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            num_msgs = atoi(optarg);
+            break;
+        case 'd':
+            snprintf(db_path, sizeof(db_path), "%s", optarg);
+            break;
+        case 'o':
+            old_path = true;
+            break;
+        case 'h':
+            print_help(argv[0]);
+            return 0;
+        default:
+            return 1;
+        }
+    }
+
+    if (num_msgs == 0)
+    {
+        print_help(argv[0]);
+        return 1;
+    }
+
+    char wal[160], shm[160];
+    snprintf(wal, sizeof(wal), "%s-wal", db_path);
+    snprintf(shm, sizeof(shm), "%s-shm", db_path);
+    remove(db_path);
+    remove(wal);
+    remove(shm);
+
+    message_t msg = {0};
+    msg.type = PKT_TYPE_SMS;
+    strcpy(msg.src, "N0CALL");
+    strcpy(msg.dst, "@ALL");
+    msg.data = (const uint8_t *)text;
+    msg.len = sizeof(text) - 1;
+
+    sqlite3 *db;
+    uint32_t failed = 0;
+    double t0;
+
+    if (old_path)
+    {
+        // the table as the tools created it before the shared schema
+        if (sqlite3_open(db_path, &db) != SQLITE_OK ||
+            sqlite3_exec(db, msgdb_migrations[0], 0, 0, 0) != SQLITE_OK)
+        {
+            printf("Cannot create %s: %s\n", db_path, sqlite3_errmsg(db));
+            return 1;
+        }
+        sqlite3_close(db);
+
+        t0 = now_s();
+        for (uint32_t i = 0; i < num_msgs; i++)
+        {
+            msg.timestamp = i;
+            failed += push_message_old(&msg);
+        }
+    }
+    else
+    {
+        if (sink_db_open(db_path) != 0)
+            return 1;
+        sink_start();
+
+        t0 = now_s();
+        for (uint32_t i = 0; i < num_msgs; i++)
+        {
+            // sink_publish() never waits, keep the ring from lapping the sink
+            while (sink_backlog() >= SINK_RING_LEN - SINK_BATCH_MAX)
+                usleep(50);
+
+            msg.timestamp = i;
+            sink_publish(&msg);
+        }
+
+        if (sink_drain(60000) != 0)
+            printf("Sink did not catch up\n");
+    }
+
+    double t = now_s() - t0;
+
+    if (!old_path)
+        sink_report(stdout, false);
+
+    // check that everything is there
+    int rows = -1;
+    sqlite3_stmt *stmt;
+    if (sqlite3_open(db_path, &db) == SQLITE_OK &&
+        sqlite3_prepare_v2(db, "SELECT COUNT(*) FROM messages;", -1, &stmt, 0) == SQLITE_OK)
+    {
+        if (sqlite3_step(stmt) == SQLITE_ROW)
+            rows = sqlite3_column_int(stmt, 0);
+        sqlite3_finalize(stmt);
+    }
+    sqlite3_close(db);
+
+    printf("%s path: %u messages in %.2f s, %.1f us/msg, %d rows, %u failed\n",
+           old_path ? "old" : "sink", num_msgs, t, t * 1e6 / num_msgs, rows, failed);
+
+    return rows == (int)num_msgs ? 0 : 1;
+}
@@ -0,0 +1,383 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <getopt.h>
+
+// libm17
+#include <m17.h>
+
+#define MAX_TEXT 821 // 33 frames of 25 bytes minus type, null and CRC
+
+char out_path[128];
+char truth_path[128];
+uint32_t num_packets = 100;
+uint16_t max_len = 100;
+char fixed_text[MAX_TEXT + 1];
+float noise = 0.0f;
+uint32_t gap = 960; // 200 ms
+uint8_t repeat = 1;
+uint8_t pkt_type = 0x05; // SMS
+char src_call[10] = "N0CALL";
+char dst_call[10] = "@ALL";
+uint64_t rng = 1;
+
+FILE *out, *truth;
+uint64_t written; // symbols
+
+void print_help(const char *program_name)
+{
+    printf("Synthetic M17 packet symbol generator\n\n");
+    printf("Writes SMS packets as float symbols, the format m17-packet-sqlite reads\n");
+    printf("from ZMQ or with --input. Between transmissions it writes random 4FSK\n");
+    printf("symbols (other traffic), so false syncword detections show up too.\n\n");
+    printf("Usage: %s -o FILE [OPTIONS]\n\n", program_name);
+    printf("Required options:\n");
+    printf("  -o, --output              Symbol file to write\n");
+    printf("Optional options:\n");
+    printf("  -x, --truth               Also write the syncword positions (for m17-packet-sqlite --truth)\n");
+    printf("  -n, --packets             Number of packets (default 100)\n");
+    printf("  -T, --type                Packet type (default 5 - text message; others get random binary data)\n");
+    printf("  -m, --message             Fixed message text (default: random text)\n");
+    printf("  -l, --length              Maximum random text length (default 100, up to %d)\n", MAX_TEXT);
+    printf("  -e, --noise               Gaussian noise standard deviation, symbols are +-1, +-3 (default 0)\n");
+    printf("  -g, --gap                 Symbols between transmissions (default 960)\n");
+    printf("  -R, --repeat              Transmissions of each packet, like a sender retrying (default 1)\n");
+    printf("  -S, --src                 Source callsign (default N0CALL)\n");
+    printf("  -D, --dst                 Destination callsign (default @ALL)\n");
+    printf("  -r, --seed                Random seed (default 1)\n");
+    printf("  -h, --help                Display this help message and exit\n");
+    printf("\n");
+    printf("Example:\n");
+    printf("  %s -o capture.sym -x capture.idx -n 1000 -e 0.5\n", program_name);
+}
+
+// xorshift64* - the same seed gives the same file everywhere
+uint32_t rnd(void)
+{
+    rng ^= rng >> 12;
+    rng ^= rng << 25;
+    rng ^= rng >> 27;
+    return (rng * 0x2545F4914F6CDD1DULL) >> 32;
+}
+
+float gauss(void)
+{
+    float u = (rnd() + 1.0f) / 4294967296.0f;
+    float v = rnd() / 4294967296.0f;
+    return sqrtf(-2.0f * logf(u)) * cosf(2.0f * (float)M_PI * v);
+}
+
+void put_symbols(const float *sym, uint16_t n)
+{
+    float buf[SYM_PER_PLD];
+
+    for (uint16_t i = 0; i < n; i++)
+        buf[i] = sym[i] + (noise > 0.0f ? noise * gauss() : 0.0f);
+
+    fwrite(buf, sizeof(float), n, out);
+    written += n;
+}
+
+void put_syncword(const int8_t sync[8], char type)
+{
+    float sym[8];
+
+    for (uint8_t i = 0; i < 8; i++)
+        sym[i] = sync[i];
+
+    if (truth != NULL)
+        fprintf(truth, "%llu %c\n", (unsigned long long)(written + 7), type);
+
+    put_symbols(sym, 8);
+}
+
+// convolutional code, puncturing, interleaving, randomizing and 4FSK
+// mapping of `nbits` bits (MSB first) into one 184-symbol payload
+void put_payload(const uint8_t *data, uint16_t nbits, const uint8_t *punct, uint8_t p_len)
+{
+    uint8_t ud[4 + 240 + 4] = {0}; // 4 zero bits of encoder state, data, flushing bits
+    uint8_t enc[2 * SYM_PER_PLD], rb[2 * SYM_PER_PLD];
+    uint16_t pb = 0;
+    uint8_t p = 0;
+
+    for (uint16_t i = 0; i < nbits; i++)
+        ud[4 + i] = (data[i / 8] >> (7 - (i % 8))) & 1;
+
+    for (uint16_t i = 0; i < nbits + 4; i++)
+    {
+        uint8_t g1 = ud[i + 4] ^ ud[i + 1] ^ ud[i + 0];
+        uint8_t g2 = ud[i + 4] ^ ud[i + 3] ^ ud[i + 2] ^ ud[i + 0];
+
+        if (punct[p] && pb < sizeof(enc))
+            enc[pb++] = g1;
+        p = (p + 1) % p_len;
+        if (punct[p] && pb < sizeof(enc))
+            enc[pb++] = g2;
+        p = (p + 1) % p_len;
+    }
+
+    for (uint16_t i = 0; i < sizeof(rb); i++)
+        rb[i] = enc[intrl_seq[i]] ^ ((rand_seq[i / 8] >> (7 - (i % 8))) & 1);
+
+    float sym[SYM_PER_PLD];
+    const float map[4] = {+1.0f, +3.0f, -1.0f, -3.0f}; // dibit -> symbol
+    for (uint16_t i = 0; i < SYM_PER_PLD; i++)
+        sym[i] = map[(rb[2 * i] << 1) | rb[2 * i + 1]];
+
+    put_symbols(sym, SYM_PER_PLD);
+}
+
+// random 4FSK symbols standing in for other traffic
+void put_gap(uint32_t n)
+{
+    float sym[SYM_PER_PLD];
+
+    while (n)
+    {
+        uint16_t k = n < SYM_PER_PLD ? n : SYM_PER_PLD;
+        for (uint16_t i = 0; i < k; i++)
+            sym[i] = (float)(2 * (rnd() % 4)) - 3.0f;
+        put_symbols(sym, k);
+        n -= k;
+    }
+}
+
+// `len` bytes of payload, a text message's includes its terminating null
+void put_packet(const uint8_t *payload, uint16_t len)
+{
+    lsf_t lsf;
+    memset(&lsf, 0, sizeof(lsf));
+    encode_callsign_bytes(lsf.dst, (const uint8_t *)dst_call);
+    encode_callsign_bytes(lsf.src, (const uint8_t *)src_call);
+    uint16_t crc = LSF_CRC(&lsf);
+    lsf.crc[0] = crc >> 8;
+    lsf.crc[1] = crc & 0xFF;
+
+    uint8_t lsf_b[30];
+    memcpy(&lsf_b[0], lsf.dst, 6);
+    memcpy(&lsf_b[6], lsf.src, 6);
+    memcpy(&lsf_b[12], lsf.type, 2);
+    memcpy(&lsf_b[14], lsf.meta, 14);
+    memcpy(&lsf_b[28], lsf.crc, 2);
+
+    put_syncword(lsf_sync_symbols, 'L');
+    put_payload(lsf_b, 240, puncture_pattern_1, sizeof(puncture_pattern_1));
+
+    // type byte, payload, CRC
+    uint8_t pkt[33 * 25];
+    pkt[0] = pkt_type;
+    memcpy(&pkt[1], payload, len);
+    crc = CRC_M17(pkt, len + 1);
+    pkt[len + 1] = crc >> 8;
+    pkt[len + 2] = crc & 0xFF;
+    len += 3;
+
+    for (uint8_t fn = 0; fn * 25 < len; fn++)
+    {
+        uint8_t frame[26] = {0};
+        uint16_t left = len - fn * 25;
+
+        if (left > 25)
+        {
+            memcpy(frame, &pkt[fn * 25], 25);
+            frame[25] = fn << 2;
+        }
+        else // last frame: EOF flag and the number of bytes used
+        {
+            memcpy(frame, &pkt[fn * 25], left);
+            frame[25] = 0x80 | (left << 2);
+        }
+
+        put_syncword(pkt_sync_symbols, 'P');
+        put_payload(frame, 206, puncture_pattern_3, sizeof(puncture_pattern_3));
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    // Define the long options
+    static struct option long_options[] =
+        {
+            {"output", required_argument, 0, 'o'},
+            {"truth", required_argument, 0, 'x'},
+            {"packets", required_argument, 0, 'n'},
+            {"type", required_argument, 0, 'T'},
+            {"message", required_argument, 0, 'm'},
+            {"length", required_argument, 0, 'l'},
+            {"noise", required_argument, 0, 'e'},
+            {"gap", required_argument, 0, 'g'},
+            {"repeat", required_argument, 0, 'R'},
+            {"src", required_argument, 0, 'S'},
+            {"dst", required_argument, 0, 'D'},
+            {"seed", required_argument, 0, 'r'},
+            {"help", no_argument, 0, 'h'},
+            {0, 0, 0, 0}};
+
+    // autogenerate the arg list
+    char arglist[64] = {0};
+    for (uint8_t i = 0; i < sizeof(long_options) / sizeof(struct option) - 1; i++)
+    {
+        arglist[strlen(arglist)] = long_options[i].val;
+        if (long_options[i].has_arg != no_argument)
+            arglist[strlen(arglist)] = ':';
+    }
+
+    int opt;
+    int option_index = 0;
+
+    // Parse command line arguments
+    while ((opt = getopt_long(argc, argv, arglist, long_options, &option_index)) != -1)
+    {
+        switch (opt)
+        {
+        case 'o':
+            if (strlen(optarg) < sizeof(out_path))
+                strcpy(out_path, optarg);
+            break;
+
+        case 'x':
+            if (strlen(optarg) < sizeof(truth_path))
+                strcpy(truth_path, optarg);
+            break;
+
+        case 'n':
+            num_packets = strtoul(optarg, NULL, 10);
+            break;
+
+        case 'T':
+            if (atoi(optarg) >= 0 && atoi(optarg) <= 0x7F)
+                pkt_type = atoi(optarg);
+            else
+                printf("Invalid packet type - using default (%u)\n", pkt_type);
+            break;
+
+        case 'm':
+            if (strlen(optarg) > 0 && strlen(optarg) <= MAX_TEXT)
+                strcpy(fixed_text, optarg);
+            else
+                printf("Invalid message text (1 to %d characters) - using random text\n", MAX_TEXT);
+            break;
+
+        case 'l':
+            if (atoi(optarg) > 0 && atoi(optarg) <= MAX_TEXT)
+                max_len = atoi(optarg);
+            else
+                printf("Invalid text length - using default (%u)\n", max_len);
+            break;
+
+        case 'e':
+            if (strtof(optarg, NULL) >= 0.0f)
+                noise = strtof(optarg, NULL);
+            else
+                printf("Invalid noise level - using default (%.1f)\n", noise);
+            break;
+
+        case 'g':
+            gap = strtoul(optarg, NULL, 10);
+            break;
+
+        case 'R':
+            if (atoi(optarg) > 0 && atoi(optarg) <= 255)
+                repeat = atoi(optarg);
+            else
+                printf("Invalid number of transmissions - using default (%u)\n", repeat);
+            break;
+
+        case 'S':
+            if (strlen(optarg) > 0 && strlen(optarg) < sizeof(src_call))
+                strcpy(src_call, optarg);
+            else
+                printf("Invalid source callsign - using default (%s)\n", src_call);
+            break;
+
+        case 'D':
+            if (strlen(optarg) > 0 && strlen(optarg) < sizeof(dst_call))
+                strcpy(dst_call, optarg);
+            else
+                printf("Invalid destination callsign - using default (%s)\n", dst_call);
+            break;
+
+        case 'r':
+            rng = strtoull(optarg, NULL, 10) | 1; // xorshift state must not be 0
+            break;
+
+        case 'h':
+            print_help(argv[0]);
+            return 0;
+            break;
+        }
+    }
+
+    if (!out_path[0])
+    {
+        print_help(argv[0]);
+        return 1;
+    }
+
+    out = fopen(out_path, "wb");
+    if (out == NULL)
+    {
+        printf("Cannot open output file %s\n", out_path);
+        return 1;
+    }
+
+    if (truth_path[0])
+    {
+        truth = fopen(truth_path, "w");
+        if (truth == NULL)
+        {
+            printf("Cannot open syncword positions file %s\n", truth_path);
+            fclose(out);
+            return 1;
+        }
+    }
+
+    uint32_t frames = 0;
+    uint8_t payload[MAX_TEXT + 1];
+    uint16_t len;
+
+    put_gap(gap);
+
+    for (uint32_t n = 0; n < num_packets; n++)
+    {
+        if (pkt_type != 0x05)
+        {
+            len = 1 + rnd() % (max_len + 1);
+            for (uint16_t i = 0; i < len; i++)
+                payload[i] = rnd();
+        }
+        else if (fixed_text[0])
+        {
+            len = strlen(fixed_text) + 1;
+            memcpy(payload, fixed_text, len);
+        }
+        else
+        {
+            // printable ASCII, words of lowercase letters
+            len = 1 + rnd() % max_len;
+            for (uint16_t i = 0; i < len; i++)
+                payload[i] = (rnd() % 6 == 0) ? ' ' : 'a' + rnd() % 26;
+            payload[len++] = 0;
+        }
+
+        for (uint8_t r = 0; r < repeat; r++)
+        {
+            put_packet(payload, len);
+            frames += 1 + (len + 3 + 24) / 25;
+
+            put_gap(gap);
+        }
+    }
+
+    fclose(out);
+    if (truth != NULL)
+        fclose(truth);
+
+    printf("%u packets, %u frames, %llu symbols (%.1f s)\n", num_packets, frames,
+           (unsigned long long)written, written / 4800.0);
+
+    return 0;
+}
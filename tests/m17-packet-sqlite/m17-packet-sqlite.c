@@ -4,48 +4,91 @@
 #include <stdbool.h>
 #include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <time.h>
 #include <getopt.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <zmq.h>
-#include <sqlite3.h>
 #include <liblinht-ctrl.h>
+#include <ledsched.h>
 
 // libm17
 #include <m17.h>
 
-float symb_buff[2048];                  // raw samples from ZMQ
-float last[8];                          // look-back buffer for finding syncwords
-float dist;                             // Euclidean distance for finding syncwords in the symbol stream
-float pld[SYM_PER_PLD];                 // raw frame symbols
-uint16_t soft_bit[2 * SYM_PER_PLD];     // raw frame soft bits
-uint16_t d_soft_bit[2 * SYM_PER_PLD];   // deinterleaved soft bits
+#include "syncw.h"
+#include "m17dec.h"
+#include "reasm.h"
+#include "crc16.h"
+#include "sink.h"
 
-lsf_t lsf;                              // complete LSF
-uint8_t frame_data[26];                 // decoded frame data, 206 bits
-uint8_t packet_data[33 * 25];           // whole packet data
-
-uint8_t syncd = 0;                      // syncword found?
-uint8_t fl = 0;                         // Frame=0 of LSF=1
-int8_t last_fn;                         // last received frame number (-1 when idle)
-uint8_t pushed;                         // counter for pushed symbols
+#define MAX_CHANNELS 16
+#define MAX_WORKERS 8
+#define JSON_KEEP 5         // rotated JSON lines files
+#define REPORT_S 60         // sink counters printed this often, when they changed
 
 float det_thresh = 5.0f;
-char symb_path[128] = "/tmp/m17_symbols_rx";
 char db_path[128] = "/var/lib/linht/messages.db";
+char input_path[128];                    // --input: replay a capture instead of ZMQ
+char truth_path[128];                    // --truth: syncword positions of the capture
+bool replay;
+char pub_endpoint[128];                  // --pub: ZMQ PUB sink
+char json_path[128];                     // --json: JSON lines sink
+uint32_t json_max = 10;                  // --rotate, MB
+char unix_path[108];                     // --unix: gateway socket sink
+
+// decoder statistics, reported after a --input replay
+typedef struct
+{
+    uint64_t symbols;                   // symbols before the current block
+    uint32_t sync_lsf, sync_pkt;        // syncwords acted upon
+    uint32_t sync_true, sync_false;     // the same, checked against --truth
+    uint32_t lsf_ok, lsf_bad;           // LSF CRC
+    uint32_t pkt_ok, pkt_bad;           // CRC of reassembled packets
+    uint32_t pkt_dup;                   // repeats of a delivered packet, dropped
+    uint32_t msgs, bins;                // text messages, other packet types
+    uint64_t scan_ns, decode_ns, packet_ns; // per-stage time, replay only
+} chan_stats_t;
+
+// decoder state of one symbol stream
+typedef struct channel
+{
+    char symb_path[128];                // IPC socket path
+    void *sub;                          // ZMQ SUB socket, only touched by the owning worker
+
+    float symb_buff[SYNCW_MAX_BLOCK];   // raw samples from ZMQ
+    syncw_t syncw;                      // syncword correlator
+    syncw_cand_t cand[SYNCW_MAX_BLOCK]; // syncword candidates in the current block
+    int32_t resume;                     // first symbol of the current block usable for syncword detection (<= 0: history from the previous block)
+    float pld[SYM_PER_PLD];             // raw frame symbols
+
+    lsf_t lsf;                          // complete LSF
+    uint8_t frame_data[26];             // decoded frame data, 206 bits
+    reasm_t reasm;                      // frames of the packet being received
+
+    uint8_t syncd;                      // syncword found?
+    uint8_t fl;                         // Frame=0 of LSF=1
+    uint8_t pushed;                     // counter for pushed symbols
 
-uint16_t last_id;
-typedef struct message
+    chan_stats_t stats;
+} channel_t;
+
+channel_t channels[MAX_CHANNELS];
+uint8_t num_channels;
+uint8_t num_workers;
+
+// LEDs - a worker that posts a pattern switches the LED on itself, the main
+// thread's ledsched_dispatch() times the rest of the pattern
+enum
 {
-    uint16_t id;
-    uint32_t timestamp;
-    char protocol[32];
-    char src[64];
-    char dst[64];
-    uint8_t meta[14];
-    char message[1024];
-    bool read;
-} message_t;
-message_t msg;
+    LED_GREEN,
+    LED_COUNT
+};
+
+ledsched_t leds;
+const ledsched_pattern_t msg_blink = {{100}, 1, 1}; // 100 ms on
 
 void print_help(const char *program_name)
 {
@@ -53,167 +96,373 @@ void print_help(const char *program_name)
     printf("Usage: %s [OPTIONS]\n\n", program_name);
     printf("Optional options:\n");
     printf("  -d, --dbase               Set the messages database file path\n");
-    printf("  -s, --ipc_symb            Set the IPC socket path for incoming M17 symbol stream\n");
+    printf("  -s, --ipc_symb            Add an IPC socket path for an incoming M17 symbol stream (up to %d, default /tmp/m17_symbols_rx)\n", MAX_CHANNELS);
     printf("  -t, --threshold           Set syncword detection threshold (non-negative, default=5.0)\n");
+    printf("  -w, --workers             Set the number of decoder threads (default: one per stream, up to %d)\n", MAX_WORKERS);
+    printf("  -i, --input               Decode a file of float symbols instead, print statistics and exit (no database writes)\n");
+    printf("  -x, --truth               Syncword positions of the --input file, from m17-packet-gen\n");
+    printf("  -p, --pub                 Also publish the messages as JSON on a ZMQ PUB socket (e.g. ipc:///tmp/m17_msgs)\n");
+    printf("  -j, --json                Also append the messages to a JSON lines file\n");
+    printf("  -r, --rotate              Rotate the JSON lines file at this size in MB, keeping %d old ones (default=%u)\n", JSON_KEEP, json_max);
+    printf("  -u, --unix                Also send text and APRS messages as TNC2 lines to clients of this Unix socket\n");
     printf("  -h, --help                Display this help message and exit\n");
     printf("\n");
     printf("Example:\n");
     printf("  %s -t 2.0 -d /var/lib/linht/messages.db\n", program_name);
+    printf("  %s -s /tmp/m17_symbols_rx -s /tmp/m17_symbols_rx2 -w 1\n", program_name);
+    printf("  %s -i capture.sym -x capture.idx -t 3.0\n", program_name);
+    printf("  %s -p ipc:///tmp/m17_msgs -j /var/log/m17.jsonl -u /tmp/m17_aprs\n", program_name);
+}
+
+void led_out(uint8_t led, bool on)
+{
+    if (led == LED_GREEN)
+        linht_ctrl_green_led_set(on);
 }
 
-int db_init(char *db_path)
+uint64_t now_ns(void)
 {
-    sqlite3 *db;
-    char *err_msg = 0;
-    int retval;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// --truth: syncword end positions written by m17-packet-gen, ascending
+uint64_t *truth;
+uint32_t truth_len, truth_next, truth_missed;
 
-    retval = sqlite3_open(db_path, &db);
-    if (retval != SQLITE_OK)
+// classify a syncword the decoder acted upon against --truth
+void check_sync(channel_t *ch, uint64_t end)
+{
+    while (truth_next < truth_len && truth[truth_next] < end)
     {
-        printf("Cannot open database: %s\nExiting.\n", sqlite3_errmsg(db));
-        return 1;
+        truth_next++;
+        truth_missed++;
     }
 
-    const char *create_sql =
-        "CREATE TABLE IF NOT EXISTS messages ("
-        "id INTEGER PRIMARY KEY,"
-        "timestamp INTEGER,"
-        "protocol TEXT,"
-        "source TEXT,"
-        "destination TEXT,"
-        "meta BLOB,"
-        "message TEXT,"
-        "read INTEGER"
-        ");";
-
-    retval = sqlite3_exec(db, create_sql, 0, 0, &err_msg);
-
-    if (retval != SQLITE_OK)
+    if (truth_next < truth_len && truth[truth_next] == end)
     {
-        printf("Failed to ensure table exists: %s\n", err_msg);
-        sqlite3_free(err_msg);
-        sqlite3_close(db);
-        return 1;
+        truth_next++;
+        ch->stats.sync_true++;
+    }
+    else
+    {
+        ch->stats.sync_false++;
     }
-
-    sqlite3_close(db);
-    return 0;
 }
 
-int push_message(char *db_path, message_t msg)
+// decode a complete frame (LSF or packet) from `ch->pld`
+void decode_frame(channel_t *ch)
 {
-    sqlite3 *db;
-    sqlite3_stmt *stmt;
-    int retval;
+    uint64_t t = replay ? now_ns() : 0;
 
-    retval = sqlite3_open(db_path, &db);
-    if (retval != SQLITE_OK)
+    // if it is a frame
+    if (!ch->fl)
     {
-        printf("Cannot open database: %s\nExiting.\n", sqlite3_errmsg(db));
-        return 1;
-    }
+        // decode packet frame
+        uint8_t rx_fn, rx_last; // also in frame_data[25]
+        m17dec_pkt(ch->frame_data, &rx_last, &rx_fn, ch->pld);
+
+        if (replay)
+        {
+            uint64_t t2 = now_ns();
+            ch->stats.decode_ns += t2 - t;
+            t = t2;
+        }
+
+        // store the frame, CRC-checked packet when complete
+        const uint8_t *pkt;
+        int p_len = reasm_frame(&ch->reasm, ch->frame_data, ch->stats.symbols, &pkt);
+
+        if (p_len == REASM_BAD)
+        {
+            ch->stats.pkt_bad++;
+        }
+        else if (p_len == REASM_DUP)
+        {
+            ch->stats.pkt_dup++;
+        }
+        else if (p_len > 0 && pkt[0] == PKT_TYPE_SMS && pkt[p_len - 3] != 0)
+        {
+            ch->stats.pkt_bad++; // text without its terminating null - a CRC false positive
+        }
+        else if (p_len > 0)
+        {
+            ch->stats.pkt_ok++;
+
+            // type byte, payload, CRC - the payload stays where it is
+            message_t msg = {0};
+            msg.type = pkt[0];
+            msg.data = &pkt[1];
+            msg.len = p_len - 3;
+            msg.timestamp = time(NULL);
+
+            //LSF fields of the packet's transmission
+            if (ch->reasm.lsf_ok)
+            {
+                decode_callsign_bytes((uint8_t*)msg.dst, ch->reasm.lsf.dst);
+                decode_callsign_bytes((uint8_t*)msg.src, ch->reasm.lsf.src);
+                memcpy(msg.meta, ch->reasm.lsf.meta, sizeof(msg.meta));
+            }
+
+            // dump data
+            if (msg.type == PKT_TYPE_SMS) // a text message, without its terminating null
+            {
+                msg.len = strnlen((const char *)msg.data, msg.len);
+                printf("Message from %s: %.*s\n", msg.src, msg.len, (const char *)msg.data);
+                ch->stats.msgs++;
+            }
+            else
+            {
+                printf("Packet from %s: %s, %u bytes\n", msg.src, sink_protocol(msg.type), msg.len);
+                ch->stats.bins++;
+            }
 
-    // prepare SQL with placeholders
-    const char *sql = "INSERT INTO messages (timestamp, protocol, source, destination, meta, message, read) "
-                      "VALUES (?, ?, ?, ?, ?, ?, ?);";
+            // to the database and the other sinks, copied - never waits for them
+            sink_publish(&msg);
+            if (!replay)
+                ledsched_play(&leds, LED_GREEN, &msg_blink, 0);
+        }
 
-    retval = sqlite3_prepare_v2(db, sql, -1, &stmt, 0);
-    if (retval != SQLITE_OK)
+        if (replay)
+            ch->stats.packet_ns += now_ns() - t;
+    }
+    else // if it is LSF
     {
-        printf("Failed to prepare statement: %s\n", sqlite3_errmsg(db));
-        sqlite3_close(db);
-        return 1;
+        // decode LSF
+        m17dec_lsf(&ch->lsf, ch->pld);
+
+        if (replay)
+        {
+            uint64_t t2 = now_ns();
+            ch->stats.decode_ns += t2 - t;
+            t = t2;
+        }
+
+        uint16_t crc = ((uint16_t)ch->lsf.crc[0] << 8) | ch->lsf.crc[1];
+        bool crc_ok = LSF_CRC(&ch->lsf) == crc;
+
+        if (crc_ok)
+            ch->stats.lsf_ok++;
+        else
+            ch->stats.lsf_bad++;
+
+        // a repeat of the LSF keeps the partial packet, anything else starts a new one
+        reasm_lsf(&ch->reasm, &ch->lsf, crc_ok, ch->stats.symbols);
+
+        if (replay)
+            ch->stats.packet_ns += now_ns() - t;
     }
+}
+
+// run one block of `n` symbols (at most SYNCW_MAX_BLOCK) through the channel's decoder
+void channel_rx(channel_t *ch, const float *sym, int n)
+{
+    uint64_t t = replay ? now_ns() : 0;
+    int nc = syncw_scan(&ch->syncw, sym, n, det_thresh, ch->cand);
+    if (replay)
+        ch->stats.scan_ns += now_ns() - t;
+
+    int c = 0; // next candidate
+    int i = 0;
 
-    // bind values
-    sqlite3_bind_int64(stmt, 1, (sqlite3_int64)msg.timestamp);              // timestamp (seconds since epoch)
-    sqlite3_bind_text(stmt, 2, msg.protocol, -1, SQLITE_STATIC);            // protocol
-    sqlite3_bind_text(stmt, 3, msg.src, -1, SQLITE_STATIC);                 // source
-    sqlite3_bind_text(stmt, 4, msg.dst, -1, SQLITE_STATIC);                 // destination
-    sqlite3_bind_blob(stmt, 5, msg.meta, sizeof(msg.meta), SQLITE_STATIC);  // meta
-    sqlite3_bind_text(stmt, 6, msg.message, -1, SQLITE_STATIC);             // message
-    sqlite3_bind_int(stmt, 7, 0);                                           // read flag (0 = unread)
-
-    // execute
-    retval = sqlite3_step(stmt);
-    if (retval != SQLITE_DONE)
+    while (i < n)
     {
-        printf("Insert failed: %s\n", sqlite3_errmsg(db));
-        sqlite3_finalize(stmt);
-        sqlite3_close(db);
-        return 1;
+        if (!ch->syncd)
+        {
+            // the whole syncword has to lie after the point where the
+            // search (re)started, candidates overlapping a payload are skipped
+            while (c < nc && (ch->cand[c].end < i || ch->cand[c].end - (SYNCW_LEN - 1) < ch->resume))
+                c++;
+
+            if (c == nc)
+                break; // nothing in the rest of this block
+
+            i = ch->cand[c].end + 1;
+            ch->fl = ch->cand[c].type == SYNCW_LSF;
+            ch->syncd = 1;
+            ch->pushed = 0;
+
+            if (ch->fl)
+                ch->stats.sync_lsf++;
+            else
+                ch->stats.sync_pkt++;
+            if (truth)
+                check_sync(ch, ch->stats.symbols + ch->cand[c].end);
+            c++;
+        }
+        else
+        {
+            // payload symbols, as many as this block has
+            int k = n - i < SYM_PER_PLD - ch->pushed ? n - i : SYM_PER_PLD - ch->pushed;
+            memcpy(&ch->pld[ch->pushed], &sym[i], k * sizeof(float));
+            ch->pushed += k;
+            i += k;
+
+            if (ch->pushed == SYM_PER_PLD) // frame acquired
+            {
+                decode_frame(ch);
+
+                // job done
+                ch->syncd = 0;
+                ch->pushed = 0;
+                ch->resume = i;
+            }
+        }
     }
-    else
+
+    // carry the syncword search state over to the next block
+    ch->resume -= n;
+    if (ch->resume < -(SYNCW_LEN - 1))
+        ch->resume = -(SYNCW_LEN - 1);
+
+    ch->stats.symbols += n;
+}
+
+// each worker owns a fixed subset of the channels and their sockets
+void *worker(void *arg)
+{
+    uint8_t id = (uintptr_t)arg;
+    zmq_pollitem_t items[MAX_CHANNELS];
+    channel_t *owned[MAX_CHANNELS];
+    uint8_t n = 0;
+
+    for (uint8_t i = id; i < num_channels; i += num_workers)
     {
-        // printf("New message inserted.\n");
+        owned[n] = &channels[i];
+        items[n] = (zmq_pollitem_t){channels[i].sub, 0, ZMQ_POLLIN, 0};
+        n++;
     }
 
-    sqlite3_finalize(stmt);
-    sqlite3_close(db);
+    while (1)
+    {
+        if (zmq_poll(items, n, -1) < 0)
+            continue;
 
-    return 0;
+        for (uint8_t i = 0; i < n; i++)
+        {
+            if (!(items[i].revents & ZMQ_POLLIN))
+                continue;
+
+            channel_t *ch = owned[i];
+            int size = zmq_recv(ch->sub, (uint8_t*)ch->symb_buff, sizeof(ch->symb_buff), ZMQ_DONTWAIT);
+
+            int ns = size > 0 ? size / (int)sizeof(float) : 0;
+            if (ns > SYNCW_MAX_BLOCK)
+                ns = SYNCW_MAX_BLOCK; // truncated by zmq_recv
+
+            if (ns > 0)
+                channel_rx(ch, ch->symb_buff, ns);
+        }
+    }
+
+    return NULL;
 }
 
-int get_message_count(char *db_path)
+// load the "<end> <L|P>" lines written by m17-packet-gen -x
+int load_truth(const char *path)
 {
-	sqlite3 *db;
-    sqlite3_stmt *stmt;
-    int retval, count = 0;
-
-    retval = sqlite3_open(db_path, &db);
-    if (retval != SQLITE_OK)
-	{
-        printf("Cannot open database: %s\nExiting.\n", sqlite3_errmsg(db));
-        return -1;
+    FILE *f = fopen(path, "r");
+    if (f == NULL)
+    {
+        printf("Cannot open syncword positions file %s\n", path);
+        return 1;
     }
 
-    retval = sqlite3_prepare_v2(db, "SELECT COUNT(*) FROM messages;", -1, &stmt, 0);
-    if (retval == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW)
-	{
-        count = sqlite3_column_int(stmt, 0);
-    }
-	else
-	{
-        printf("Query failed: %s\n", sqlite3_errmsg(db));
-		sqlite3_finalize(stmt);
-		sqlite3_close(db);
-		return -1;
+    unsigned long long end;
+    char type;
+    uint32_t cap = 0;
+
+    while (fscanf(f, "%llu %c", &end, &type) == 2)
+    {
+        if (truth_len == cap)
+        {
+            cap = cap ? 2 * cap : 1024;
+            uint64_t *t = realloc(truth, cap * sizeof(*truth));
+            if (t == NULL)
+            {
+                fclose(f);
+                return 1;
+            }
+            truth = t;
+        }
+        truth[truth_len++] = end;
     }
 
-    sqlite3_finalize(stmt);
-    sqlite3_close(db);
-    return count;
+    fclose(f);
+    return 0;
 }
 
-int get_unread_message_count(char *db_path)
+// --input: decode a capture as fast as possible, print statistics to stderr
+int replay_file(const char *path, const char *truth_file)
 {
-	sqlite3 *db;
-    sqlite3_stmt *stmt;
-    int retval, count = 0;
-
-    retval = sqlite3_open(db_path, &db);
-    if (retval != SQLITE_OK)
-	{
-        printf("Cannot open database: %s\nExiting.\n", sqlite3_errmsg(db));
-        return -1;
-    }
+    if (truth_file[0] && load_truth(truth_file) != 0)
+        return 1;
 
-    retval = sqlite3_prepare_v2(db, "SELECT COUNT(*) FROM messages WHERE read = 0;", -1, &stmt, 0);
-    if (retval == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW)
-	{
-        count = sqlite3_column_int(stmt, 0);
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0)
+    {
+        printf("Cannot open input file %s\n", path);
+        return 1;
     }
-	else
-	{
-        printf("Query failed: %s\n", sqlite3_errmsg(db));
-		sqlite3_finalize(stmt);
-		sqlite3_close(db);
-		return -1;
+
+    size_t n = st.st_size / sizeof(float);
+    if (n == 0)
+    {
+        printf("Input file %s holds no symbols\n", path);
+        close(fd);
+        return 1;
     }
 
-    sqlite3_finalize(stmt);
-    sqlite3_close(db);
-    return count;
+    const float *sym = mmap(NULL, n * sizeof(float), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (sym == MAP_FAILED)
+    {
+        printf("Cannot map input file %s\n", path);
+        return 1;
+    }
+    madvise((void *)sym, n * sizeof(float), MADV_SEQUENTIAL);
+
+    channel_t *ch = &channels[0];
+    num_channels = 1;
+    syncw_init(&ch->syncw);
+    reasm_init(&ch->reasm);
+
+    // same block size as the flowgraph's ZMQ messages at most, straight from the mapping
+    uint64_t t0 = now_ns();
+    for (size_t off = 0; off < n; off += SYNCW_MAX_BLOCK)
+        channel_rx(ch, &sym[off], n - off < SYNCW_MAX_BLOCK ? n - off : SYNCW_MAX_BLOCK);
+    double secs = (now_ns() - t0) * 1e-9;
+
+    munmap((void *)sym, n * sizeof(float));
+
+    // the sinks write in the background, the file is complete once they caught up
+    if (sink_drain(5000) != 0)
+        fprintf(stderr, "Sinks did not catch up within 5 s\n");
+
+    if (truth_len)
+        truth_missed += truth_len - truth_next;
+
+    chan_stats_t *s = &ch->stats;
+    double air = n / 4800.0; // 4800 symbols per second on air
+    uint32_t syncs = s->sync_lsf + s->sync_pkt;
+
+    fprintf(stderr, "Symbols:     %zu (%.1f s on air) in %.3f s - %.0fx real time\n", n, air, secs, air / secs);
+    fprintf(stderr, "Syncwords:   %u LSF, %u packet (threshold %.1f)\n", s->sync_lsf, s->sync_pkt, det_thresh);
+    if (truth_len)
+        fprintf(stderr, "  vs truth:  %u true, %u false (%.2f per 1M symbols), %u missed of %u\n",
+                s->sync_true, s->sync_false, s->sync_false * 1e6 / n, truth_missed, truth_len);
+    fprintf(stderr, "LSF CRC:     %u ok, %u failed\n", s->lsf_ok, s->lsf_bad);
+    fprintf(stderr, "Packet CRC:  %u ok, %u failed, %u repeats dropped\n", s->pkt_ok, s->pkt_bad, s->pkt_dup);
+    fprintf(stderr, "Messages:    %u text, %u other (%.0f/s)\n", s->msgs, s->bins, (s->msgs + s->bins) / secs);
+    fprintf(stderr, "Time:        scan %.1f ms, frame decode %.1f ms (%.2f us/frame), packet %.1f ms, other %.1f ms\n",
+            s->scan_ns * 1e-6, s->decode_ns * 1e-6, syncs ? s->decode_ns * 1e-3 / syncs : 0.0, s->packet_ns * 1e-6,
+            secs * 1e3 - (s->scan_ns + s->decode_ns + s->packet_ns) * 1e-6);
+    sink_report(stderr, false);
+
+    free(truth);
+    return 0;
 }
 
 int main(int argc, char *argv[])
@@ -224,6 +473,13 @@ int main(int argc, char *argv[])
             {"dbase", required_argument, 0, 'd'},
             {"ipc_symb", required_argument, 0, 's'},
             {"threshold", required_argument, 0, 't'},
+            {"workers", required_argument, 0, 'w'},
+            {"input", required_argument, 0, 'i'},
+            {"truth", required_argument, 0, 'x'},
+            {"pub", required_argument, 0, 'p'},
+            {"json", required_argument, 0, 'j'},
+            {"rotate", required_argument, 0, 'r'},
+            {"unix", required_argument, 0, 'u'},
             {"help", no_argument, 0, 'h'},
             {0, 0, 0, 0}};
 
@@ -257,14 +513,14 @@ int main(int argc, char *argv[])
             break;
 
         case 's':
-            if (strlen(optarg) > 0)
+            if (strlen(optarg) > 0 && strlen(optarg) < sizeof(channels[0].symb_path) && num_channels < MAX_CHANNELS)
             {
-                printf("Setting IPC symbol source path to %s\n", optarg);
-                strcpy(symb_path, optarg);
+                printf("Adding IPC symbol source path %s\n", optarg);
+                strcpy(channels[num_channels++].symb_path, optarg);
             }
             else
             {
-                printf("No IPC symbol source path given - using default (%s)\n", symb_path);
+                printf("Invalid IPC symbol source path or too many streams - ignoring\n");
             }
             break;
 
@@ -288,6 +544,65 @@ int main(int argc, char *argv[])
             }
             break;
 
+        case 'w':
+            if (atoi(optarg) > 0 && atoi(optarg) <= MAX_WORKERS)
+            {
+                num_workers = atoi(optarg);
+                printf("Setting number of decoder threads to %u\n", num_workers);
+            }
+            else
+            {
+                printf("Invalid number of decoder threads - using default\n");
+            }
+            break;
+
+        case 'i':
+            if (strlen(optarg) > 0 && strlen(optarg) < sizeof(input_path))
+            {
+                strcpy(input_path, optarg);
+                replay = true;
+            }
+            else
+            {
+                printf("Invalid input file path - ignoring\n");
+            }
+            break;
+
+        case 'x':
+            if (strlen(optarg) > 0 && strlen(optarg) < sizeof(truth_path))
+                strcpy(truth_path, optarg);
+            else
+                printf("Invalid syncword positions file path - ignoring\n");
+            break;
+
+        case 'p':
+            if (strlen(optarg) > 0 && strlen(optarg) < sizeof(pub_endpoint))
+                strcpy(pub_endpoint, optarg);
+            else
+                printf("Invalid message publisher endpoint - ignoring\n");
+            break;
+
+        case 'j':
+            if (strlen(optarg) > 0 && strlen(optarg) < sizeof(json_path))
+                strcpy(json_path, optarg);
+            else
+                printf("Invalid JSON lines file path - ignoring\n");
+            break;
+
+        case 'r':
+            if (atoi(optarg) > 0 && atoi(optarg) <= 4000)
+                json_max = atoi(optarg);
+            else
+                printf("Invalid JSON lines file size - using default (%u MB)\n", json_max);
+            break;
+
+        case 'u':
+            if (strlen(optarg) > 0 && strlen(optarg) < sizeof(unix_path))
+                strcpy(unix_path, optarg);
+            else
+                printf("Invalid Unix socket path - ignoring\n");
+            break;
+
         case 'h':
             print_help(argv[0]);
             return 0;
@@ -296,149 +611,84 @@ int main(int argc, char *argv[])
     }
 
     // init
-    linht_ctrl_green_led_set(false);
+    m17dec_init();
+    crc16_init();
+
+    // sinks - a replay only writes to the ones asked for, never to the database
+    if (!replay && sink_db_open(db_path) != 0) // also makes sure an appropriate table in the DB exists
+        return 1;
+    if (pub_endpoint[0] && sink_zmq_open(pub_endpoint) != 0)
+        return 1;
+    if (json_path[0] && sink_json_open(json_path, json_max * 1000000, JSON_KEEP) != 0)
+        return 1;
+    if (unix_path[0] && sink_unix_open(unix_path) != 0)
+        return 1;
 
-    db_init(db_path); // make sure an appropriate table in the DB exists
+    sink_start();
 
-    void *zmq_ctx = zmq_ctx_new();
-    void *zmq_sub = zmq_socket(zmq_ctx, ZMQ_SUB);
+    if (replay)
+        return replay_file(input_path, truth_path);
 
-    char zmq_ipc[8+128];
-    sprintf(zmq_ipc, "ipc://%s", symb_path);
-    if(zmq_connect(zmq_sub, zmq_ipc) != 0)
+    if (ledsched_init(&leds, LED_COUNT, led_out) != 0)
     {
-        printf("ZeroMQ: Error connecting to IPC socket %s.\nExiting.\n", symb_path);
+        printf("LED scheduler init failed.\nExiting.\n");
         return 1;
     }
 
-    zmq_setsockopt(zmq_sub, ZMQ_SUBSCRIBE, "", 0); // subscribe to everything
-    
-    // main loop
-    while (1)
+    if (num_channels == 0)
+        strcpy(channels[num_channels++].symb_path, "/tmp/m17_symbols_rx");
+
+    if (num_workers == 0 || num_workers > num_channels)
+        num_workers = num_channels < MAX_WORKERS ? num_channels : MAX_WORKERS;
+
+    void *zmq_ctx = zmq_ctx_new();
+
+    for (uint8_t i = 0; i < num_channels; i++)
     {
-        int16_t size = zmq_recv(zmq_sub, (uint8_t*)symb_buff, sizeof(symb_buff), 0);
-        
-        if (size == -1)
-            continue;
-        
-        for (uint16_t i=0; i<size/sizeof(float); i++)
+        channel_t *ch = &channels[i];
+        char zmq_ipc[8+128];
+
+        ch->sub = zmq_socket(zmq_ctx, ZMQ_SUB);
+        sprintf(zmq_ipc, "ipc://%s", ch->symb_path);
+        if(zmq_connect(ch->sub, zmq_ipc) != 0)
         {
-            float sample = symb_buff[i];
+            printf("ZeroMQ: Error connecting to IPC socket %s.\nExiting.\n", ch->symb_path);
+            return 1;
+        }
 
-            if (!syncd)
-            {
-                // push new symbol
-                for (uint8_t i = 0; i < 7; i++)
-                {
-                    last[i] = last[i + 1];
-                }
+        zmq_setsockopt(ch->sub, ZMQ_SUBSCRIBE, "", 0); // subscribe to everything
 
-                last[7] = sample;
+        syncw_init(&ch->syncw);
+        reasm_init(&ch->reasm);
+    }
 
-                // calculate euclidean norm
-                dist = eucl_norm(last, pkt_sync_symbols, 8);
+    printf("Decoding %u stream(s) on %u thread(s)\n", num_channels, num_workers);
 
-                if (dist < det_thresh) // frame syncword detected
-                {
-                    syncd = 1;
-                    pushed = 0;
-                    fl = 0;
-                }
-                else
-                {
-                    // calculate euclidean norm again, this time against LSF syncword
-                    dist = eucl_norm(last, lsf_sync_symbols, 8);
-
-                    if (dist < det_thresh) // LSF syncword
-                    {
-                        syncd = 1;
-                        pushed = 0;
-                        last_fn = -1;
-                        memset(packet_data, 0, 33 * 25);
-                        fl = 1;
-                    }
-                }
-            }
-            else
-            {
-                pld[pushed++] = sample;
+    pthread_t tid[MAX_WORKERS];
+    for (uint8_t i = 0; i < num_workers; i++)
+        pthread_create(&tid[i], NULL, worker, (void *)(uintptr_t)i);
 
-                if (pushed == SYM_PER_PLD) // frame acquired
-                {
-                    // if it is a frame
-                    if (!fl)
-                    {
-                        // decode packet frame
-                        uint8_t rx_fn, rx_last;
-                        decode_pkt_frame(frame_data, &rx_last, &rx_fn, pld);
-
-                        // copy data - might require some fixing
-                        if (rx_fn <= 31 && rx_fn == last_fn + 1 && !rx_last)
-                        {
-                            memcpy(&packet_data[rx_fn * 25], frame_data, 25);
-                            last_fn++;
-                        }
-                        else if (rx_last)
-                        {
-                            memcpy(&packet_data[(last_fn + 1) * 25], frame_data, rx_fn < 25 ? rx_fn : 25); // prevent copying too much data (beyond frame_data end)
-                            uint16_t p_len = strlen((const char *)packet_data);
-
-                            if (CRC_M17(packet_data, p_len + 3) == 0)
-                            {
-                                // dump data
-                                if (packet_data[0] == 0x05) // if a text message
-                                {
-                                    // CRC
-                                    if (CRC_M17(packet_data, p_len + 3) == 0) // 3: terminating null plus a 2-byte CRC
-                                    {
-                                        memcpy((uint8_t*)msg.meta, (uint8_t*)lsf.meta, sizeof(lsf.meta));
-                                        strcpy(msg.message, (char*)&packet_data[1]);
-                                        msg.timestamp = time(NULL);
-                                        sprintf(msg.protocol, "M17");
-                                        msg.read = 0;
-
-                                        // dump to database
-                                        printf("Message from %s: %s\n", msg.src, msg.message);
-                                        push_message(db_path, msg);
-
-                                        memset((uint8_t*)&msg, 0, sizeof(message_t));
-
-                                        // blink
-                                        linht_ctrl_green_led_set(true);
-                                        usleep(100e3);
-                                        linht_ctrl_green_led_set(false);
-                                    }
-                                }
-                            }
-                        }
-                    }
-                    else // if it is LSF
-                    {
-                        // decode LSF
-                        decode_LSF(&lsf, pld);
-
-                        uint16_t crc = ((uint16_t)lsf.crc[0] << 8) | lsf.crc[1];
-
-                        if (LSF_CRC(&lsf) == crc)
-                        {
-                            //LSF fields are available here
-                            decode_callsign_bytes((uint8_t*)msg.dst, lsf.dst);
-                            decode_callsign_bytes((uint8_t*)msg.src, lsf.src);
-                        }
-                    }
-
-                    // job done
-                    syncd = 0;
-                    pushed = 0;
-
-                    for (uint8_t i = 0; i < 8; i++)
-                        last[i] = 0.0;
-                }
-            }
+    // the main thread only drives the LED and reports sinks that lose messages
+    struct pollfd led_pfd = {ledsched_fd(&leds), POLLIN, 0};
+    time_t last_report = time(NULL);
+    while (1)
+    {
+        if (poll(&led_pfd, 1, REPORT_S * 1000) > 0)
+            ledsched_dispatch(&leds);
+
+        if (time(NULL) - last_report >= REPORT_S)
+        {
+            sink_report(stdout, true);
+            last_report = time(NULL);
         }
     }
 
+    for (uint8_t i = 0; i < num_workers; i++)
+        pthread_join(tid[i], NULL);
+
     // cleanup - TODO: move it elsewhere
-    zmq_close(zmq_sub);
+    for (uint8_t i = 0; i < num_channels; i++)
+        zmq_close(channels[i].sub);
     zmq_ctx_term(zmq_ctx);
+    ledsched_close(&leds);
 }
@@ -0,0 +1,232 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+
+// libm17
+#include <m17.h>
+
+#include "m17dec.h"
+
+#define FRAME_S 0.04 // 8 syncword + 184 payload symbols at 4800 symbols/s
+
+char input_path[128];
+char truth_path[128];
+uint32_t repeat = 10;
+
+// a frame of the capture: its payload and what the syncword said it is
+typedef struct
+{
+    const float *pld;
+    bool lsf;
+} frame_t;
+
+void print_help(const char *program_name)
+{
+    printf("M17 frame decoder benchmark, libm17 vs m17dec\n\n");
+    printf("Decodes every LSF and packet frame of a capture with libm17's\n");
+    printf("decode_LSF()/decode_pkt_frame() and with m17dec, compares the results\n");
+    printf("and prints the time per frame of both. The frames are found through the\n");
+    printf("syncword positions, so the syncword search is left out.\n\n");
+    printf("Usage: %s -i FILE -x FILE [OPTIONS]\n\n", program_name);
+    printf("Required options:\n");
+    printf("  -i, --input               Symbol capture (float, as m17-packet-gen writes it)\n");
+    printf("  -x, --truth               Syncword positions of the capture, from m17-packet-gen -x\n");
+    printf("Optional options:\n");
+    printf("  -r, --repeat              Decode every frame this many times for the timing (default 10)\n");
+    printf("  -h, --help                Display this help message and exit\n");
+    printf("\n");
+    printf("Example:\n");
+    printf("  m17-packet-gen -o capture.sym -x capture.idx -n 2000 -e 0.5\n");
+    printf("  %s -i capture.sym -x capture.idx\n", program_name);
+}
+
+uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// whole file into memory, `*n` floats
+float *load_symbols(const char *path, size_t *n)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+        return NULL;
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    float *sym = size > 0 ? malloc(size) : NULL;
+    *n = sym ? fread(sym, sizeof(float), size / sizeof(float), f) : 0;
+    fclose(f);
+
+    return sym;
+}
+
+// the "<end> <L|P>" lines of m17-packet-gen -x, frames that end past the capture are left out
+uint32_t load_frames(const char *path, const float *sym, size_t n, frame_t **frames)
+{
+    FILE *f = fopen(path, "r");
+    if (f == NULL)
+        return 0;
+
+    unsigned long long end;
+    char type;
+    uint32_t len = 0, cap = 0;
+
+    *frames = NULL;
+    while (fscanf(f, "%llu %c", &end, &type) == 2)
+    {
+        if (end + 1 + SYM_PER_PLD > n)
+            continue;
+
+        if (len == cap)
+        {
+            cap = cap ? 2 * cap : 1024;
+            frame_t *fr = realloc(*frames, cap * sizeof(frame_t));
+            if (fr == NULL)
+                break;
+            *frames = fr;
+        }
+
+        (*frames)[len].pld = &sym[end + 1];
+        (*frames)[len].lsf = type == 'L';
+        len++;
+    }
+
+    fclose(f);
+    return len;
+}
+
+bool lsf_crc_ok(const lsf_t *lsf)
+{
+    return LSF_CRC(lsf) == (((uint16_t)lsf->crc[0] << 8) | lsf->crc[1]);
+}
+
+// decode all frames `repeat` times, returns ns per frame
+double time_decoder(const frame_t *frames, uint32_t num, bool libm17)
+{
+    lsf_t lsf;
+    uint8_t frame_data[26], eof, fn;
+    volatile uint32_t sink = 0; // keeps the calls from being optimized out
+
+    uint64_t t0 = now_ns();
+    for (uint32_t r = 0; r < repeat; r++)
+    {
+        for (uint32_t i = 0; i < num; i++)
+        {
+            if (frames[i].lsf)
+                sink += libm17 ? decode_LSF(&lsf, frames[i].pld) : m17dec_lsf(&lsf, frames[i].pld);
+            else
+                sink += libm17 ? decode_pkt_frame(frame_data, &eof, &fn, frames[i].pld)
+                               : m17dec_pkt(frame_data, &eof, &fn, frames[i].pld);
+        }
+    }
+
+    return (double)(now_ns() - t0) / ((double)repeat * num);
+}
+
+int main(int argc, char *argv[])
+{
+    static struct option long_options[] =
+        {
+            {"input", required_argument, 0, 'i'},
+            {"truth", required_argument, 0, 'x'},
+            {"repeat", required_argument, 0, 'r'},
+            {"help", no_argument, 0, 'h'},
+            {0, 0, 0, 0}};
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "i:x:r:h", long_options, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 'i':
+            snprintf(input_path, sizeof(input_path), "%s", optarg);
+            break;
+        case 'x':
+            snprintf(truth_path, sizeof(truth_path), "%s", optarg);
+            break;
+        case 'r':
+            repeat = atoi(optarg);
+            break;
+        case 'h':
+            print_help(argv[0]);
+            return 0;
+        default:
+            return 1;
+        }
+    }
+
+    if (!input_path[0] || !truth_path[0] || repeat == 0)
+    {
+        print_help(argv[0]);
+        return 1;
+    }
+
+    size_t n;
+    float *sym = load_symbols(input_path, &n);
+    if (sym == NULL || n == 0)
+    {
+        printf("Cannot read symbols from %s\n", input_path);
+        return 1;
+    }
+
+    frame_t *frames;
+    uint32_t num = load_frames(truth_path, sym, n, &frames);
+    if (num == 0)
+    {
+        printf("No frames in %s\n", truth_path);
+        return 1;
+    }
+
+    m17dec_init();
+
+    // correctness: LSF CRCs of both, packet frames compared bit for bit
+    uint32_t lsfs = 0, lsf_ok_lib = 0, lsf_ok_dec = 0, lsf_same = 0;
+    uint32_t pkts = 0, pkt_same = 0;
+
+    for (uint32_t i = 0; i < num; i++)
+    {
+        if (frames[i].lsf)
+        {
+            lsf_t a, b;
+            decode_LSF(&a, frames[i].pld);
+            m17dec_lsf(&b, frames[i].pld);
+
+            lsfs++;
+            lsf_ok_lib += lsf_crc_ok(&a);
+            lsf_ok_dec += lsf_crc_ok(&b);
+            lsf_same += memcmp(&a, &b, sizeof(lsf_t)) == 0;
+        }
+        else
+        {
+            uint8_t da[26], db[26], eof_a, eof_b, fn_a, fn_b;
+            decode_pkt_frame(da, &eof_a, &fn_a, frames[i].pld);
+            m17dec_pkt(db, &eof_b, &fn_b, frames[i].pld);
+
+            pkts++;
+            pkt_same += memcmp(da, db, sizeof(da)) == 0 && eof_a == eof_b && fn_a == fn_b;
+        }
+    }
+
+    printf("Frames:      %u LSF, %u packet, %zu symbols (%.1f s on air)\n", lsfs, pkts, n, n / 4800.0);
+    printf("LSF CRC ok:  libm17 %u, m17dec %u, identical %u\n", lsf_ok_lib, lsf_ok_dec, lsf_same);
+    printf("Packet:      identical %u of %u\n", pkt_same, pkts);
+
+    double t_lib = time_decoder(frames, num, true);
+    double t_dec = time_decoder(frames, num, false);
+
+    printf("Time/frame:  libm17 %.2f us (%.0fx real time), m17dec %.2f us (%.0fx real time), %.1fx faster\n",
+           t_lib * 1e-3, FRAME_S * 1e9 / t_lib, t_dec * 1e-3, FRAME_S * 1e9 / t_dec, t_lib / t_dec);
+
+    free(frames);
+    free(sym);
+    return 0;
+}
@@ -0,0 +1,202 @@
+#include <string.h>
+#include <math.h>
+#include <m17.h>
+
+#include "m17dec.h"
+
+#define SOFT_BITS (2 * SYM_PER_PLD) // 368 per frame
+#define SOFT_MAX 254                // soft bit value of a sure '1', SOFT_MAX/2 - erasure
+#define LSF_STEPS (240 + 4)         // trellis steps: data bits plus flushing bits
+#define PKT_STEPS (206 + 4)
+#define BIG 0x2000                  // initial metric of the states the encoder cannot start in
+
+typedef int16_t v8i16 __attribute__((vector_size(16)));
+
+// trellis input index -> soft bit index, SOFT_BITS for a punctured bit
+static uint16_t lsf_src[2 * LSF_STEPS];
+static uint16_t pkt_src[2 * PKT_STEPS];
+static uint16_t lsf_erased, pkt_erased;
+
+// soft bit i = clamp(slice_a[i] + slice_b[i] * x), x = symbol for a dibit's
+// MSB, |symbol| for its LSB; the randomizer is folded into the signs
+static float slice_a[SOFT_BITS];
+static float slice_b[SOFT_BITS];
+
+static uint16_t build_src(uint16_t *src, uint16_t n, const uint8_t *punct, uint8_t p_len)
+{
+    uint16_t i = 0, erased = 0;
+
+    for (uint16_t k = 0; k < n; k++)
+    {
+        if (punct[k % p_len] && i < SOFT_BITS)
+        {
+            src[k] = intrl_seq[i++];
+        }
+        else
+        {
+            src[k] = SOFT_BITS;
+            erased++;
+        }
+    }
+
+    return erased;
+}
+
+void m17dec_init(void)
+{
+    const float h = SOFT_MAX / 2;
+
+    for (uint16_t i = 0; i < SOFT_BITS; i++)
+    {
+        uint8_t flip = (rand_seq[i / 8] >> (7 - (i % 8))) & 1;
+
+        // same mapping as libm17's slice_symbols(): MSB 0 for x >= +1,
+        // 1 for x <= -1; LSB 0 for |x| <= 1, 1 for |x| >= 3
+        if (i % 2 == 0)
+        {
+            slice_a[i] = h;
+            slice_b[i] = flip ? h : -h;
+        }
+        else
+        {
+            slice_a[i] = flip ? 3 * h : -h;
+            slice_b[i] = flip ? -h : h;
+        }
+    }
+
+    lsf_erased = build_src(lsf_src, 2 * LSF_STEPS, puncture_pattern_1, sizeof(puncture_pattern_1));
+    pkt_erased = build_src(pkt_src, 2 * PKT_STEPS, puncture_pattern_3, sizeof(puncture_pattern_3));
+}
+
+// clamped as an integer - GCC turns float clamps into branches
+static inline uint8_t clamp_soft(float v)
+{
+    int32_t q = (int32_t)(v + 0.5f);
+
+    q = q > 0 ? q : 0;
+    q = q < SOFT_MAX ? q : SOFT_MAX;
+    return q;
+}
+
+// symbols to derandomized soft bits, branch-free (noisy input would make
+// every clamp a coin toss); soft[SOFT_BITS] is the erasure value
+static void slice(uint8_t soft[SOFT_BITS + 1], const float pld[SYM_PER_PLD])
+{
+    for (uint16_t i = 0; i < SYM_PER_PLD; i++)
+    {
+        float msb = slice_a[2 * i] + slice_b[2 * i] * pld[i];
+        float lsb = slice_a[2 * i + 1] + slice_b[2 * i + 1] * fabsf(pld[i]);
+
+        soft[2 * i] = clamp_soft(msb);
+        soft[2 * i + 1] = clamp_soft(lsb);
+    }
+
+    soft[SOFT_BITS] = SOFT_MAX / 2;
+}
+
+// Viterbi decoder for G1=1+D^3+D^4, G2=1+D+D^2+D^4, starting and ending in
+// state 0. State bit 3 is the newest input bit. The predecessors of state
+// s' are ((s' & 7) << 1) | x for x = 0, 1 - the even and odd old states -
+// so one step is 8 butterflies: two vector adds and a select per half.
+// Writes `steps` - 4 bits to `out` (zeroed by the caller), returns the path
+// metric.
+static uint32_t viterbi(uint8_t *out, const uint8_t *soft, const uint16_t *src, uint16_t steps)
+{
+    // expected G1, G2 for input 0 and x = 0, per s' & 7; flipping the new
+    // bit or x flips both, so the other three branches are complements
+    const v8i16 g1 = {0, -1, 0, -1, 0, -1, 0, -1};
+    const v8i16 g2 = {0, 0, -1, -1, -1, -1, 0, 0};
+    const v8i16 even_idx = {0, 2, 4, 6, 8, 10, 12, 14};
+    const v8i16 odd_idx = {1, 3, 5, 7, 9, 11, 13, 15};
+
+    v8i16 lo = {0, BIG, BIG, BIG, BIG, BIG, BIG, BIG};   // states 0..7
+    v8i16 hi = {BIG, BIG, BIG, BIG, BIG, BIG, BIG, BIG}; // states 8..15
+    v8i16 hist[LSF_STEPS][2]; // decisions: odd predecessor taken
+    uint32_t acc = 0;
+
+    for (uint16_t t = 0; t < steps; t++)
+    {
+        int16_t q0 = soft[src[2 * t]];
+        int16_t q1 = soft[src[2 * t + 1]];
+
+        v8i16 bm = (int16_t)(q0 + q1) + (g1 & (int16_t)(SOFT_MAX - 2 * q0)) + (g2 & (int16_t)(SOFT_MAX - 2 * q1));
+        v8i16 bmc = (int16_t)(2 * SOFT_MAX) - bm;
+
+        v8i16 e = __builtin_shuffle(lo, hi, even_idx);
+        v8i16 o = __builtin_shuffle(lo, hi, odd_idx);
+
+        v8i16 lo_e = e + bm, lo_o = o + bmc;
+        v8i16 hi_e = e + bmc, hi_o = o + bm;
+
+        // ties go to the odd predecessor
+        v8i16 lo_d = lo_e >= lo_o;
+        v8i16 hi_d = hi_e >= hi_o;
+
+        lo = (lo_o & lo_d) | (lo_e & ~lo_d);
+        hi = (hi_o & hi_d) | (hi_e & ~hi_d);
+
+        hist[t][0] = lo_d;
+        hist[t][1] = hi_d;
+
+        // a step adds at most 2*SOFT_MAX, so keeping the metrics relative
+        // to state 0 every 32 steps is enough for int16
+        if ((t & 31) == 31 || t == steps - 1)
+        {
+            int16_t r = lo[0];
+            lo -= r;
+            hi -= r;
+            acc += r;
+        }
+    }
+
+    // trace back from state 0, the flushing bits are not returned
+    uint8_t s = 0;
+    for (int16_t t = steps - 1; t >= 0; t--)
+    {
+        if (t < steps - 4)
+            out[t / 8] |= (s >> 3) << (7 - (t % 8));
+
+        s = ((s & 7) << 1) | (hist[t][s >> 3][s & 7] & 1);
+    }
+
+    return acc;
+}
+
+// metric without the erased bits' constant share, scaled to libm17's 0xFFFF per bit
+static inline uint32_t scale_metric(uint32_t m, uint16_t erased)
+{
+    m -= erased * (SOFT_MAX / 2);
+    return (uint64_t)m * 0xFFFF / SOFT_MAX;
+}
+
+uint32_t m17dec_lsf(lsf_t *lsf, const float pld[SYM_PER_PLD])
+{
+    uint8_t soft[SOFT_BITS + 1];
+    uint8_t lsf_b[30] = {0};
+
+    slice(soft, pld);
+    uint32_t e = viterbi(lsf_b, soft, lsf_src, LSF_STEPS);
+
+    memcpy(lsf->dst, &lsf_b[0], 6);
+    memcpy(lsf->src, &lsf_b[6], 6);
+    memcpy(lsf->type, &lsf_b[12], 2);
+    memcpy(lsf->meta, &lsf_b[14], 14);
+    memcpy(lsf->crc, &lsf_b[28], 2);
+
+    return scale_metric(e, lsf_erased);
+}
+
+uint32_t m17dec_pkt(uint8_t frame_data[26], uint8_t *eof, uint8_t *fn, const float pld[SYM_PER_PLD])
+{
+    uint8_t soft[SOFT_BITS + 1];
+
+    memset(frame_data, 0, 26);
+
+    slice(soft, pld);
+    uint32_t e = viterbi(frame_data, soft, pkt_src, PKT_STEPS);
+
+    *eof = frame_data[25] >> 7;
+    *fn = (frame_data[25] >> 2) & 0x1F;
+
+    return scale_metric(e, pkt_erased);
+}
@@ -0,0 +1,28 @@
+// In-tree M17 LSF and packet frame decoder
+//
+// libm17's decode_LSF()/decode_pkt_frame() keep the Viterbi state and the
+// soft bit buffers in globals, so the decoder threads had to take turns.
+// Here all state lives on the caller's stack. Derandomizing is folded into
+// the symbol slicer, deinterleaving and depuncturing into one precomputed
+// index table, and the 16-state Viterbi decoder (K=5) runs on 8x16-bit
+// vectors - NEON on the A55, SSE2 on x86 (GCC vector extensions).
+//
+// Drop-in replacements: same frame layouts, and the returned path metric
+// uses the same scale as libm17's.
+#ifndef M17DEC_H
+#define M17DEC_H
+
+#include <stdint.h>
+#include <m17.h>
+
+// Build the lookup tables from libm17's constants, call once before decoding
+void m17dec_init(void);
+
+// Decode the 184 payload symbols following an LSF syncword
+uint32_t m17dec_lsf(lsf_t *lsf, const float pld[SYM_PER_PLD]);
+
+// Decode the 184 payload symbols following a packet syncword: 25 data
+// bytes plus the EOF flag and frame number/byte count in frame_data[25]
+uint32_t m17dec_pkt(uint8_t frame_data[26], uint8_t *eof, uint8_t *fn, const float pld[SYM_PER_PLD]);
+
+#endif
@@ -0,0 +1,118 @@
+#include <string.h>
+#include <m17.h>
+
+#include "reasm.h"
+#include "crc16.h"
+
+static void clear(reasm_t *r)
+{
+    r->have = 0;
+    r->crc_n = 0;
+    r->eof_used = 0;
+    r->eof_min = 0;
+    r->last_fn = -1;
+}
+
+void reasm_init(reasm_t *r)
+{
+    memset(r, 0, sizeof(*r));
+    r->last_fn = -1;
+    r->crc_at[0] = CRC16_M17_INIT;
+}
+
+// forget a partial packet nobody has added to for too long
+static inline void expire(reasm_t *r, uint64_t pos)
+{
+    if (pos - r->seen > REASM_TTL)
+        clear(r);
+}
+
+void reasm_lsf(reasm_t *r, const lsf_t *lsf, bool crc_ok, uint64_t pos)
+{
+    expire(r, pos);
+
+    // a different LSF is another packet (or sender), start over
+    if (crc_ok && (!r->lsf_held || memcmp(lsf, &r->lsf, sizeof(lsf_t)) != 0))
+    {
+        clear(r);
+        r->lsf = *lsf;
+        r->lsf_held = true;
+    }
+
+    // a broken one may be a repeat or not - the frames stay, the packet CRC
+    // keeps out mixes, but the sender is unknown until a good LSF comes
+    r->lsf_ok = crc_ok;
+    r->last_fn = -1;
+    r->seen = pos;
+}
+
+int reasm_frame(reasm_t *r, const uint8_t frame_data[26], uint64_t pos, const uint8_t **pkt)
+{
+    bool eof = frame_data[25] >> 7;
+    uint8_t fn = (frame_data[25] >> 2) & 0x1F; // byte count in the EOF frame
+
+    expire(r, pos);
+    r->seen = pos;
+
+    if (!eof)
+    {
+        uint8_t *slot = &r->data[fn * REASM_FRAME_BYTES];
+
+        // the newest copy wins, a repeat replaces a frame that broke the
+        // CRC; the CRC from a changed frame on has to be redone
+        if (fn < r->crc_n && memcmp(slot, frame_data, REASM_FRAME_BYTES) != 0)
+            r->crc_n = fn;
+
+        memcpy(slot, frame_data, REASM_FRAME_BYTES);
+        r->have |= (uint32_t)1 << fn;
+        r->last_fn = fn;
+    }
+    else
+    {
+        if (fn == 0 || fn > REASM_FRAME_BYTES)
+            return REASM_BAD;
+
+        memcpy(r->eof, frame_data, fn);
+        r->eof_used = fn;
+        r->eof_min = r->last_fn + 1; // it came after the frames of this transmission
+    }
+
+    // carry the CRC over the frames 0..hole-1 held now - in order, that is
+    // one frame per call
+    uint8_t hole = ~r->have ? __builtin_ctz(~r->have) : 32;
+
+    for (; r->crc_n < hole; r->crc_n++)
+        r->crc_at[r->crc_n + 1] = crc16_m17(r->crc_at[r->crc_n], &r->data[r->crc_n * REASM_FRAME_BYTES], REASM_FRAME_BYTES);
+
+    if (!r->eof_used || r->eof_min > hole)
+        return eof ? REASM_BAD : REASM_PENDING;
+
+    // the EOF frame goes right after a run of frames 0..k-1, any k up to the
+    // first missing one; usually there is only one candidate
+    for (uint8_t k = r->eof_min; k <= hole; k++)
+    {
+        uint16_t len = k * REASM_FRAME_BYTES + r->eof_used;
+
+        if (len < 3 || crc16_m17(r->crc_at[k], r->eof, r->eof_used) != 0) // type byte and CRC at least
+            continue;
+
+        // the packet is complete in `data` once the EOF frame is in place
+        memcpy(&r->data[k * REASM_FRAME_BYTES], r->eof, r->eof_used);
+
+        uint16_t crc = ((uint16_t)r->data[len - 2] << 8) | r->data[len - 1];
+        bool dup = r->done_len == len && r->done_crc == crc && pos - r->done_at <= REASM_TTL &&
+                   (!r->done_lsf_ok || !r->lsf_ok || memcmp(&r->done_lsf, &r->lsf, sizeof(lsf_t)) == 0);
+
+        r->done_lsf = r->lsf;
+        r->done_lsf_ok = r->lsf_ok;
+        r->done_len = len;
+        r->done_crc = crc;
+        r->done_at = pos;
+        clear(r);
+
+        *pkt = r->data;
+        return dup ? REASM_DUP : len;
+    }
+
+    return eof ? REASM_BAD : REASM_PENDING;
+}
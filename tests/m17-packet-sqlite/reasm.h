@@ -0,0 +1,68 @@
+// M17 packet reassembly
+//
+// Frames are stored by their frame number with a bitmap of the ones held,
+// whatever order they come in, instead of being appended while the frame
+// number keeps counting up. A lost frame no longer throws the packet away:
+// the partial packet is kept, and when the sender repeats the transmission
+// (same LSF) the repeat fills the gaps. The EOF frame carries no frame
+// number, so its position is the one after which the packet CRC checks out.
+// The CRC is carried along the frames as they come in (crc16.h), so trying
+// a position costs one CRC over the EOF frame, not one over the packet.
+//
+// Memory is fixed: one packet's worth of frames per stream. A partial
+// packet is dropped when a different LSF arrives or after REASM_TTL
+// symbols without a frame. A repeat of a packet that was just delivered
+// is reported as REASM_DUP, not delivered again.
+#ifndef REASM_H
+#define REASM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <m17.h>
+
+#define REASM_FRAME_BYTES 25
+#define REASM_MAX_FRAMES 33        // 32 numbered frames and the EOF frame
+#define REASM_TTL (30 * 4800)      // symbols, 30 s
+
+// reasm_frame() results other than a packet length
+#define REASM_PENDING 0            // frames still missing
+#define REASM_BAD -1               // EOF frame received, but the CRC does not check out (yet)
+#define REASM_DUP -2               // complete, but the same packet was just delivered
+
+typedef struct
+{
+    lsf_t lsf;                     // LSF of the packet being collected, last one that passed its CRC
+    bool lsf_held;                 // `lsf` is set
+    bool lsf_ok;                   // ... and the current transmission's LSF was that one
+
+    uint8_t data[REASM_MAX_FRAMES * REASM_FRAME_BYTES];
+    uint32_t have;                 // bit n: frame n is in `data`
+    uint16_t crc_at[REASM_MAX_FRAMES]; // CRC state after frames 0..n-1
+    uint8_t crc_n;                 // frames covered by `crc_at`
+    int8_t last_fn;                // last frame number of the current transmission, -1 after an LSF
+
+    uint8_t eof[REASM_FRAME_BYTES]; // last EOF frame
+    uint8_t eof_used;              // its byte count, 0 - none held
+    uint8_t eof_min;               // lowest frame index the EOF frame can have
+
+    uint64_t seen;                 // stream position (symbols) of the last frame or LSF
+
+    lsf_t done_lsf;                // last delivered packet: LSF, length, CRC, position
+    bool done_lsf_ok;
+    uint16_t done_len;
+    uint16_t done_crc;
+    uint64_t done_at;
+} reasm_t;
+
+void reasm_init(reasm_t *r);
+
+// LSF at stream position `pos`; a partial packet is kept only if this is
+// a repeat of its LSF
+void reasm_lsf(reasm_t *r, const lsf_t *lsf, bool crc_ok, uint64_t pos);
+
+// Packet frame as returned by m17dec_pkt(). Returns the length of the
+// completed packet (CRC included) or one of REASM_*. The packet is not
+// copied: `pkt` points into `r`, valid until the next call for this stream
+int reasm_frame(reasm_t *r, const uint8_t frame_data[26], uint64_t pos, const uint8_t **pkt);
+
+#endif
@@ -0,0 +1,369 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/eventfd.h>
+
+#include "sink.h"
+
+// Broadcast ring: producers claim a position with one atomic add, fill
+// the slot and publish it by storing position + 1 in its sequence number.
+// A reader checks the number before and after copying a slot out; if it
+// changed, a producer lapped the reader meanwhile and the packet is lost.
+typedef struct
+{
+    atomic_ullong seq;         // position + 1 when published, 0 while being written
+    message_t msg;
+    uint8_t data[SINK_PAYLOAD_MAX];
+} sink_slot_t;
+
+static sink_slot_t ring[SINK_RING_LEN];
+static atomic_ullong head;     // next position to claim
+
+static sink_t sinks[SINK_MAX];
+static uint8_t num_sinks;
+
+// counters at the last sink_report(changed)
+static uint64_t reported[SINK_MAX];
+
+static uint64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int sink_add(const sink_ops_t *ops, void *ctx, const char *arg)
+{
+    if (num_sinks == SINK_MAX)
+        return -1;
+
+    sink_t *s = &sinks[num_sinks];
+    memset(s, 0, sizeof(*s));
+
+    s->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (s->efd < 0)
+        return -1;
+
+    s->ops = ops;
+    s->ctx = ctx;
+    snprintf(s->arg, sizeof(s->arg), "%s", arg);
+    num_sinks++;
+
+    return 0;
+}
+
+uint8_t sink_count(void)
+{
+    return num_sinks;
+}
+
+void sink_publish(const message_t *msg)
+{
+    uint64_t pos = atomic_fetch_add(&head, 1);
+    sink_slot_t *sl = &ring[pos & (SINK_RING_LEN - 1)];
+    uint16_t len = msg->len < SINK_PAYLOAD_MAX ? msg->len : SINK_PAYLOAD_MAX;
+
+    atomic_store_explicit(&sl->seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    sl->msg = *msg;
+    sl->msg.len = len;
+    memcpy(sl->data, msg->data, len);
+
+    atomic_store_explicit(&sl->seq, pos + 1, memory_order_release);
+
+    // a full eventfd counter is still a wakeup, the result does not matter
+    uint64_t one = 1;
+    for (uint8_t i = 0; i < num_sinks; i++)
+        if (write(sinks[i].efd, &one, sizeof(one)) < 0)
+            continue;
+}
+
+// next packet for `s` into `msg` (payload into `data`), false if none is ready
+static bool ring_read(sink_t *s, message_t *msg, uint8_t data[SINK_PAYLOAD_MAX])
+{
+    uint64_t next = atomic_load_explicit(&s->next, memory_order_relaxed);
+    bool got = false;
+
+    while (!got)
+    {
+        uint64_t h = atomic_load(&head);
+
+        if (next >= h)
+            break;
+
+        if (h - next > SINK_RING_LEN)
+        {
+            atomic_fetch_add(&s->lost, h - SINK_RING_LEN - next);
+            next = h - SINK_RING_LEN;
+        }
+
+        uint32_t backlog = h - next;
+        if (backlog > atomic_load_explicit(&s->backlog_max, memory_order_relaxed))
+            atomic_store_explicit(&s->backlog_max, backlog, memory_order_relaxed);
+
+        sink_slot_t *sl = &ring[next & (SINK_RING_LEN - 1)];
+        uint64_t seq = atomic_load_explicit(&sl->seq, memory_order_acquire);
+
+        if (seq < next + 1)
+            break; // still being written, its producer wakes us when done
+
+        if (seq == next + 1)
+        {
+            *msg = sl->msg;
+            if (msg->len > SINK_PAYLOAD_MAX)
+                msg->len = SINK_PAYLOAD_MAX; // torn, thrown away below anyway
+            memcpy(data, sl->data, msg->len);
+            msg->data = data;
+
+            atomic_thread_fence(memory_order_acquire);
+            got = atomic_load_explicit(&sl->seq, memory_order_relaxed) == seq;
+        }
+
+        if (!got) // overwritten by a producer a lap ahead
+            atomic_fetch_add(&s->lost, 1);
+        next++;
+    }
+
+    atomic_store_explicit(&s->next, next, memory_order_relaxed);
+    return got;
+}
+
+static void wait_events(sink_t *s, int timeout_ms)
+{
+    struct pollfd pfd[2] = {{s->efd, POLLIN, 0}, {-1, POLLIN, 0}};
+    uint8_t n = 1;
+
+    if (s->ops->fd)
+    {
+        pfd[1].fd = s->ops->fd(s);
+        n = 2;
+    }
+
+    if (poll(pfd, n, timeout_ms) <= 0)
+        return;
+
+    uint64_t v;
+    if (pfd[0].revents & POLLIN)
+        if (read(s->efd, &v, sizeof(v)) < 0)
+            v = 0;
+
+    if (n == 2 && (pfd[1].revents & POLLIN))
+        s->ops->service(s);
+}
+
+static void *sink_thread(void *arg)
+{
+    sink_t *s = arg;
+    message_t msg;
+    uint8_t data[SINK_PAYLOAD_MAX];
+
+    while (1)
+    {
+        // a batching sink gives a short backlog up to batch_ms to grow
+        if (s->ops->batch_ms)
+        {
+            uint64_t deadline = now_ms() + s->ops->batch_ms;
+            uint64_t t;
+
+            uint64_t backlog;
+
+            while ((backlog = atomic_load(&head) - atomic_load(&s->next)) > 0 && backlog < SINK_BATCH_MAX &&
+                   (t = now_ms()) < deadline)
+                wait_events(s, deadline - t);
+        }
+
+        uint8_t n = 0;
+        while (n < SINK_BATCH_MAX && ring_read(s, &msg, data))
+        {
+            switch (s->ops->write(s, &msg))
+            {
+            case SINK_OK:
+                atomic_fetch_add(&s->written, 1);
+                break;
+            case SINK_DROP:
+                atomic_fetch_add(&s->dropped, 1);
+                break;
+            }
+            n++;
+        }
+
+        if (n)
+        {
+            if (s->ops->flush)
+                s->ops->flush(s);
+            atomic_store(&s->synced, atomic_load(&s->next));
+            continue; // there may be more
+        }
+
+        atomic_store(&s->synced, atomic_load(&s->next)); // skipped over lost packets
+        wait_events(s, -1);
+    }
+
+    return NULL;
+}
+
+void sink_start(void)
+{
+    uint64_t h = atomic_load(&head);
+
+    for (uint8_t i = 0; i < num_sinks; i++)
+    {
+        atomic_store(&sinks[i].next, h);
+        atomic_store(&sinks[i].synced, h);
+        pthread_create(&sinks[i].tid, NULL, sink_thread, &sinks[i]);
+    }
+}
+
+uint64_t sink_backlog(void)
+{
+    uint64_t h = atomic_load(&head), max = 0;
+
+    for (uint8_t i = 0; i < num_sinks; i++)
+    {
+        uint64_t b = h - atomic_load(&sinks[i].synced);
+        if (b > max)
+            max = b;
+    }
+
+    return max;
+}
+
+int sink_drain(uint32_t timeout_ms)
+{
+    uint64_t deadline = now_ms() + timeout_ms;
+
+    while (1)
+    {
+        uint64_t h = atomic_load(&head);
+        bool done = true;
+
+        for (uint8_t i = 0; i < num_sinks; i++)
+            if (atomic_load(&sinks[i].synced) < h)
+                done = false;
+
+        if (done)
+            return 0;
+        if (now_ms() >= deadline)
+            return -1;
+
+        usleep(1000);
+    }
+}
+
+void sink_report(FILE *f, bool changed)
+{
+    for (uint8_t i = 0; i < num_sinks; i++)
+    {
+        sink_t *s = &sinks[i];
+        uint64_t dropped = atomic_load(&s->dropped), lost = atomic_load(&s->lost);
+
+        if (changed && dropped + lost == reported[i])
+            continue;
+        reported[i] = dropped + lost;
+
+        fprintf(f, "Sink %s (%s): %llu written, %llu dropped, %llu lost, backlog max %u\n",
+                s->ops->name, s->arg, (unsigned long long)atomic_load(&s->written),
+                (unsigned long long)dropped, (unsigned long long)lost, atomic_load(&s->backlog_max));
+    }
+}
+
+const char *sink_protocol(uint8_t type)
+{
+    switch (type)
+    {
+    case 0x00: return "M17 RAW";
+    case 0x01: return "M17 AX.25";
+    case 0x02: return "M17 APRS";
+    case 0x03: return "M17 6LoWPAN";
+    case 0x04: return "M17 IPv4";
+    case PKT_TYPE_SMS: return "M17";
+    case 0x06: return "M17 Winlink";
+    default: return "M17 packet";
+    }
+}
+
+// append `s` (`len` bytes) as a JSON string
+static int json_str(char *out, int size, int o, const char *s, int len)
+{
+    if (o < size)
+        out[o++] = '"';
+
+    for (int i = 0; i < len && o < size - 7; i++)
+    {
+        uint8_t c = s[i];
+
+        if (c == '"' || c == '\\')
+        {
+            out[o++] = '\\';
+            out[o++] = c;
+        }
+        else if (c < 0x20)
+        {
+            o += sprintf(&out[o], "\\u%04x", c);
+        }
+        else
+        {
+            out[o++] = c;
+        }
+    }
+
+    if (o < size)
+        out[o++] = '"';
+
+    return o;
+}
+
+static int json_hex(char *out, int size, int o, const uint8_t *d, int len)
+{
+    const char hex[] = "0123456789abcdef";
+
+    if (o < size)
+        out[o++] = '"';
+
+    for (int i = 0; i < len && o < size - 3; i++)
+    {
+        out[o++] = hex[d[i] >> 4];
+        out[o++] = hex[d[i] & 15];
+    }
+
+    if (o < size)
+        out[o++] = '"';
+
+    return o;
+}
+
+int sink_json(char *out, int size, const message_t *msg)
+{
+    int o = snprintf(out, size, "{\"timestamp\":%u,\"protocol\":\"%s\",\"type\":%u,\"src\":",
+                     msg->timestamp, sink_protocol(msg->type), msg->type);
+    if (o >= size)
+        return size - 1;
+
+    o = json_str(out, size, o, msg->src, strlen(msg->src));
+    o += snprintf(&out[o], size - o, ",\"dst\":");
+    if (o >= size)
+        return size - 1;
+    o = json_str(out, size, o, msg->dst, strlen(msg->dst));
+    o += snprintf(&out[o], size - o, ",\"meta\":");
+    if (o >= size)
+        return size - 1;
+    o = json_hex(out, size, o, msg->meta, sizeof(msg->meta));
+
+    // text as a string, anything else as hex
+    o += snprintf(&out[o], size - o, msg->type == PKT_TYPE_SMS ? ",\"message\":" : ",\"data\":");
+    if (o >= size)
+        return size - 1;
+    if (msg->type == PKT_TYPE_SMS)
+        o = json_str(out, size, o, (const char *)msg->data, msg->len);
+    else
+        o = json_hex(out, size, o, msg->data, msg->len);
+
+    if (o < size - 1)
+        out[o++] = '}';
+    out[o < size ? o : size - 1] = 0;
+
+    return o < size ? o : size - 1;
+}
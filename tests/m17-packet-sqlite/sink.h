@@ -0,0 +1,116 @@
+// Message sinks for decoded M17 packets
+//
+// The decoder threads hand every packet to sink_publish(), which never
+// blocks: it copies the packet into one ring shared by all sinks and wakes
+// them through their eventfds. Each sink runs in its own thread with its
+// own read position in the ring, so a slow one (a disk, a gateway that
+// stopped reading) only falls behind itself. One that falls more than
+// SINK_RING_LEN packets behind loses the oldest ones - counted, never
+// waited for.
+//
+// Every sink has counters: packets written, dropped by the sink itself
+// (e.g. a full socket buffer), lost in the ring, and the deepest backlog
+// seen - the backpressure it is under.
+#ifndef SINK_H
+#define SINK_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#define SINK_MAX 8
+#define SINK_RING_LEN 256      // packets, a power of two
+#define SINK_PAYLOAD_MAX (33 * 25)
+#define SINK_BATCH_MAX 32      // packets between flush() calls
+
+#define PKT_TYPE_SMS 0x05      // M17 packet types
+
+// a received packet - `data` is not owned: it points into the decoder's
+// reassembly buffer, in a sink into that sink's own copy
+typedef struct message
+{
+    uint32_t timestamp;
+    uint8_t type;              // M17 packet type
+    char src[16];              // callsigns, empty when the LSF was lost
+    char dst[16];
+    uint8_t meta[14];
+    const uint8_t *data;       // payload without the type byte and CRC, text without its null
+    uint16_t len;
+} message_t;
+
+// sink_ops_t.write() results
+enum
+{
+    SINK_OK,                   // written
+    SINK_DROP,                 // could not be written now, counted as dropped
+    SINK_SKIP                  // not for this sink (e.g. binary data on a text-only one)
+};
+
+typedef struct sink sink_t;
+
+typedef struct
+{
+    const char *name;
+    uint16_t batch_ms;         // wait this long for more packets before writing, 0 - write at once
+    int (*write)(sink_t *s, const message_t *msg);
+    void (*flush)(sink_t *s);  // after a batch, optional
+    int (*fd)(sink_t *s);      // own fd to wait on too (a listening socket), optional
+    void (*service)(sink_t *s); // called when fd() is readable
+} sink_ops_t;
+
+struct sink
+{
+    const sink_ops_t *ops;
+    void *ctx;                 // the sink's own state
+    char arg[128];             // path or endpoint, for messages
+
+    int efd;                   // eventfd, written by sink_publish()
+    atomic_ullong next;        // ring position to read, written by the sink thread only
+    atomic_ullong synced;      // positions before this one are written and flushed
+    pthread_t tid;
+
+    atomic_ullong written;
+    atomic_ullong dropped;     // refused by write()
+    atomic_ullong lost;        // overwritten in the ring before they were read
+    atomic_uint backlog_max;   // packets waiting, highest seen
+};
+
+// Register a sink, its output already open. Returns 0 on success
+int sink_add(const sink_ops_t *ops, void *ctx, const char *arg);
+
+// Start the sink threads
+void sink_start(void);
+
+// Hand a packet to every sink, any thread. Never blocks
+void sink_publish(const message_t *msg);
+
+// Wait until the sinks have caught up, at most `timeout_ms`. Returns 0 if they have
+int sink_drain(uint32_t timeout_ms);
+
+// Packets published but not yet written and flushed by the slowest sink
+uint64_t sink_backlog(void);
+
+// Print the counters of every sink; with `changed` only the ones that
+// dropped or lost packets since the last call
+void sink_report(FILE *f, bool changed);
+
+uint8_t sink_count(void);
+
+// Helpers for the sinks
+
+// JSON object of a packet (no newline), as much as fits in `size`. Returns its length
+int sink_json(char *out, int size, const message_t *msg);
+
+const char *sink_protocol(uint8_t type);
+
+// Output of the sinks in sink_*.c, each registers itself with sink_add()
+int sink_db_open(const char *db_path);
+int get_message_count(void);
+int get_unread_message_count(void);
+int sink_zmq_open(const char *endpoint);
+int sink_json_open(const char *path, uint32_t max_bytes, uint8_t keep);
+int sink_unix_open(const char *path);
+
+#endif
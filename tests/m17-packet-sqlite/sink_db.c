@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <sqlite3.h>
+#include <msgdb.h>
+
+#include "sink.h"
+
+#define FLUSH_MS 200 // max. delay between a packet and its write
+
+// message database - one connection for the whole process, used by the
+// sink thread and the count queries (under db_mtx)
+static sqlite3 *db;
+static sqlite3_stmt *insert_stmt;
+static sqlite3_stmt *count_stmt;
+static sqlite3_stmt *unread_count_stmt;
+static pthread_mutex_t db_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+static uint8_t batch_n;  // statements in the open transaction
+static uint8_t batch_ok; // ... that inserted a row
+
+// insert one message in the batch's transaction, started with the first one
+static int db_write(sink_t *s, const message_t *msg)
+{
+    (void)s;
+    int retval;
+
+    if (batch_n == 0)
+    {
+        pthread_mutex_lock(&db_mtx);
+        sqlite3_exec(db, "BEGIN;", 0, 0, 0);
+    }
+
+    // bind values
+    sqlite3_bind_int64(insert_stmt, 1, (sqlite3_int64)msg->timestamp);                  // timestamp (seconds since epoch)
+    sqlite3_bind_text(insert_stmt, 2, sink_protocol(msg->type), -1, SQLITE_STATIC);     // protocol
+    sqlite3_bind_text(insert_stmt, 3, msg->src, -1, SQLITE_STATIC);                     // source
+    sqlite3_bind_text(insert_stmt, 4, msg->dst, -1, SQLITE_STATIC);                     // destination
+    sqlite3_bind_blob(insert_stmt, 5, msg->meta, sizeof(msg->meta), SQLITE_STATIC);     // meta
+    if (msg->type == PKT_TYPE_SMS)
+        sqlite3_bind_text(insert_stmt, 6, (const char *)msg->data, msg->len, SQLITE_STATIC); // message
+    else
+        sqlite3_bind_blob(insert_stmt, 6, msg->data, msg->len, SQLITE_STATIC);         // other packets as they came
+    sqlite3_bind_int(insert_stmt, 7, 0);                                                // read flag (0 = unread)
+
+    // execute
+    retval = sqlite3_step(insert_stmt);
+    sqlite3_reset(insert_stmt);
+    batch_n++;
+
+    if (retval != SQLITE_DONE)
+    {
+        printf("Insert failed: %s\n", sqlite3_errmsg(db));
+        return SINK_DROP;
+    }
+
+    batch_ok++;
+    return SINK_OK;
+}
+
+// commit the batch
+static void db_flush(sink_t *s)
+{
+    if (batch_n == 0)
+        return;
+
+    if (sqlite3_exec(db, "COMMIT;", 0, 0, 0) != SQLITE_OK)
+    {
+        printf("Commit failed: %s\n", sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK;", 0, 0, 0);
+
+        // nothing of the batch made it
+        atomic_fetch_sub(&s->written, batch_ok);
+        atomic_fetch_add(&s->dropped, batch_ok);
+    }
+
+    pthread_mutex_unlock(&db_mtx);
+    batch_n = 0;
+    batch_ok = 0;
+}
+
+static const sink_ops_t db_ops =
+{
+    .name = "sqlite",
+    .batch_ms = FLUSH_MS,
+    .write = db_write,
+    .flush = db_flush,
+};
+
+int sink_db_open(const char *db_path)
+{
+    // creates the table and applies any pending schema migrations
+    if (msgdb_open(&db, db_path) != 0)
+        return 1;
+
+    if (sqlite3_prepare_v2(db, MSGDB_INSERT_SQL, -1, &insert_stmt, 0) != SQLITE_OK ||
+        sqlite3_prepare_v2(db, MSGDB_COUNT_SQL, -1, &count_stmt, 0) != SQLITE_OK ||
+        sqlite3_prepare_v2(db, MSGDB_UNREAD_COUNT_SQL, -1, &unread_count_stmt, 0) != SQLITE_OK)
+    {
+        printf("Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        sqlite3_close(db);
+        return 1;
+    }
+
+    return sink_add(&db_ops, NULL, db_path) != 0;
+}
+
+static int db_count(sqlite3_stmt *stmt)
+{
+    int count = -1;
+
+    pthread_mutex_lock(&db_mtx);
+
+    if (sqlite3_step(stmt) == SQLITE_ROW)
+        count = sqlite3_column_int(stmt, 0);
+    else
+        printf("Query failed: %s\n", sqlite3_errmsg(db));
+
+    sqlite3_reset(stmt);
+    pthread_mutex_unlock(&db_mtx);
+
+    return count;
+}
+
+int get_message_count(void)
+{
+    return db_count(count_stmt);
+}
+
+int get_unread_message_count(void)
+{
+    return db_count(unread_count_stmt);
+}
@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include "sink.h"
+
+// JSON lines file: one object per packet, rotated when it reaches
+// max_bytes - `path` becomes `path`.1, the oldest of `keep` is deleted
+typedef struct
+{
+    FILE *f;
+    char path[128];
+    uint32_t max_bytes;
+    uint8_t keep;
+    uint32_t size;
+} json_sink_t;
+
+static json_sink_t js;
+
+// (re)create the file after a rotation
+static int json_reopen(json_sink_t *j)
+{
+    j->f = fopen(j->path, j->keep ? "a" : "w");
+    j->size = 0;
+
+    return j->f != NULL ? 0 : -1;
+}
+
+static int json_rotate(json_sink_t *j)
+{
+    char from[140], to[140];
+    int ret = 0;
+
+    if (j->f != NULL)
+    {
+        fclose(j->f);
+        j->f = NULL;
+    }
+
+    for (int k = j->keep - 1; k >= 1; k--)
+    {
+        snprintf(from, sizeof(from), "%s.%d", j->path, k);
+        snprintf(to, sizeof(to), "%s.%d", j->path, k + 1);
+        if (rename(from, to) != 0 && errno != ENOENT) // missing ones are fine
+        {
+            printf("Cannot rotate %s: %s\n", from, strerror(errno));
+            ret = -1;
+        }
+    }
+
+    if (j->keep)
+    {
+        // on failure the current file is appended to and tried again later
+        snprintf(to, sizeof(to), "%s.1", j->path);
+        if (rename(j->path, to) != 0 && errno != ENOENT)
+        {
+            printf("Cannot rotate %s: %s\n", j->path, strerror(errno));
+            ret = -1;
+        }
+    }
+
+    if (json_reopen(j) != 0)
+    {
+        printf("Cannot open JSON output file %s: %s\n", j->path, strerror(errno));
+        ret = -1;
+    }
+
+    return ret;
+}
+
+static int json_write(sink_t *s, const message_t *msg)
+{
+    json_sink_t *j = s->ctx;
+    char line[8192];
+
+    if (j->f == NULL && json_reopen(j) != 0) // retried after a failed rotation
+        return SINK_DROP;
+
+    int len = sink_json(line, sizeof(line) - 1, msg);
+    line[len++] = '\n';
+
+    if (fwrite(line, 1, len, j->f) != (size_t)len)
+        return SINK_DROP;
+
+    j->size += len;
+    if (j->size >= j->max_bytes)
+    {
+        fflush(j->f);
+        json_rotate(j);
+    }
+
+    return SINK_OK;
+}
+
+static void json_flush(sink_t *s)
+{
+    json_sink_t *j = s->ctx;
+
+    if (j->f != NULL)
+        fflush(j->f);
+}
+
+static const sink_ops_t json_ops =
+{
+    .name = "json",
+    .write = json_write,
+    .flush = json_flush,
+};
+
+int sink_json_open(const char *path, uint32_t max_bytes, uint8_t keep)
+{
+    json_sink_t *j = &js;
+
+    snprintf(j->path, sizeof(j->path), "%s", path);
+    j->max_bytes = max_bytes;
+    j->keep = keep;
+
+    j->f = fopen(path, "a");
+    if (j->f == NULL)
+    {
+        printf("Cannot open JSON output file %s\n", path);
+        return 1;
+    }
+
+    fseek(j->f, 0, SEEK_END);
+    j->size = ftell(j->f);
+
+    return sink_add(&json_ops, j, path) != 0;
+}
@@ -0,0 +1,130 @@
+#define _GNU_SOURCE // accept4()
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "sink.h"
+
+#define UNIX_CLIENTS 8
+
+// Local stream socket for gateways (an APRS-IS uplink, a bot): every text
+// and APRS packet as one TNC2-style line, "SRC>DST:payload\r\n". Clients
+// connect and read, there is nothing to send. One that does not keep up
+// has the lines dropped while its socket buffer is full
+typedef struct
+{
+    int lfd;
+    int cfd[UNIX_CLIENTS];
+    uint8_t num_clients;
+} unix_sink_t;
+
+static unix_sink_t us;
+
+static int unix_fd(sink_t *s)
+{
+    return ((unix_sink_t *)s->ctx)->lfd;
+}
+
+static void unix_accept(sink_t *s)
+{
+    unix_sink_t *u = s->ctx;
+    int fd;
+
+    while ((fd = accept4(u->lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+    {
+        if (u->num_clients == UNIX_CLIENTS)
+        {
+            close(fd);
+            continue;
+        }
+        u->cfd[u->num_clients++] = fd;
+    }
+}
+
+static void unix_drop_client(unix_sink_t *u, uint8_t i)
+{
+    close(u->cfd[i]);
+    u->cfd[i] = u->cfd[--u->num_clients];
+}
+
+static int unix_write(sink_t *s, const message_t *msg)
+{
+    unix_sink_t *u = s->ctx;
+    char line[1024];
+    int o;
+
+    if (msg->type != PKT_TYPE_SMS && msg->type != 0x02)
+        return SINK_SKIP;
+    if (!msg->src[0] || !u->num_clients) // a line needs a sender, and a reader
+        return SINK_SKIP;
+
+    o = snprintf(line, sizeof(line), "%s>%s:", msg->src, msg->dst[0] ? msg->dst : "ALL");
+
+    // one line per packet, whatever the payload holds
+    for (uint16_t i = 0; i < msg->len && o < (int)sizeof(line) - 2; i++)
+        line[o++] = (msg->data[i] < 0x20 || msg->data[i] == 0x7F) ? ' ' : msg->data[i];
+    line[o++] = '\r';
+    line[o++] = '\n';
+
+    int ret = SINK_OK;
+
+    for (uint8_t i = 0; i < u->num_clients;)
+    {
+        ssize_t n = send(u->cfd[i], line, o, MSG_NOSIGNAL | MSG_DONTWAIT);
+
+        if (n == o)
+        {
+            i++;
+            continue;
+        }
+
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            ret = SINK_DROP; // its buffer is full, the line is lost for this one
+            i++;
+            continue;
+        }
+
+        // gone, or half a line in its buffer - the stream is broken either way
+        unix_drop_client(u, i);
+    }
+
+    return ret;
+}
+
+static const sink_ops_t unix_ops =
+{
+    .name = "unix",
+    .write = unix_write,
+    .fd = unix_fd,
+    .service = unix_accept,
+};
+
+int sink_unix_open(const char *path)
+{
+    unix_sink_t *u = &us;
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+
+    if (strlen(path) >= sizeof(addr.sun_path))
+    {
+        printf("Socket path too long: %s\n", path);
+        return 1;
+    }
+    strcpy(addr.sun_path, path);
+
+    u->lfd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    unlink(path); // left over from the last run
+
+    if (u->lfd < 0 || bind(u->lfd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(u->lfd, UNIX_CLIENTS) != 0)
+    {
+        printf("Cannot listen on %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    return sink_add(&unix_ops, u, path) != 0;
+}
@@ -0,0 +1,56 @@
+#include <stdio.h>
+#include <string.h>
+#include <zmq.h>
+
+#include "sink.h"
+
+#define PUB_HWM 1000 // packets queued per subscriber
+
+// ZMQ PUB: a two-part message per packet, the protocol (as the topic, e.g.
+// "M17" for text) and the packet as JSON - subscribers get new messages
+// pushed instead of polling the database
+static void *zmq_ctx;
+static void *pub;
+
+static int pub_write(sink_t *s, const message_t *msg)
+{
+    (void)s;
+    char json[8192];
+    int len = sink_json(json, sizeof(json), msg);
+    const char *topic = sink_protocol(msg->type);
+
+    // a plain PUB: a subscriber at its HWM loses the packet silently, the
+    // others still get it - only failed sends are counted as dropped
+    if (zmq_send(pub, topic, strlen(topic), ZMQ_SNDMORE | ZMQ_DONTWAIT) < 0)
+        return SINK_DROP;
+    if (zmq_send(pub, json, len, ZMQ_DONTWAIT) < 0)
+        return SINK_DROP;
+
+    return SINK_OK;
+}
+
+static const sink_ops_t pub_ops =
+{
+    .name = "zmq",
+    .write = pub_write,
+};
+
+int sink_zmq_open(const char *endpoint)
+{
+    int hwm = PUB_HWM, linger = 0;
+
+    zmq_ctx = zmq_ctx_new();
+    pub = zmq_socket(zmq_ctx, ZMQ_PUB);
+    zmq_setsockopt(pub, ZMQ_SNDHWM, &hwm, sizeof(hwm));
+    zmq_setsockopt(pub, ZMQ_LINGER, &linger, sizeof(linger));
+
+    if (zmq_bind(pub, endpoint) != 0)
+    {
+        printf("ZeroMQ: Error binding message publisher to %s\n", endpoint);
+        zmq_close(pub);
+        zmq_ctx_term(zmq_ctx);
+        return 1;
+    }
+
+    return sink_add(&pub_ops, NULL, endpoint) != 0;
+}
@@ -0,0 +1,120 @@
+#include <string.h>
+#include <math.h>
+#include <m17.h>
+
+#include "syncw.h"
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#define TAIL (SYNCW_LEN - 1)
+
+void syncw_init(syncw_t *s)
+{
+    memset(s, 0, sizeof(*s));
+
+    for (uint8_t i = 0; i < SYNCW_LEN; i++)
+    {
+        s->pkt[i] = pkt_sync_symbols[i];
+        s->lsf[i] = lsf_sync_symbols[i];
+    }
+}
+
+// squared distances of the window ending at work[j + TAIL]
+static inline void window_dist(const syncw_t *s, int j, float *dp, float *dl)
+{
+    float p = 0.0f, l = 0.0f;
+
+    for (uint8_t k = 0; k < SYNCW_LEN; k++)
+    {
+        float x = s->work[j + k];
+        p += (x - s->pkt[k]) * (x - s->pkt[k]);
+        l += (x - s->lsf[k]) * (x - s->lsf[k]);
+    }
+
+    *dp = p;
+    *dl = l;
+}
+
+static inline int emit(syncw_cand_t *cand, int nc, int j, float dp, float dl, float t2)
+{
+    if (dp < t2)
+    {
+        cand[nc].end = j;
+        cand[nc].type = SYNCW_PKT;
+        cand[nc].dist = sqrtf(dp);
+        return nc + 1;
+    }
+
+    if (dl < t2)
+    {
+        cand[nc].end = j;
+        cand[nc].type = SYNCW_LSF;
+        cand[nc].dist = sqrtf(dl);
+        return nc + 1;
+    }
+
+    return nc;
+}
+
+int syncw_scan(syncw_t *s, const float *sym, int n, float thresh, syncw_cand_t *cand)
+{
+    const float t2 = thresh * thresh;
+    int nc = 0, j = 0;
+
+    if (n > SYNCW_MAX_BLOCK)
+        n = SYNCW_MAX_BLOCK;
+    if (n <= 0)
+        return 0;
+
+    // the tail of the previous block is already in work[0..TAIL-1]
+    memcpy(&s->work[TAIL], sym, n * sizeof(float));
+
+#if defined(__ARM_NEON)
+    // 4 windows per iteration, both syncwords share the loads
+    const float32x4_t vt2 = vdupq_n_f32(t2);
+
+    for (; j + 4 <= n; j += 4)
+    {
+        float32x4_t ap = vdupq_n_f32(0.0f), al = vdupq_n_f32(0.0f);
+
+        for (uint8_t k = 0; k < SYNCW_LEN; k++)
+        {
+            float32x4_t x = vld1q_f32(&s->work[j + k]);
+            float32x4_t d = vsubq_f32(x, vdupq_n_f32(s->pkt[k]));
+            ap = vaddq_f32(ap, vmulq_f32(d, d));
+            d = vsubq_f32(x, vdupq_n_f32(s->lsf[k]));
+            al = vaddq_f32(al, vmulq_f32(d, d));
+        }
+
+        uint32x4_t hit = vorrq_u32(vcltq_f32(ap, vt2), vcltq_f32(al, vt2));
+#if defined(__aarch64__)
+        if (vmaxvq_u32(hit) == 0)
+#else
+        // no across-vector max on ARMv7, two pairwise steps instead
+        uint32x2_t h2 = vpmax_u32(vget_low_u32(hit), vget_high_u32(hit));
+        if (vget_lane_u32(vpmax_u32(h2, h2), 0) == 0)
+#endif
+            continue; // the common case, no syncword anywhere near
+
+        float dp[4], dl[4];
+        vst1q_f32(dp, ap);
+        vst1q_f32(dl, al);
+        for (uint8_t m = 0; m < 4; m++)
+            nc = emit(cand, nc, j + m, dp[m], dl[m], t2);
+    }
+#endif
+
+    for (; j < n; j++)
+    {
+        float dp, dl;
+        window_dist(s, j, &dp, &dl);
+        nc = emit(cand, nc, j, dp, dl, t2);
+    }
+
+    // keep the last symbols for windows spanning into the next block
+    memmove(&s->work[0], &s->work[n], TAIL * sizeof(float));
+
+    return nc;
+}
@@ -0,0 +1,44 @@
+// Block syncword correlator for the M17 symbol stream
+//
+// Instead of shifting a look-back buffer and computing two Euclidean
+// distances per received symbol, a whole ZMQ block is scanned at once for
+// both the packet and the LSF syncword. The decoder then only walks the
+// returned candidates and the payload symbols.
+#ifndef SYNCW_H
+#define SYNCW_H
+
+#include <stdint.h>
+
+#define SYNCW_LEN 8         // symbols
+#define SYNCW_MAX_BLOCK 2048 // symbols per syncw_scan() call
+
+typedef enum
+{
+    SYNCW_PKT = 0,
+    SYNCW_LSF = 1
+} syncw_type_t;
+
+typedef struct
+{
+    int32_t end;  // index of the last syncword symbol in the scanned block
+    uint8_t type; // syncw_type_t
+    float dist;   // Euclidean distance, same metric as libm17's eucl_norm()
+} syncw_cand_t;
+
+typedef struct
+{
+    float pkt[SYNCW_LEN];
+    float lsf[SYNCW_LEN];
+    float work[SYNCW_LEN - 1 + SYNCW_MAX_BLOCK]; // previous block's tail + current block
+} syncw_t;
+
+void syncw_init(syncw_t *s);
+
+// Scan `n` symbols (at most SYNCW_MAX_BLOCK), including the windows that
+// start in the last SYNCW_LEN-1 symbols of the previous block. Writes one
+// candidate per window closer than `thresh` to either syncword, packet
+// syncword first, in stream order. `cand` must hold `n` entries.
+// Returns the number of candidates.
+int syncw_scan(syncw_t *s, const float *sym, int n, float thresh, syncw_cand_t *cand);
+
+#endif
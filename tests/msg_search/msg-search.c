@@ -0,0 +1,153 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+#include <sqlite3.h>
+#include <msgdb.h>
+
+char db_path[128] = "/var/lib/linht/messages.db";
+bool json = false;
+
+void print_help(const char *program_name)
+{
+    printf("Message history search\n\n");
+    printf("Usage: %s [OPTIONS] [WORDS...]\n\n", program_name);
+    printf("Every word is matched as a prefix, all of them have to occur.\n\n");
+    printf("Optional options:\n");
+    printf("  -d, --dbase               Set the messages database file path\n");
+    printf("  -c, --callsign            Only messages from or to this callsign\n");
+    printf("  -b, --before              Only messages with id lower than this (next page, printed on stderr)\n");
+    printf("  -l, --limit               Messages per page (default 20)\n");
+    printf("  -j, --json                One JSON object per line\n");
+    printf("  -h, --help                Display this help message and exit\n");
+    printf("\n");
+    printf("Example:\n");
+    printf("  %s -c SP5WWP -l 10 meet tonig\n", program_name);
+}
+
+void json_str(const char *s)
+{
+    putchar('"');
+    for (; s && *s; s++)
+    {
+        if (*s == '"' || *s == '\\')
+            printf("\\%c", *s);
+        else if ((unsigned char)*s < 0x20)
+            printf("\\u%04x", *s);
+        else
+            putchar(*s);
+    }
+    putchar('"');
+}
+
+int print_row(void *arg, const msgdb_row_t *row)
+{
+    (void)arg;
+
+    if (json)
+    {
+        printf("{\"id\":%lld,\"timestamp\":%lld,\"protocol\":", (long long)row->id, (long long)row->timestamp);
+        json_str(row->protocol);
+        printf(",\"src\":");
+        json_str(row->source);
+        printf(",\"dst\":");
+        json_str(row->destination);
+        printf(",\"read\":%d,\"message\":", row->read);
+        json_str(row->message);
+        printf("}\n");
+    }
+    else
+    {
+        printf("%lld\t%lld\t%s -> %s\t%s\n", (long long)row->id, (long long)row->timestamp,
+               row->source ? row->source : "", row->destination ? row->destination : "",
+               row->message ? row->message : "");
+    }
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    msgdb_query_t q = {0};
+    char text[MSGDB_SEARCH_MAX_TEXT] = {0};
+
+    // Define the long options
+    static struct option long_options[] =
+        {
+            {"dbase", required_argument, 0, 'd'},
+            {"callsign", required_argument, 0, 'c'},
+            {"before", required_argument, 0, 'b'},
+            {"limit", required_argument, 0, 'l'},
+            {"json", no_argument, 0, 'j'},
+            {"help", no_argument, 0, 'h'},
+            {0, 0, 0, 0}};
+
+    // autogenerate the arg list
+    char arglist[64] = {0};
+    for (uint8_t i = 0; i < sizeof(long_options) / sizeof(struct option) - 1; i++)
+    {
+        arglist[strlen(arglist)] = long_options[i].val;
+        if (long_options[i].has_arg != no_argument)
+            arglist[strlen(arglist)] = ':';
+    }
+
+    int opt;
+    int option_index = 0;
+
+    // Parse command line arguments
+    while ((opt = getopt_long(argc, argv, arglist, long_options, &option_index)) != -1)
+    {
+        switch (opt)
+        {
+        case 'd':
+            if (strlen(optarg) > 0 && strlen(optarg) < sizeof(db_path))
+                strcpy(db_path, optarg);
+            break;
+
+        case 'c':
+            q.callsign = optarg;
+            break;
+
+        case 'b':
+            q.before_id = atoll(optarg);
+            break;
+
+        case 'l':
+            q.limit = atoi(optarg);
+            break;
+
+        case 'j':
+            json = true;
+            break;
+
+        case 'h':
+            print_help(argv[0]);
+            return 0;
+            break;
+        }
+    }
+
+    // remaining arguments are the search words
+    for (int i = optind; i < argc; i++)
+    {
+        if (strlen(text) + strlen(argv[i]) + 2 > sizeof(text))
+            break;
+        strcat(text, argv[i]);
+        strcat(text, " ");
+    }
+    q.text = text;
+
+    sqlite3 *db;
+    if (msgdb_open(&db, db_path) != 0)
+        return 1;
+
+    int rows = msgdb_search(db, &q, print_row, NULL);
+    if (q.next_id)
+        fprintf(stderr, "Next page: -b %lld\n", (long long)q.next_id);
+
+    sqlite3_close(db);
+
+    return rows < 0 ? 1 : 0;
+}
@@ -9,8 +9,8 @@
 #include <getopt.h>
 #include <zmq.h>
 #include <linux/input.h>
-#include <arpa/inet.h>
 #include <liblinht-ctrl.h>
+#include <pmt.h>
 
 #define KEY_PRESS 1
 #define KEY_RELEASE 0
@@ -53,15 +53,6 @@ void kbd_cleanup(int fhandle)
     close(fhandle);
 }
 
-uint8_t string_to_pmt(uint8_t *pmt, const char *msg)
-{
-    pmt[0] = 2;                                  // pmt type - zmq message
-    *((uint16_t *)&pmt[1]) = htons(strlen(msg)); // length
-    strcpy((char *)&pmt[3], msg);
-
-    return 3 + strlen(msg);
-}
-
 int main(int argc, char *argv[])
 {
     int rval = 0;
@@ -142,8 +133,8 @@ int main(int argc, char *argv[])
         return 1;
     }
 
-    pmt_len = string_to_pmt(sot_pmt, "SOT");
-    string_to_pmt(eot_pmt, "EOT");
+    pmt_len = pmt_symbol(sot_pmt, sizeof(sot_pmt), "SOT");
+    pmt_symbol(eot_pmt, sizeof(eot_pmt), "EOT");
 
     sleep(2); // required by ZMQ
 
@@ -1,6 +1,9 @@
 #include "fir.h"
 
 #include <algorithm> // std::fill
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
 
 // FIR filter coefficients (inverse-sinc / SX1255 equalization)
 namespace
@@ -32,9 +35,16 @@ constexpr std::array<float, LinHTFir::NUM_TAPS> SX1255_EQ_TAPS = {
 };
 } // namespace
 
+LinHTFirTapsPtr LinHTFir::defaultTaps()
+{
+    static const LinHTFirTapsPtr def =
+        std::make_shared<const LinHTFirTaps>(SX1255_EQ_TAPS.begin(), SX1255_EQ_TAPS.end());
+    return def;
+}
+
 LinHTFir::LinHTFir()
 {
-    reset();
+    setTaps(defaultTaps());
 }
 
 void LinHTFir::reset()
@@ -44,22 +54,42 @@ void LinHTFir::reset()
     pos = 0;
 }
 
+void LinHTFir::setTaps(LinHTFirTapsPtr newTaps)
+{
+    taps = std::move(newTaps);
+
+    size_t len = taps ? taps->size() : 0;
+    if(len != ring.size())
+    {
+        ring.assign(len, std::complex<float>(0.f, 0.f));
+        pos = 0;
+    }
+}
+
 std::complex<float> LinHTFir::processSample(std::complex<float> x)
 {
+    if(!taps)
+    {
+        return x;
+    }
+
+    const float *h = taps->data();
+    const size_t len = ring.size();
+
     ring[pos] = x;
 
     float re = 0, im = 0;
     size_t idx = pos;
 
-    for(size_t k = 0; k < NUM_TAPS; ++k)
+    for(size_t k = 0; k < len; ++k)
     {
         const auto &r = ring[idx];
-        re += r.real() * SX1255_EQ_TAPS[k];
-        im += r.imag() * SX1255_EQ_TAPS[k];
+        re += r.real() * h[k];
+        im += r.imag() * h[k];
 
         if(idx == 0)
         {
-            idx = HISTORY_LEN - 1;
+            idx = len - 1;
         }
         else
         {
@@ -67,10 +97,83 @@ std::complex<float> LinHTFir::processSample(std::complex<float> x)
         }
     }
 
-    if(++pos >= HISTORY_LEN)
+    if(++pos >= len)
     {
         pos = 0;
     }
 
     return {re, im};
 }
+
+// Coefficient file cache ------------------------------------------------
+namespace
+{
+template <typename T>
+bool readRaw(std::ifstream &f, T &v)
+{
+    return static_cast<bool>(f.read(reinterpret_cast<char *>(&v), sizeof(v)));
+}
+} // namespace
+
+void LinHTEqCache::load(const std::string &path)
+{
+    std::ifstream f(path, std::ios::binary);
+    if(!f)
+    {
+        throw std::runtime_error("LinHTEq: cannot open " + path);
+    }
+
+    char magic[4];
+    uint32_t version = 0, count = 0;
+    if(!f.read(magic, sizeof(magic)) || std::memcmp(magic, "LHEQ", 4) != 0 ||
+       !readRaw(f, version) || version != 1 || !readRaw(f, count))
+    {
+        throw std::runtime_error("LinHTEq: " + path + " is not a version 1 LHEQ file");
+    }
+
+    decltype(sets) loaded;
+    for(uint32_t i = 0; i < count; i++)
+    {
+        char name[33] = {0};
+        uint32_t rate = 0, numTaps = 0;
+
+        if(!f.read(name, 32) || !readRaw(f, rate) || !readRaw(f, numTaps))
+        {
+            throw std::runtime_error("LinHTEq: " + path + " is truncated");
+        }
+
+        if(numTaps == 0 || numTaps > LinHTFir::MAX_TAPS)
+        {
+            throw std::runtime_error("LinHTEq: invalid tap count in " + path);
+        }
+
+        auto taps = std::make_shared<LinHTFirTaps>(numTaps);
+        if(!f.read(reinterpret_cast<char *>(taps->data()), numTaps * sizeof(float)))
+        {
+            throw std::runtime_error("LinHTEq: " + path + " is truncated");
+        }
+
+        loaded[{rate, std::string(name)}] = std::move(taps);
+    }
+
+    sets = std::move(loaded);
+}
+
+LinHTFirTapsPtr LinHTEqCache::find(uint32_t rate, const std::string &profile) const
+{
+    auto it = sets.find({rate, profile});
+    return (it != sets.end()) ? it->second : nullptr;
+}
+
+std::vector<std::string> LinHTEqCache::profiles(uint32_t rate) const
+{
+    std::vector<std::string> names;
+    for(const auto &kv : sets)
+    {
+        if(kv.first.first == rate)
+        {
+            names.push_back(kv.first.second);
+        }
+    }
+    return names;
+}
@@ -3,18 +3,63 @@
 #include <array>
 #include <complex>
 #include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+using LinHTFirTaps = std::vector<float>;
+using LinHTFirTapsPtr = std::shared_ptr<const LinHTFirTaps>;
 
 class LinHTFir
 {
 public:
-    static constexpr std::size_t NUM_TAPS = 91;
-    static constexpr std::size_t HISTORY_LEN = NUM_TAPS;
+    static constexpr std::size_t NUM_TAPS = 91;   // built-in SX1255 set
+    static constexpr std::size_t MAX_TAPS = 511;  // limit for loaded sets
 
     LinHTFir();
     void reset();
+
+    // nullptr bypasses the filter; history is kept if the length does not change
+    void setTaps(LinHTFirTapsPtr newTaps);
+    bool enabled() const { return taps != nullptr; }
+
     std::complex<float> processSample(std::complex<float> x);
 
+    // built-in inverse-sinc taps (500 kSa/s)
+    static LinHTFirTapsPtr defaultTaps();
+
 private:
-    std::array<std::complex<float>, HISTORY_LEN> ring;
+    LinHTFirTapsPtr taps;
+    std::vector<std::complex<float>> ring;
     size_t pos = 0;
 };
+
+// Equalizer coefficient sets loaded from a binary file, cached per
+// (sample rate, profile). File layout, little-endian:
+//
+//   char     magic[4]       "LHEQ"
+//   uint32_t version        1
+//   uint32_t count          number of sets
+//   count x {
+//     char     profile[32]  NUL-padded name, e.g. "rev2"
+//     uint32_t rate         sample rate in Sa/s
+//     uint32_t num_taps     1..LinHTFir::MAX_TAPS
+//     float    taps[num_taps]
+//   }
+class LinHTEqCache
+{
+public:
+    // throws std::runtime_error, the cache is left untouched on failure
+    void load(const std::string &path);
+
+    // nullptr if there is no such set
+    LinHTFirTapsPtr find(uint32_t rate, const std::string &profile) const;
+
+    std::vector<std::string> profiles(uint32_t rate) const;
+
+private:
+    std::map<std::pair<uint32_t, std::string>, LinHTFirTapsPtr> sets;
+};
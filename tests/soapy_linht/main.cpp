@@ -7,6 +7,8 @@
 #include <zmq.h>
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
 #include <complex>
 #include <cstdlib>
@@ -14,21 +16,39 @@
 #include <deque>
 #include <iostream>
 #include <limits>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <string>
 #include <vector>
 
 extern "C" {
 #include <sx1255.h>
+#include <sx1255-ctrl.h>
+#include <pmt.h>
 }
 
 #include "fir.h"
+#include "q15.h"
 
 static const size_t ZMQ_LEN_INTS = 2048;  // 2048 int32_t → 1024 complex samples
 static const size_t ZMQ_COMPLEX_SAMPLES = ZMQ_LEN_INTS / 2;
-static const double LINHT_SAMPLE_RATE = 500000.0; // 500 kSa/s
+static const double LINHT_SAMPLE_RATE = 500000.0; // 500 kSa/s, until zmq_proxy tells otherwise
+static const int LINHT_CTRL_TIMEOUT_MS = 200;     // zmq_proxy "RATE" query
 static const double LINHT_CENTER_FREQ = 433.475e6;
 
+// Upper bound on buffered samples per latency mode, the oldest ones are
+// dropped beyond it (reported as SOAPY_SDR_OVERFLOW)
+static const double LINHT_MAX_BUFFER_LOW_S = 0.02;        // 20 ms
+static const double LINHT_MAX_BUFFER_THROUGHPUT_S = 1.0;  // 1 s
+
+// dsp=auto picks the fixed-point chain for CS16 where it is vectorized
+#ifdef __ARM_NEON
+static const bool LINHT_Q15_AUTO = true;
+#else
+static const bool LINHT_Q15_AUTO = false;
+#endif
+
 // SX1255 is a global singleton (the chip is only one and is shared).
 // SoapySDR may create *multiple* LinHTZmqDevice instances for one client
 // (e.g. during negotiation), and each instance calls the constructor/destructor.
@@ -36,7 +56,48 @@ static const double LINHT_CENTER_FREQ = 433.475e6;
 // multiple times and break the GPIO/SPI state for others.
 // `g_sx1255_users` ensures that SX1255 is initialized only once and cleaned up
 // only when the last device instance is destroyed.
+//
+// SoapyRemote calls into the driver from several threads, so the counter and
+// every chip access are guarded by `g_sx1255_mtx`. Other processes (GUI,
+// sx1255-spi) are kept out by the sx1255d broker: when it is running, all
+// commands are forwarded to it and it serializes them with everybody else's.
+static std::mutex g_sx1255_mtx;
 static int g_sx1255_users = 0;
+static void *g_sx1255_zmq = nullptr;
+static sx1255_ctrl_t g_sx1255;
+
+// Stream statistics exposed through the sensor API.
+// Written by the thread calling readStream(), read by whoever calls
+// readSensor() - nothing is derived from them, so relaxed ordering is enough.
+struct LinHTStreamStats
+{
+    std::atomic<uint64_t> zmqBlocks{0};       // complete blocks received
+    std::atomic<uint64_t> zmqDropped{0};      // malformed blocks thrown away
+    std::atomic<uint64_t> timeouts{0};        // readStream() timeouts
+    std::atomic<uint64_t> fifoLevel{0};       // samples waiting in the FIFO
+    std::atomic<double> dspNsPerSample{0.0};  // EWMA of the per-block DSP time
+    std::atomic<double> inputRate{0.0};       // measured over ~1 s windows
+    std::atomic<float> dcI{0.0f};
+    std::atomic<float> dcQ{0.0f};
+    std::atomic<uint64_t> fifoDropped{0};     // samples dropped by the buffer limit
+    std::atomic<double> latencyUs{0.0};       // EWMA, ZMQ arrival -> delivery
+    std::atomic<double> latencyMaxUs{0.0};
+
+    void reset()
+    {
+        zmqBlocks.store(0, std::memory_order_relaxed);
+        zmqDropped.store(0, std::memory_order_relaxed);
+        timeouts.store(0, std::memory_order_relaxed);
+        fifoLevel.store(0, std::memory_order_relaxed);
+        dspNsPerSample.store(0.0, std::memory_order_relaxed);
+        inputRate.store(0.0, std::memory_order_relaxed);
+        dcI.store(0.0f, std::memory_order_relaxed);
+        dcQ.store(0.0f, std::memory_order_relaxed);
+        fifoDropped.store(0, std::memory_order_relaxed);
+        latencyUs.store(0.0, std::memory_order_relaxed);
+        latencyMaxUs.store(0.0, std::memory_order_relaxed);
+    }
+};
 
 // Opaque stream state for this driver
 struct LinHTZmqStream
@@ -44,9 +105,50 @@ struct LinHTZmqStream
     bool active;
     std::string format;
     LinHTFir fir;
+    uint32_t eqGen = 0;  // device eqGen the FIR taps were taken from
     float dc_i = 0.0f;
     float dc_q = 0.0f;
     std::deque<std::complex<float>> fifo;
+
+    // fixed-point chain (stream arg "dsp", default for CS16)
+    bool q15 = false;
+    LinHTFirQ31 firQ31;
+    LinHTDcBlockQ15 dcQ15;
+    std::deque<std::complex<int16_t>> fifo16;
+
+    size_t fifoSize() const
+    {
+        return q15 ? fifo16.size() : fifo.size();
+    }
+
+    void dropOldest(size_t n)
+    {
+        if(q15)
+            fifo16.erase(fifo16.begin(), fifo16.begin() + n);
+        else
+            fifo.erase(fifo.begin(), fifo.begin() + n);
+    }
+
+    // latency mode (stream arg "latency")
+    bool partialReturns = false;  // return what is there instead of waiting for numElems
+    double maxBufferS = 0.0;      // buffered duration limit
+    size_t maxFifo = 0;           // samples, oldest dropped beyond this (maxBufferS at the current rate)
+    bool overflow = false;        // drop happened, report it on the next read
+
+    // arrival time of every block still (partly) in the FIFO; sample
+    // positions count from stream activation
+    struct BlockStamp
+    {
+        uint64_t end;  // position one past the last sample of the block
+        std::chrono::steady_clock::time_point arrival;
+    };
+    std::deque<BlockStamp> blockStamps;
+    uint64_t pushed = 0;
+    uint64_t popped = 0;
+
+    // input rate measurement window
+    std::chrono::steady_clock::time_point rateStart;
+    uint64_t rateSamples = 0;
 };
 
 class LinHTZmqDevice : public SoapySDR::Device
@@ -71,7 +173,7 @@ public:
         SoapySDR::Kwargs info;
         info["origin"] = "SoapySDR driver for LinHT";
         info["endpoint"] = endpoint;
-        info["fixed_sample_rate"] = std::to_string(LINHT_SAMPLE_RATE);
+        info["sample_rate"] = std::to_string(streamRate.load());
         info["fixed_center_freq"] = std::to_string(centerFreqHz);
         return info;
     }
@@ -115,11 +217,34 @@ public:
         return "";
     }
 
-    SoapySDR::ArgInfoList getStreamArgsInfo(const int /*direction*/,
+    SoapySDR::ArgInfoList getStreamArgsInfo(const int direction,
                                             const size_t /*channel*/) const
     {
-        // No special stream args for now
-        return SoapySDR::ArgInfoList();
+        SoapySDR::ArgInfoList infos;
+        if (direction != SOAPY_SDR_RX) return infos;
+
+        SoapySDR::ArgInfo lat;
+        lat.key = "latency";
+        lat.name = "Latency mode";
+        lat.type = SoapySDR::ArgInfo::STRING;
+        lat.value = "throughput";
+        lat.options = {"low", "throughput"};
+        lat.optionNames = {"Low latency", "Throughput"};
+        lat.description = "low: return available samples right away, keep at most 20 ms buffered; "
+                          "throughput: always fill numElems, keep up to 1 s buffered";
+        infos.push_back(lat);
+
+        SoapySDR::ArgInfo dsp;
+        dsp.key = "dsp";
+        dsp.name = "DSP chain";
+        dsp.type = SoapySDR::ArgInfo::STRING;
+        dsp.value = "auto";
+        dsp.options = {"auto", "float", "q15"};
+        dsp.optionNames = {"Auto", "Float", "Fixed-point Q15"};
+        dsp.description = "auto: fixed-point for CS16 on NEON builds, float otherwise; q15 is only valid for CS16";
+        infos.push_back(dsp);
+
+        return infos;
     }
 
     // Frequency API -----------------------------------------------------
@@ -176,7 +301,8 @@ public:
                        const size_t /*channel*/,
                        const double /*rate*/)
     {
-        // Not supported, fixed rate.
+        // Not supported - the rate is set on zmq_proxy's control socket
+        // and announced on its telemetry socket.
     }
 
     double getSampleRate(const int direction,
@@ -184,7 +310,7 @@ public:
     {
         if (direction == SOAPY_SDR_RX && channel == 0)
         {
-            return LINHT_SAMPLE_RATE;
+            return streamRate.load(std::memory_order_relaxed);
         }
         return 0.0;
     }
@@ -194,7 +320,7 @@ public:
     {
         if (direction == SOAPY_SDR_RX && channel == 0)
         {
-            return {LINHT_SAMPLE_RATE};
+            return {streamRate.load(std::memory_order_relaxed)};
         }
         return {};
     }
@@ -205,7 +331,8 @@ public:
         SoapySDR::RangeList ranges;
         if (direction == SOAPY_SDR_RX && channel == 0)
         {
-            ranges.emplace_back(LINHT_SAMPLE_RATE, LINHT_SAMPLE_RATE);
+            const double r = streamRate.load(std::memory_order_relaxed);
+            ranges.emplace_back(r, r);
         }
         return ranges;
     }
@@ -278,13 +405,15 @@ public:
         if(name == "LNA")
         {
             double g = std::clamp(value, 0.0, 48.0);
-            sx1255_set_lna_gain(static_cast<uint8_t>(std::lround(g)));
+            std::lock_guard<std::mutex> lock(g_sx1255_mtx);
+            sx1255_ctrl_set_lna_gain(&g_sx1255, static_cast<uint8_t>(std::lround(g)));
             lnaGainDb = g;
         }
         else if(name == "PGA")
         {
             double g = std::clamp(value, 0.0, 30.0);
-            sx1255_set_pga_gain(static_cast<uint8_t>(std::lround(g)));
+            std::lock_guard<std::mutex> lock(g_sx1255_mtx);
+            sx1255_ctrl_set_pga_gain(&g_sx1255, static_cast<uint8_t>(std::lround(g)));
             pgaGainDb = g;
         }
         else if(name == "DAC")
@@ -298,22 +427,213 @@ public:
                 double d = std::abs(value - a);
                 if (d < bestDiff) { best = a; bestDiff = d; }
             }
-            sx1255_set_dac_gain(static_cast<int8_t>(std::lround(best)));
+            std::lock_guard<std::mutex> lock(g_sx1255_mtx);
+            sx1255_ctrl_set_dac_gain(&g_sx1255, static_cast<int8_t>(std::lround(best)));
             dacGainDb = best;
         }
         else if(name == "MIX")
         {
             double g = std::clamp(value, -37.5, -7.5);
-            sx1255_set_mixer_gain(static_cast<float>(g));
+            std::lock_guard<std::mutex> lock(g_sx1255_mtx);
+            sx1255_ctrl_set_mixer_gain(&g_sx1255, static_cast<float>(g));
             mixGainDb = g;
         }
     }
 
+    // Sensor API --------------------------------------------------------
+    std::vector<std::string> listSensors(void) const
+    {
+        return {"rx_pll_lock", "tx_pll_lock", "zmq_blocks", "zmq_dropped",
+                "stream_timeouts", "fifo_level", "fifo_dropped", "dsp_ns_per_sample",
+                "input_rate", "dc_i", "dc_q", "latency_us", "latency_max_us"};
+    }
+
+    SoapySDR::ArgInfo getSensorInfo(const std::string &key) const
+    {
+        SoapySDR::ArgInfo info;
+        info.key = key;
+        info.type = SoapySDR::ArgInfo::INT;
+
+        if(key == "rx_pll_lock" || key == "tx_pll_lock")
+        {
+            info.type = SoapySDR::ArgInfo::BOOL;
+            info.name = (key[0] == 'r') ? "RX PLL lock" : "TX PLL lock";
+            info.description = "SX1255 PLL lock flag (register 0x11)";
+        }
+        else if(key == "zmq_blocks")
+        {
+            info.name = "ZMQ blocks";
+            info.description = "Baseband blocks received since stream activation";
+        }
+        else if(key == "zmq_dropped")
+        {
+            info.name = "ZMQ dropped";
+            info.description = "Blocks discarded because of a wrong size";
+        }
+        else if(key == "stream_timeouts")
+        {
+            info.name = "Stream timeouts";
+            info.description = "readStream() calls that timed out waiting for data";
+        }
+        else if(key == "fifo_level")
+        {
+            info.name = "FIFO level";
+            info.units = "samples";
+            info.description = "Processed samples waiting to be read";
+        }
+        else if(key == "fifo_dropped")
+        {
+            info.name = "FIFO dropped";
+            info.units = "samples";
+            info.description = "Oldest samples dropped to keep the buffered duration bounded";
+        }
+        else if(key == "latency_us" || key == "latency_max_us")
+        {
+            info.type = SoapySDR::ArgInfo::FLOAT;
+            info.name = (key == "latency_us") ? "Latency" : "Peak latency";
+            info.units = "us";
+            info.description = "Time from ZMQ block arrival to delivery of its samples";
+        }
+        else if(key == "dsp_ns_per_sample")
+        {
+            info.type = SoapySDR::ArgInfo::FLOAT;
+            info.name = "DSP time";
+            info.units = "ns";
+            info.description = "Conversion, FIR and DC removal time per sample";
+        }
+        else if(key == "input_rate")
+        {
+            info.type = SoapySDR::ArgInfo::FLOAT;
+            info.name = "Input rate";
+            info.units = "Sa/s";
+            info.description = "Sample rate measured at the ZMQ input";
+        }
+        else if(key == "dc_i" || key == "dc_q")
+        {
+            info.type = SoapySDR::ArgInfo::FLOAT;
+            info.name = (key == "dc_i") ? "DC estimate I" : "DC estimate Q";
+            info.description = "Current DC removal estimate (full scale = 1.0)";
+        }
+
+        return info;
+    }
+
+    std::string readSensor(const std::string &key) const
+    {
+        const auto rlx = std::memory_order_relaxed;
+
+        if(key == "rx_pll_lock" || key == "tx_pll_lock")
+        {
+            if(!rfCtrlAvailable) return "false";
+
+            uint8_t flags = 0;
+            int8_t rc;
+            {
+                std::lock_guard<std::mutex> lock(g_sx1255_mtx);
+                rc = sx1255_ctrl_read_reg(&g_sx1255, 0x11, &flags);
+            }
+            // a failed read is not "unlocked"
+            if(rc != 0)
+                throw std::runtime_error("LinHTZmq: cannot read the SX1255 PLL lock flags");
+            uint8_t bit = (key[0] == 'r') ? (1 << 1) : (1 << 0);
+            return (flags & bit) ? "true" : "false";
+        }
+        if(key == "zmq_blocks")        return std::to_string(stats.zmqBlocks.load(rlx));
+        if(key == "zmq_dropped")       return std::to_string(stats.zmqDropped.load(rlx));
+        if(key == "stream_timeouts")   return std::to_string(stats.timeouts.load(rlx));
+        if(key == "fifo_level")        return std::to_string(stats.fifoLevel.load(rlx));
+        if(key == "fifo_dropped")      return std::to_string(stats.fifoDropped.load(rlx));
+        if(key == "latency_us")        return std::to_string(stats.latencyUs.load(rlx));
+        if(key == "latency_max_us")    return std::to_string(stats.latencyMaxUs.load(rlx));
+        if(key == "dsp_ns_per_sample") return std::to_string(stats.dspNsPerSample.load(rlx));
+        if(key == "input_rate")        return std::to_string(stats.inputRate.load(rlx));
+        if(key == "dc_i")              return std::to_string(stats.dcI.load(rlx));
+        if(key == "dc_q")              return std::to_string(stats.dcQ.load(rlx));
+
+        throw std::runtime_error("LinHTZmq: unknown sensor " + key);
+    }
+
+    // Settings (RX equalizer) -------------------------------------------
+    SoapySDR::ArgInfoList getSettingInfo(void) const
+    {
+        SoapySDR::ArgInfoList infos;
+
+        SoapySDR::ArgInfo file;
+        file.key = "eq_taps_file";
+        file.name = "EQ taps file";
+        file.type = SoapySDR::ArgInfo::STRING;
+        file.description = "LHEQ coefficient file, empty - built-in taps only";
+        infos.push_back(file);
+
+        SoapySDR::ArgInfo prof;
+        prof.key = "eq_profile";
+        prof.name = "EQ profile";
+        prof.type = SoapySDR::ArgInfo::STRING;
+        prof.value = "default";
+        prof.description = "Coefficient set used at the current sample rate";
+        {
+            std::lock_guard<std::mutex> lock(eqMtx);
+            prof.options = eqCache.profiles(static_cast<uint32_t>(streamRate.load()));
+        }
+        if(std::find(prof.options.begin(), prof.options.end(), "default") == prof.options.end())
+            prof.options.insert(prof.options.begin(), "default");
+        infos.push_back(prof);
+
+        SoapySDR::ArgInfo ena;
+        ena.key = "eq_enable";
+        ena.name = "EQ enable";
+        ena.type = SoapySDR::ArgInfo::BOOL;
+        ena.value = "true";
+        ena.description = "Run the RX equalizer FIR (false - bypass it)";
+        infos.push_back(ena);
+
+        return infos;
+    }
+
+    void writeSetting(const std::string &key, const std::string &value)
+    {
+        std::lock_guard<std::mutex> lock(eqMtx);
+
+        if(key == "eq_taps_file")
+        {
+            if(value.empty())
+                eqCache = LinHTEqCache();
+            else
+                eqCache.load(value);  // throws, the old sets stay in place
+            eqFile = value;
+        }
+        else if(key == "eq_profile")
+        {
+            eqProfile = value;
+        }
+        else if(key == "eq_enable")
+        {
+            eqEnable = (value == "true" || value == "1");
+        }
+        else
+        {
+            throw std::runtime_error("LinHTZmq: unknown setting " + key);
+        }
+
+        selectEqTaps();
+    }
+
+    std::string readSetting(const std::string &key) const
+    {
+        std::lock_guard<std::mutex> lock(eqMtx);
+
+        if(key == "eq_taps_file") return eqFile;
+        if(key == "eq_profile")   return eqProfile;
+        if(key == "eq_enable")    return eqEnable ? "true" : "false";
+
+        throw std::runtime_error("LinHTZmq: unknown setting " + key);
+    }
+
     // Stream API --------------------------------------------------------
     SoapySDR::Stream *setupStream(const int direction,
                                   const std::string &format,
                                   const std::vector<size_t> &channels,
-                                  const SoapySDR::Kwargs & /*args*/)
+                                  const SoapySDR::Kwargs &args)
     {
         if (direction != SOAPY_SDR_RX)
         {
@@ -330,9 +650,46 @@ public:
             throw std::runtime_error("LinHTZmq: only channel 0 is supported");
         }
 
+        bool lowLatency = false;
+        auto latIt = args.find("latency");
+        if (latIt != args.end())
+        {
+            if (latIt->second == "low")
+                lowLatency = true;
+            else if (latIt->second != "throughput")
+                throw std::runtime_error("LinHTZmq: latency must be low or throughput");
+        }
+
+        // the fixed-point chain matches the float one in precision (see
+        // q15-bench) but is only faster with NEON, the scalar code is not
+        bool q15 = LINHT_Q15_AUTO && format == SOAPY_SDR_CS16;
+        auto dspIt = args.find("dsp");
+        if (dspIt != args.end() && dspIt->second != "auto")
+        {
+            if (dspIt->second == "float")
+                q15 = false;
+            else if (dspIt->second == "q15" && format == SOAPY_SDR_CS16)
+                q15 = true;
+            else
+                throw std::runtime_error("LinHTZmq: dsp must be auto, float or q15 (CS16 only)");
+        }
+
+        queryProxyRate();
+
         auto *st = new LinHTZmqStream();
         st->active = false;
         st->format = format;
+        st->q15 = q15;
+        st->partialReturns = lowLatency;
+        st->maxBufferS = lowLatency ? LINHT_MAX_BUFFER_LOW_S : LINHT_MAX_BUFFER_THROUGHPUT_S;
+        st->maxFifo = static_cast<size_t>(streamRate.load() * st->maxBufferS);
+        // generation first, then one load of the taps for both filters: a
+        // writeSetting() in between bumps eqGen again and readStream() picks
+        // up the newer taps with the next block
+        st->eqGen = eqGen.load(std::memory_order_acquire);
+        LinHTFirTapsPtr taps = std::atomic_load(&eqTaps);
+        st->fir.setTaps(taps);
+        st->firQ31.setTaps(taps);
         return reinterpret_cast<SoapySDR::Stream *>(st);
     }
 
@@ -356,10 +713,24 @@ public:
     {
         auto *st = reinterpret_cast<LinHTZmqStream *>(stream);
         if (!st) return SOAPY_SDR_STREAM_ERROR;
+        // the rate may have changed while no stream was reading the events
+        if(queryProxyRate())
+        {
+            st->maxFifo = static_cast<size_t>(streamRate.load() * st->maxBufferS);
+        }
         st->active = true;
         st->fir.reset();
         st->dc_i = st->dc_q = 0.0f;
         st->fifo.clear();
+        st->firQ31.reset();
+        st->dcQ15.reset();
+        st->fifo16.clear();
+        st->blockStamps.clear();
+        st->pushed = st->popped = 0;
+        st->overflow = false;
+        st->rateStart = std::chrono::steady_clock::now();
+        st->rateSamples = 0;
+        stats.reset();
 
         return 0;
     }
@@ -392,22 +763,31 @@ public:
             return SOAPY_SDR_STREAM_ERROR;
         }
 
-        // Ensure FIFO has enough samples.
-        while(st->fifo.size() < numElems)
+        if(st->overflow)
+        {
+            st->overflow = false;
+            flags = 0;
+            return SOAPY_SDR_OVERFLOW;
+        }
+
+        // Ensure FIFO has enough samples. In low latency mode only blocks
+        // that have already arrived are taken once there is something to return.
+        while(st->fifoSize() < numElems)
         {
+            const bool canReturn = st->partialReturns && st->fifoSize() > 0;
+
             // Poll ZMQ.
-            zmq_pollitem_t item;
-            item.socket = zmqSub;
-            item.fd = 0;
-            item.events = ZMQ_POLLIN;
-            item.revents = 0;
+            zmq_pollitem_t items[1] = {
+                { zmqSub, 0, ZMQ_POLLIN, 0 },
+            };
 
             long timeoutMs =
+                canReturn ? 0 :
                 (timeoutUs < 0) ? -1 :
                 (timeoutUs == 0) ? 0 :
                 (timeoutUs + 999) / 1000;
 
-            int pollRet = zmq_poll(&item, 1, timeoutMs);
+            int pollRet = zmq_poll(items, 1, timeoutMs);
             if(pollRet < 0)
             {
                 if(zmq_errno() == EINTR)
@@ -420,61 +800,95 @@ public:
 
             if(pollRet == 0)
             {
+                if(canReturn) break;
+                stats.timeouts.fetch_add(1, std::memory_order_relaxed);
                 return SOAPY_SDR_TIMEOUT;
             }
 
-            // Read one full ZMQ block (1024 complex).
+            // Read one full ZMQ block (1024 complex), switching to the
+            // rate it was captured at first.
             int32_t rxBuf[ZMQ_LEN_INTS];
-            int rc = zmq_recv(zmqSub, rxBuf, sizeof(rxBuf), 0);
-            if(rc <= 0)
+            int rc = recvBlock(st, rxBuf, sizeof(rxBuf));
+            if(rc < 0 && canReturn)
+            {
+                break;
+            }
+            else if(rc < 0)
             {
+                stats.timeouts.fetch_add(1, std::memory_order_relaxed);
                 return SOAPY_SDR_TIMEOUT;
             }
             else if(rc != sizeof(rxBuf))
             {
-                throw std::runtime_error("LinHTZmq: ZMQ data truncated!");
+                // truncated, oversized or malformed block - skip it, keep streaming
+                stats.zmqDropped.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+
+            const auto tBlock = std::chrono::steady_clock::now();
+
+            // pick up new taps between blocks, the filter itself never locks
+            uint32_t gen = eqGen.load(std::memory_order_acquire);
+            if(gen != st->eqGen)
+            {
+                if(st->q15)
+                    st->firQ31.setTaps(std::atomic_load(&eqTaps));
+                else
+                    st->fir.setTaps(std::atomic_load(&eqTaps));
+                st->eqGen = gen;
             }
 
             size_t nInts = rc / sizeof(int32_t);
             size_t nComplex = nInts / 2;
 
-            const float scale = powf(2.0f, -31.0f);
-            const float alpha = 1e-4f;
-
-            for(size_t i = 0; i < nComplex; i++)
+            if(st->q15)
             {
-                // int32 -> float
-                float I = rxBuf[2*i + 0] * scale;
-                float Q = rxBuf[2*i + 1] * scale;
-
-                // FIR
-                auto y = st->fir.processSample({I, Q});
+                processBlockQ15(st, rxBuf, nComplex);
+            }
+            else
+            {
+                processBlockF32(st, rxBuf, nComplex);
+            }
 
-                // DC removal
-                st->dc_i = (1.f - alpha)*st->dc_i + alpha*y.real();
-                st->dc_q = (1.f - alpha)*st->dc_q + alpha*y.imag();
+            st->pushed += nComplex;
+            st->blockStamps.push_back({st->pushed, tBlock});
 
-                st->fifo.emplace_back(y.real() - st->dc_i,
-                                      y.imag() - st->dc_q);
+            // bound the buffered duration, drop the oldest samples
+            if(st->fifoSize() > st->maxFifo)
+            {
+                size_t drop = st->fifoSize() - st->maxFifo;
+                st->dropOldest(drop);
+                st->popped += drop;
+                st->overflow = true;
+                stats.fifoDropped.fetch_add(drop, std::memory_order_relaxed);
             }
+
+            updateBlockStats(st, tBlock, nComplex);
         }
 
+        const size_t n = std::min(numElems, st->fifoSize());
+
         if(st->format == SOAPY_SDR_CF32)
         {
             auto *out = reinterpret_cast<std::complex<float> *>(buffs[0]);
 
-            // Output exactly numElems.
-            for(size_t i = 0; i < numElems; i++)
+            for(size_t i = 0; i < n; i++)
             {
                 out[i] = st->fifo.front();
                 st->fifo.pop_front();
             }
         }
+        else if(st->q15)
+        {
+            auto *out = reinterpret_cast<std::complex<int16_t> *>(buffs[0]);
+
+            std::copy(st->fifo16.begin(), st->fifo16.begin() + n, out);
+            st->fifo16.erase(st->fifo16.begin(), st->fifo16.begin() + n);
+        }
         else if(st->format == SOAPY_SDR_CS16) {
             auto *out = reinterpret_cast<std::complex<int16_t> *>(buffs[0]);
 
-            // Output exactly numElems.
-            for(size_t i = 0; i < numElems; i++)
+            for(size_t i = 0; i < n; i++)
             {
                 // Get CF32 sample from FIFO
                 const std::complex<float> s = st->fifo.front();
@@ -494,9 +908,12 @@ public:
             }
         }
 
+        stats.fifoLevel.store(st->fifoSize(), std::memory_order_relaxed);
+        updateLatency(st, n);
+
         flags = 0;
         timeNs = 0;
-        return (int)numElems;
+        return (int)n;
     }
 
 
@@ -515,6 +932,7 @@ private:
     void *zmqCtx;
     void *zmqSub;
     std::string endpoint;
+    std::string proxyCtrlEndpoint;
 
     double centerFreqHz;
     double lnaGainDb = 0.0;
@@ -529,6 +947,238 @@ private:
     std::string spiDevice;
     std::string gpioChip;
     int resetPinOffset;
+    std::string ctrlEndpoint;
+
+    LinHTStreamStats stats;
+    std::atomic<double> streamRate{LINHT_SAMPLE_RATE};  // as reported by zmq_proxy
+
+    // RX equalizer. The settings are guarded by `eqMtx`; the taps themselves
+    // are published with std::atomic_store() and `eqGen` is bumped so that
+    // readStream() only does an atomic load of the counter per block.
+    mutable std::mutex eqMtx;
+    LinHTEqCache eqCache;
+    std::string eqFile;
+    std::string eqProfile = "default";
+    bool eqEnable = true;
+    LinHTFirTapsPtr eqTaps = LinHTFir::defaultTaps();  // nullptr - bypass
+    std::atomic<uint32_t> eqGen{0};
+
+    // resolve (rate, profile, enable) into a tap set; called with eqMtx held
+    void selectEqTaps()
+    {
+        LinHTFirTapsPtr taps;
+
+        if(eqEnable)
+        {
+            const double rate = streamRate.load();
+            taps = eqCache.find(static_cast<uint32_t>(rate), eqProfile);
+            if(!taps && eqProfile == "default")
+            {
+                taps = LinHTFir::defaultTaps();
+            }
+            if(!taps)
+            {
+                std::cerr << "LinHTZmq: no EQ profile '" << eqProfile << "' for "
+                          << rate / 1000.0 << " kSa/s, using built-in taps\n";
+                taps = LinHTFir::defaultTaps();
+            }
+        }
+
+        std::atomic_store(&eqTaps, taps);
+        eqGen.fetch_add(1, std::memory_order_release);
+    }
+
+    // int32 -> float -> FIR -> DC removal -> float FIFO
+    void processBlockF32(LinHTZmqStream *st, const int32_t *rxBuf, size_t nComplex)
+    {
+        const float scale = powf(2.0f, -31.0f);
+        const float alpha = 1e-4f;
+
+        const bool eqOn = st->fir.enabled();
+
+        for(size_t i = 0; i < nComplex; i++)
+        {
+            // int32 -> float
+            float I = rxBuf[2*i + 0] * scale;
+            float Q = rxBuf[2*i + 1] * scale;
+
+            // FIR (skipped when the equalizer is disabled)
+            std::complex<float> y(I, Q);
+            if(eqOn)
+                y = st->fir.processSample(y);
+
+            // DC removal
+            st->dc_i = (1.f - alpha)*st->dc_i + alpha*y.real();
+            st->dc_q = (1.f - alpha)*st->dc_q + alpha*y.imag();
+
+            st->fifo.emplace_back(y.real() - st->dc_i,
+                                  y.imag() - st->dc_q);
+        }
+    }
+
+    // S32 -> Q31 FIR -> integer DC blocker -> saturated int16 FIFO
+    void processBlockQ15(LinHTZmqStream *st, const int32_t *rxBuf, size_t nComplex)
+    {
+        int32_t yI[ZMQ_COMPLEX_SAMPLES], yQ[ZMQ_COMPLEX_SAMPLES];
+        std::complex<int16_t> out[ZMQ_COMPLEX_SAMPLES];
+
+        st->firQ31.process(rxBuf, yI, yQ, nComplex);
+        st->dcQ15.process(yI, yQ, out, nComplex);
+
+        st->fifo16.insert(st->fifo16.end(), out, out + nComplex);
+        st->dc_i = st->dcQ15.estimateI();
+        st->dc_q = st->dcQ15.estimateQ();
+    }
+
+    // switch getSampleRate() and the equalizer to `rate`; false if unchanged
+    bool applyRate(double rate)
+    {
+        if(rate <= 0.0 || rate == streamRate.load()) return false;
+
+        streamRate.store(rate);
+        {
+            std::lock_guard<std::mutex> lock(eqMtx);
+            selectEqTaps();  // the taps depend on the rate
+        }
+
+        std::cerr << "LinHTZmq: sample rate " << rate / 1000.0 << " kSa/s\n";
+        return true;
+    }
+
+    // ask zmq_proxy for its current rate with a PMT symbol "RATE" on the
+    // control socket, the answer is "RATE=<Sa/s>"; true if the rate changed.
+    // A fresh REQ socket each time, so a lost reply can not wedge the next one.
+    bool queryProxyRate()
+    {
+        if(proxyCtrlEndpoint.empty()) return false;
+
+        void *req = zmq_socket(zmqCtx, ZMQ_REQ);
+        if(!req) return false;
+
+        int tmo = LINHT_CTRL_TIMEOUT_MS, zero = 0;
+        zmq_setsockopt(req, ZMQ_RCVTIMEO, &tmo, sizeof(tmo));
+        zmq_setsockopt(req, ZMQ_SNDTIMEO, &tmo, sizeof(tmo));
+        zmq_setsockopt(req, ZMQ_LINGER, &zero, sizeof(zero));
+
+        uint8_t msg[64];
+        char text[32];
+        double rate = 0.0;
+        int len = 0;
+
+        if(zmq_connect(req, proxyCtrlEndpoint.c_str()) == 0 &&
+           zmq_send(req, msg, pmt_symbol(msg, sizeof(msg), "RATE"), 0) >= 0 &&
+           (len = zmq_recv(req, msg, sizeof(msg), 0)) > 0)
+        {
+            pmt_reader_t r;
+            pmt_item_t sym;
+
+            pmt_reader_init(&r, msg, std::min<size_t>(len, sizeof(msg)));
+            if(pmt_next(&r, &sym) == 1 && pmt_symbol_str(&sym, text, sizeof(text)) &&
+               std::strncmp(text, "RATE=", 5) == 0)
+            {
+                rate = std::strtod(text + 5, nullptr);
+            }
+        }
+        else
+        {
+            std::cerr << "LinHTZmq: no answer from zmq_proxy at " << proxyCtrlEndpoint
+                      << ", assuming " << streamRate.load() / 1000.0 << " kSa/s\n";
+        }
+
+        zmq_close(req);
+        return applyRate(rate);
+    }
+
+    // more parts of the current message follow
+    bool rcvMore()
+    {
+        int more = 0;
+        size_t len = sizeof(more);
+        return zmq_getsockopt(zmqSub, ZMQ_RCVMORE, &more, &len) == 0 && more;
+    }
+
+    // One baseband block into `buf`: a single-part message is a raw block,
+    // zmq_proxy's rate socket sends a uint32_t rate (Sa/s) and then the block,
+    // and the rate is applied before the block is returned. Returns the block
+    // size as zmq_recv() does, -1 - nothing received, 0 - malformed message.
+    int recvBlock(LinHTZmqStream *st, int32_t *buf, size_t size)
+    {
+        int rc = zmq_recv(zmqSub, buf, size, 0);
+        if(rc < 0 || !rcvMore()) return rc;
+
+        uint32_t rate = 0;
+        bool tagged = rc == sizeof(rate);
+        if(tagged) std::memcpy(&rate, buf, sizeof(rate));
+
+        // the parts of a message arrive together, this does not block
+        rc = zmq_recv(zmqSub, buf, size, 0);
+        while(rcvMore())
+        {
+            zmq_recv(zmqSub, buf, 0, 0);
+            tagged = false;
+        }
+        if(rc < 0 || !tagged) return 0;
+
+        if(applyRate(rate))
+        {
+            st->maxFifo = static_cast<size_t>(streamRate.load() * st->maxBufferS);
+        }
+        return rc;
+    }
+
+    // called once per processed ZMQ block, `t0` is the time the block arrived
+    void updateBlockStats(LinHTZmqStream *st,
+                          std::chrono::steady_clock::time_point t0,
+                          size_t nComplex)
+    {
+        using namespace std::chrono;
+        const auto rlx = std::memory_order_relaxed;
+        const auto t1 = steady_clock::now();
+
+        stats.zmqBlocks.fetch_add(1, rlx);
+        stats.dcI.store(st->dc_i, rlx);
+        stats.dcQ.store(st->dc_q, rlx);
+
+        double ns = duration_cast<nanoseconds>(t1 - t0).count() / (double)nComplex;
+        double prev = stats.dspNsPerSample.load(rlx);
+        stats.dspNsPerSample.store(prev == 0.0 ? ns : prev + 0.05 * (ns - prev), rlx);
+
+        st->rateSamples += nComplex;
+        double dt = duration<double>(t1 - st->rateStart).count();
+        if(dt >= 1.0)
+        {
+            stats.inputRate.store(st->rateSamples / dt, rlx);
+            st->rateStart = t1;
+            st->rateSamples = 0;
+        }
+    }
+
+    // called after `n` samples were handed to the client
+    void updateLatency(LinHTZmqStream *st, size_t n)
+    {
+        using namespace std::chrono;
+        const auto rlx = std::memory_order_relaxed;
+
+        st->popped += n;
+
+        // drop stamps of blocks that are gone (delivered or dropped)
+        while(!st->blockStamps.empty() && st->blockStamps.front().end < st->popped)
+        {
+            st->blockStamps.pop_front();
+        }
+
+        // the front block now holds the last delivered sample
+        if(n == 0 || st->blockStamps.empty()) return;
+
+        double us = duration<double, std::micro>(steady_clock::now() -
+                                                 st->blockStamps.front().arrival).count();
+        double prev = stats.latencyUs.load(rlx);
+        stats.latencyUs.store(prev == 0.0 ? us : prev + 0.05 * (us - prev), rlx);
+        if(us > stats.latencyMaxUs.load(rlx))
+        {
+            stats.latencyMaxUs.store(us, rlx);
+        }
+    }
 
     void applyHardwareFrequency()
     {
@@ -543,8 +1193,11 @@ private:
 
         uint32_t f_hz = static_cast<uint32_t>(freq + 0.5);
 
-        sx1255_set_rx_freq(f_hz);
-        // sx1255_set_tx_freq(f_hz);
+        {
+            std::lock_guard<std::mutex> lock(g_sx1255_mtx);
+            sx1255_ctrl_set_rx_freq(&g_sx1255, f_hz);
+            // sx1255_ctrl_set_tx_freq(&g_sx1255, f_hz);
+        }
 
         std::cerr << "LinHTZmq: SX1255 tuned to " << f_hz / 1e6 << " MHz\n";
     }
@@ -553,17 +1206,23 @@ private:
 LinHTZmqDevice::LinHTZmqDevice(const SoapySDR::Kwargs &args)
     : zmqCtx(nullptr)
     , zmqSub(nullptr)
-    , endpoint("ipc:///tmp/bsb_rx")
+    , endpoint("ipc:///tmp/bsb_rx_rate")
+    , proxyCtrlEndpoint("ipc:///tmp/bsb_ctrl")
     , centerFreqHz(LINHT_CENTER_FREQ)
     , rfCtrlAvailable(false)
     , spiDevice("/dev/spidev0.0")
     , gpioChip("/dev/gpiochip0")
     , resetPinOffset(22)
+    , ctrlEndpoint(SX1255_CTRL_IPC)
 {
     auto epIt = args.find("rx_endpoint");
     if(epIt != args.end())
         endpoint = epIt->second;
 
+    auto pcIt = args.find("proxy_ctrl");
+    if(pcIt != args.end())
+        proxyCtrlEndpoint = pcIt->second;
+
     zmqCtx = zmq_ctx_new();
     if(!zmqCtx)
         throw std::runtime_error("LinHTZmq: failed to create ZMQ context");
@@ -591,8 +1250,10 @@ LinHTZmqDevice::LinHTZmqDevice(const SoapySDR::Kwargs &args)
         throw std::runtime_error("LinHTZmq: failed to connect to endpoint " + endpoint);
     }
 
+    queryProxyRate();
+
     std::cerr << "LinHTZmq: connected to " << endpoint
-              << " (CF32, " << LINHT_SAMPLE_RATE/1000.0 << " kSa/s, "
+              << " (CF32, " << streamRate.load()/1000.0 << " kSa/s, "
               << centerFreqHz/1e6 << " MHz)\n";
 
     // SX1255 config.
@@ -627,39 +1288,83 @@ LinHTZmqDevice::LinHTZmqDevice(const SoapySDR::Kwargs &args)
         }
     }
 
-    // --- SX1255 init ---
-    if (g_sx1255_users == 0) {
-        rc = sx1255_init(spiDevice.c_str(), gpioChip.c_str(), resetPinOffset);
-        if(rc != 0)
-        {
-            std::cerr << "LinHTZmq: sx1255_init("
-                      << spiDevice << ", " << gpioChip
-                      << ", " << resetPinOffset << ") failed, rc=" << rc << "\n";
-            rfCtrlAvailable = false;
-            return;
+    auto ctrlIt = args.find("sx1255_ctrl");
+    if(ctrlIt != args.end())
+    {
+        // empty value - skip the broker, access the chip directly
+        ctrlEndpoint = ctrlIt->second;
+    }
+
+    auto eqIt = args.find("eq_taps_file");
+    if(eqIt != args.end() && !eqIt->second.empty())
+    {
+        try
+        {
+            writeSetting("eq_taps_file", eqIt->second);
+        }
+        catch(const std::exception &e)
+        {
+            std::cerr << e.what() << ", using built-in EQ taps\n";
         }
+    }
 
-        std::cerr
-            << "LinHTZmq: using SX1255 spi="
-            << spiDevice
-            << " gpio=" << gpioChip
-            << " reset=" << resetPinOffset << "\n";
+    // --- SX1255 init ---
+    {
+        std::lock_guard<std::mutex> lock(g_sx1255_mtx);
 
-        sx1255_reset();
-        sx1255_set_rate(SX1255_RATE_500K);
-        sx1255_set_rx_pll_bw(75);
-        sx1255_set_tx_pll_bw(75);
-        sx1255_enable_rx(true);
-        // sx1255_enable_tx(true);
+        if (g_sx1255_users == 0) {
+            g_sx1255_zmq = zmq_ctx_new();
+            rc = sx1255_ctrl_open(&g_sx1255, g_sx1255_zmq, ctrlEndpoint.c_str(),
+                                  spiDevice.c_str(), gpioChip.c_str(), resetPinOffset);
+            if(rc != 0)
+            {
+                std::cerr << "LinHTZmq: SX1255 open("
+                          << spiDevice << ", " << gpioChip
+                          << ", " << resetPinOffset << ") failed, rc=" << rc << "\n";
+                zmq_ctx_term(g_sx1255_zmq);
+                g_sx1255_zmq = nullptr;
+                rfCtrlAvailable = false;
+                return;
+            }
 
-        sx1255_set_lna_gain(static_cast<uint8_t>(std::lround(lnaGainDb)));
-        sx1255_set_pga_gain(static_cast<uint8_t>(std::lround(pgaGainDb)));
-        sx1255_set_dac_gain(static_cast<int8_t>(std::lround(dacGainDb)));
-        sx1255_set_mixer_gain(static_cast<float>(mixGainDb));
+            if (sx1255_ctrl_brokered(&g_sx1255))
+            {
+                // no reset and no rate here: through the broker the chip is
+                // shared, and the rate belongs to zmq_proxy
+                std::cerr << "LinHTZmq: using SX1255 broker at " << ctrlEndpoint << "\n";
+            }
+            else
+            {
+                std::cerr
+                    << "LinHTZmq: using SX1255 spi="
+                    << spiDevice
+                    << " gpio=" << gpioChip
+                    << " reset=" << resetPinOffset << "\n";
+
+                // the chip is ours alone, set it up as before; the rate is
+                // the one zmq_proxy reported above, or the default
+                double rate = streamRate.load();
+                sx1255_rate_t r = (rate == 125000.0) ? SX1255_RATE_125K :
+                                  (rate == 250000.0) ? SX1255_RATE_250K : SX1255_RATE_500K;
+
+                sx1255_ctrl_reset(&g_sx1255);
+                sx1255_ctrl_set_rate(&g_sx1255, r);
+            }
+
+            sx1255_ctrl_set_rx_pll_bw(&g_sx1255, 75);
+            sx1255_ctrl_set_tx_pll_bw(&g_sx1255, 75);
+            sx1255_ctrl_enable_rx(&g_sx1255, true);
+            // sx1255_ctrl_enable_tx(&g_sx1255, true);
 
+            sx1255_ctrl_set_lna_gain(&g_sx1255, static_cast<uint8_t>(std::lround(lnaGainDb)));
+            sx1255_ctrl_set_pga_gain(&g_sx1255, static_cast<uint8_t>(std::lround(pgaGainDb)));
+            sx1255_ctrl_set_dac_gain(&g_sx1255, static_cast<int8_t>(std::lround(dacGainDb)));
+            sx1255_ctrl_set_mixer_gain(&g_sx1255, static_cast<float>(mixGainDb));
+        }
+
+        g_sx1255_users++;
     }
 
-    g_sx1255_users++;
     rfCtrlAvailable = true;
     applyHardwareFrequency();
 }
@@ -677,10 +1382,17 @@ LinHTZmqDevice::~LinHTZmqDevice()
         zmqCtx = nullptr;
     }
 
-    g_sx1255_users--;
-    if (g_sx1255_users == 0)
+    if (rfCtrlAvailable)
     {
-        sx1255_cleanup();
+        std::lock_guard<std::mutex> lock(g_sx1255_mtx);
+
+        g_sx1255_users--;
+        if (g_sx1255_users == 0)
+        {
+            sx1255_ctrl_close(&g_sx1255);
+            zmq_ctx_term(g_sx1255_zmq);
+            g_sx1255_zmq = nullptr;
+        }
     }
     rfCtrlAvailable = false;
 }
@@ -699,10 +1411,12 @@ static SoapySDR::KwargsList findLinHTZmq(const SoapySDR::Kwargs &args)
     dev["label"] = "LinHT ZMQ";
 
     // Defaulty pro SX1255 + RX endpoint
-    dev["rx_endpoint"]  = "ipc:///tmp/bsb_rx";
+    dev["rx_endpoint"]  = "ipc:///tmp/bsb_rx_rate";
     dev["sx1255_spi"]   = "/dev/spidev0.0";
     dev["sx1255_gpio"]  = "/dev/gpiochip0";
     dev["sx1255_reset"] = "22";
+    dev["sx1255_ctrl"]  = SX1255_CTRL_IPC;
+    dev["proxy_ctrl"]   = "ipc:///tmp/bsb_ctrl";
 
     // Když uživatel v původních args něco přepíše, respektuj to:
     auto epIt = args.find("rx_endpoint");
@@ -721,6 +1435,14 @@ static SoapySDR::KwargsList findLinHTZmq(const SoapySDR::Kwargs &args)
     if (rstIt != args.end())
         dev["sx1255_reset"] = rstIt->second;
 
+    auto ctrlIt = args.find("sx1255_ctrl");
+    if (ctrlIt != args.end())
+        dev["sx1255_ctrl"] = ctrlIt->second;
+
+    auto pcIt = args.find("proxy_ctrl");
+    if (pcIt != args.end())
+        dev["proxy_ctrl"] = pcIt->second;
+
     results.push_back(dev);
     return results;
 }
@@ -0,0 +1,139 @@
+// q15-bench: precision and speed of the float and fixed-point RX chains
+//
+//   q15-bench [blocks]
+//
+// Feeds both chains the same synthetic S32 input - two tones plus noise
+// and a DC offset, about -9 dBFS - in blocks of 1024 samples, as the
+// driver does. The reference is the float chain without output rounding;
+// SNR is measured against it after the DC blocker has settled.
+// Throughput is one core, one stream, including the format conversions.
+
+#include "fir.h"
+#include "q15.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace
+{
+constexpr size_t BLOCK = 1024;
+constexpr double RATE = 500000.0;
+constexpr size_t SETTLE = 20000; // samples skipped before measuring
+constexpr float DC_ALPHA = 1e-4f;  // as in the driver's float chain
+
+using Clock = std::chrono::steady_clock;
+
+std::vector<int32_t> makeInput(size_t n)
+{
+    std::mt19937 rng(1);
+    std::normal_distribution<double> noise(0.0, 1.0);
+    std::vector<int32_t> in(2*n);
+
+    for(size_t k = 0; k < n; k++)
+    {
+        double t = k / RATE;
+        double i = 0.25*std::cos(2*M_PI*12500*t) + 0.15*std::cos(2*M_PI*-90000*t + 1) + 0.02*noise(rng) + 0.01;
+        double q = 0.25*std::sin(2*M_PI*12500*t) + 0.15*std::sin(2*M_PI*-90000*t + 1) + 0.02*noise(rng) - 0.005;
+
+        // the SX1255 delivers 24 significant bits
+        in[2*k + 0] = static_cast<int32_t>(std::lrint(i * 2147483647.0)) & ~0xff;
+        in[2*k + 1] = static_cast<int32_t>(std::lrint(q * 2147483647.0)) & ~0xff;
+    }
+
+    return in;
+}
+
+// float chain as in the driver; `ref` unrounded, `out` rounded to int16
+double runFloat(const std::vector<int32_t> &in, LinHTFirTapsPtr taps,
+                std::vector<std::complex<float>> &ref, std::vector<std::complex<int16_t>> &out)
+{
+    size_t n = in.size() / 2;
+    LinHTFir fir;
+    float dcI = 0.f, dcQ = 0.f;
+    const float scale = 1.0f / 2147483648.0f;
+
+    fir.setTaps(taps);
+    ref.resize(n);
+    out.resize(n);
+
+    auto t0 = Clock::now();
+    for(size_t k = 0; k < n; k++)
+    {
+        std::complex<float> y = fir.processSample({in[2*k] * scale, in[2*k + 1] * scale});
+
+        dcI = (1.0f - DC_ALPHA)*dcI + DC_ALPHA*y.real();
+        dcQ = (1.0f - DC_ALPHA)*dcQ + DC_ALPHA*y.imag();
+        ref[k] = {y.real() - dcI, y.imag() - dcQ};
+        out[k] = {static_cast<int16_t>(std::lrint(std::clamp(ref[k].real(), -1.f, 1.f) * 32767.f)),
+                  static_cast<int16_t>(std::lrint(std::clamp(ref[k].imag(), -1.f, 1.f) * 32767.f))};
+    }
+
+    return std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / n;
+}
+
+double runQ15(const std::vector<int32_t> &in, std::vector<std::complex<int16_t>> &out)
+{
+    size_t n = in.size() / 2;
+    LinHTFirQ31 fir;
+    LinHTDcBlockQ15 dc;
+    std::vector<int32_t> yI(BLOCK), yQ(BLOCK);
+
+    out.resize(n);
+
+    auto t0 = Clock::now();
+    for(size_t k = 0; k + BLOCK <= n; k += BLOCK)
+    {
+        fir.process(&in[2*k], yI.data(), yQ.data(), BLOCK);
+        dc.process(yI.data(), yQ.data(), &out[k], BLOCK);
+    }
+
+    return std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / n;
+}
+
+double snr(const std::vector<std::complex<float>> &ref, const std::vector<std::complex<int16_t>> &out)
+{
+    double ps = 0.0, pe = 0.0;
+
+    for(size_t k = SETTLE; k < ref.size(); k++)
+    {
+        std::complex<double> r(ref[k].real() * 32768.0, ref[k].imag() * 32768.0);
+        std::complex<double> o(out[k].real(), out[k].imag());
+
+        ps += std::norm(r);
+        pe += std::norm(r - o);
+    }
+
+    return 10.0 * std::log10(ps / pe);
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    size_t blocks = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2000;
+    if(blocks * BLOCK <= SETTLE)
+    {
+        std::fprintf(stderr, "Usage: %s [blocks > %zu]\n", argv[0], SETTLE / BLOCK);
+        return 1;
+    }
+
+    std::vector<int32_t> in = makeInput(blocks * BLOCK);
+    std::vector<std::complex<float>> ref;
+    std::vector<std::complex<int16_t>> outF, outQ;
+
+    double nsF = runFloat(in, LinHTFir::defaultTaps(), ref, outF);
+    double nsQ = runQ15(in, outQ);
+
+    std::printf("%zu samples, block %zu\n", in.size() / 2, BLOCK);
+    std::printf("SNR   float, rounded to int16   %5.1f dB\n", snr(ref, outF));
+    std::printf("      fixed-point               %5.1f dB\n", snr(ref, outQ));
+    std::printf("time  float  %6.1f ns/sample  %6.2f MSa/s\n", nsF, 1e3 / nsF);
+    std::printf("      fixed  %6.1f ns/sample  %6.2f MSa/s\n", nsQ, 1e3 / nsQ);
+
+    return 0;
+}
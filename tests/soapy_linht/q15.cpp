@@ -0,0 +1,223 @@
+#include "q15.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+inline int16_t sat16(int64_t v)
+{
+    return static_cast<int16_t>(std::clamp<int64_t>(v, INT16_MIN, INT16_MAX));
+}
+
+// round half up, same as the NEON rounding shifts
+inline int64_t rshiftRound(int64_t v, int s)
+{
+    return s > 0 ? (v + (int64_t(1) << (s - 1))) >> s : v;
+}
+
+// rounding right shift (s < 0) or saturating left shift (s > 0), as vqrshlq_s32
+inline int32_t shiftSat32(int32_t v, int s)
+{
+    if(s <= 0)
+        return static_cast<int32_t>(rshiftRound(v, -s));
+
+    int64_t r = int64_t(v) * (int64_t(1) << std::min(s, 32));
+    return static_cast<int32_t>(std::clamp<int64_t>(r, INT32_MIN, INT32_MAX));
+}
+
+// (2*a*b + 2^31) >> 32, as vqrdmulh; saturates only for INT32_MIN * INT32_MIN,
+// which the tap quantization rules out
+inline int32_t qrdmulh(int32_t a, int32_t b)
+{
+    return static_cast<int32_t>((2 * int64_t(a) * b + (int64_t(1) << 31)) >> 32);
+}
+
+#ifdef __ARM_NEON
+// acc + qrdmulh(x, h) per lane; a single instruction with the ARMv8.1 RDM
+// extension, identical results either way as the accumulator never saturates
+inline int32x4_t qrdmlah(int32x4_t acc, int32x4_t x, int32_t h)
+{
+#if defined(__ARM_FEATURE_QRDMX)
+    return vqrdmlahq_s32(acc, x, vdupq_n_s32(h));
+#else
+    return vaddq_s32(acc, vqrdmulhq_n_s32(x, h));
+#endif
+}
+#endif
+
+// deinterleave `n` complex S32 samples, rounding shift right by `s`
+void deinterleave(const int32_t *in, int32_t *outI, int32_t *outQ, size_t n, int s)
+{
+    size_t i = 0;
+
+#ifdef __ARM_NEON
+    const int32x4_t shift = vdupq_n_s32(-s);
+    for(; i + 4 <= n; i += 4)
+    {
+        int32x4x2_t v = vld2q_s32(in + 2*i);
+        vst1q_s32(outI + i, vrshlq_s32(v.val[0], shift));
+        vst1q_s32(outQ + i, vrshlq_s32(v.val[1], shift));
+    }
+#endif
+
+    for(; i < n; i++)
+    {
+        outI[i] = static_cast<int32_t>(rshiftRound(in[2*i + 0], s));
+        outQ[i] = static_cast<int32_t>(rshiftRound(in[2*i + 1], s));
+    }
+}
+} // namespace
+
+LinHTFirQ31::LinHTFirQ31()
+{
+    setTaps(LinHTFir::defaultTaps());
+}
+
+void LinHTFirQ31::reset()
+{
+    std::fill(histI.begin(), histI.end(), 0);
+    std::fill(histQ.begin(), histQ.end(), 0);
+}
+
+void LinHTFirQ31::setTaps(const LinHTFirTapsPtr &taps)
+{
+    size_t oldLen = revTaps.size();
+
+    revTaps.clear();
+    inShift = 0;
+    outShift = -OUT_FRAC_BITS;
+
+    if(taps && !taps->empty())
+    {
+        const size_t L = taps->size();
+        constexpr double maxQ = 2147483647.0;
+
+        float maxAbs = 0.f;
+        for(float h : *taps)
+        {
+            maxAbs = std::max(maxAbs, std::fabs(h));
+        }
+
+        // taps in Q31 scaled by 2^-tapShift, the largest one just fits
+        int tapShift = 0;
+        while(tapShift < 62 && std::ldexp(double(maxAbs), 31 - tapShift) > maxQ)
+        {
+            tapShift++;
+        }
+        while(maxAbs > 0.f && tapShift > -16 && std::ldexp(double(maxAbs), 32 - tapShift) <= maxQ)
+        {
+            tapShift--;
+        }
+
+        double sumQ = 0.0;
+        revTaps.resize(L);
+        for(size_t k = 0; k < L; k++)
+        {
+            double q = std::rint(std::ldexp(double((*taps)[k]), 31 - tapShift));
+            revTaps[L - 1 - k] = static_cast<int32_t>(q);
+            sumQ += std::fabs(q);
+        }
+
+        // Input headroom: for full scale input every partial sum, including
+        // the rounding of each product, stays inside int32.
+        while(std::ldexp(sumQ, -inShift) + double(L) >= maxQ)
+        {
+            inShift++;
+        }
+
+        // the accumulator holds the S32-scaled result times 2^-(inShift + tapShift),
+        // the output is Q15 with OUT_FRAC_BITS more bits, i.e. S32 times 2^-(16 - OUT_FRAC_BITS)
+        outShift = inShift + tapShift - (16 - OUT_FRAC_BITS);
+    }
+
+    if(revTaps.size() != oldLen)
+    {
+        size_t h = revTaps.empty() ? 0 : revTaps.size() - 1;
+        histI.assign(h, 0);
+        histQ.assign(h, 0);
+    }
+}
+
+void LinHTFirQ31::process(const int32_t *in, int32_t *outI, int32_t *outQ, size_t n)
+{
+    if(revTaps.empty())
+    {
+        deinterleave(in, outI, outQ, n, 16 - OUT_FRAC_BITS);
+        return;
+    }
+
+    // new samples go behind the history, so every output is a plain dot product
+    const size_t H = revTaps.size() - 1;
+    histI.resize(H + n);
+    histQ.resize(H + n);
+    deinterleave(in, histI.data() + H, histQ.data() + H, n, inShift);
+
+    filterChannel(histI, outI, n);
+    filterChannel(histQ, outQ, n);
+}
+
+void LinHTFirQ31::filterChannel(std::vector<int32_t> &hist, int32_t *out, size_t n)
+{
+    const size_t L = revTaps.size();
+    const size_t H = L - 1;
+    const int32_t *h = revTaps.data();
+    const int32_t *x = hist.data();
+
+    size_t k = 0;
+
+#ifdef __ARM_NEON
+    // 8 outputs at a time, one tap broadcast per step
+    const int32x4_t shift = vdupq_n_s32(outShift);
+    for(; k + 8 <= n; k += 8)
+    {
+        int32x4_t lo = vdupq_n_s32(0);
+        int32x4_t hi = vdupq_n_s32(0);
+
+        for(size_t j = 0; j < L; j++)
+        {
+            lo = qrdmlah(lo, vld1q_s32(x + k + j), h[j]);
+            hi = qrdmlah(hi, vld1q_s32(x + k + j + 4), h[j]);
+        }
+
+        vst1q_s32(out + k, vqrshlq_s32(lo, shift));
+        vst1q_s32(out + k + 4, vqrshlq_s32(hi, shift));
+    }
+#endif
+
+    for(; k < n; k++)
+    {
+        int32_t acc = 0;
+        for(size_t j = 0; j < L; j++)
+        {
+            acc += qrdmulh(x[k + j], h[j]);
+        }
+        out[k] = shiftSat32(acc, outShift);
+    }
+
+    // keep the last H inputs for the next block
+    std::memmove(hist.data(), hist.data() + n, H * sizeof(int32_t));
+    hist.resize(H);
+}
+
+void LinHTDcBlockQ15::process(const int32_t *inI, const int32_t *inQ,
+                              std::complex<int16_t> *out, size_t n)
+{
+    constexpr int64_t one = int64_t(1) << FRAC_BITS;
+
+    // the recursion is sequential, but it is only a few integer ops per sample
+    for(size_t i = 0; i < n; i++)
+    {
+        dcI += ((inI[i] * one - dcI) * ALPHA) >> ALPHA_BITS;
+        dcQ += ((inQ[i] * one - dcQ) * ALPHA) >> ALPHA_BITS;
+
+        out[i] = std::complex<int16_t>(
+            sat16(rshiftRound(inI[i] - rshiftRound(dcI, FRAC_BITS), IN_FRAC_BITS)),
+            sat16(rshiftRound(inQ[i] - rshiftRound(dcQ, FRAC_BITS), IN_FRAC_BITS)));
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "fir.h"
+
+// Fixed-point variant of the RX chain, used for CS16 streams:
+//
+//   S32 ALSA samples -> Q31 with headroom -> FIR (Q31 taps, rounding doubling
+//   multiply-high into int32 accumulators) -> Q23 -> integer DC blocker
+//   -> rounding, saturating narrowing to int16 (Q15)
+//
+// The samples keep their 24 significant bits through the filter and are only
+// narrowed to Q15 at the very end - narrowing before the FIR would let the
+// inverse-sinc taps (~14 dB noise gain) amplify the Q15 rounding noise.
+// The NEON and the scalar code give bit-identical results.
+
+class LinHTFirQ31
+{
+public:
+    static constexpr int OUT_FRAC_BITS = 8;  // output: Q15 with 8 extra fractional bits
+
+    LinHTFirQ31();
+    void reset();
+
+    // float taps are quantized to Q31, scaled so that the accumulator can
+    // never overflow; nullptr - bypass
+    void setTaps(const LinHTFirTapsPtr &taps);
+    bool enabled() const { return !revTaps.empty(); }
+
+    // `n` interleaved complex S32 samples in, I/Q out with OUT_FRAC_BITS
+    // fractional bits below Q15 (saturated to int32)
+    void process(const int32_t *in, int32_t *outI, int32_t *outQ, size_t n);
+
+private:
+    std::vector<int32_t> revTaps;  // time-reversed, Q31 scaled by 2^-tapShift
+    int inShift = 0;               // input headroom in bits
+    int outShift = -OUT_FRAC_BITS; // accumulator -> output, negative - right shift
+
+    // per channel: last (numTaps - 1) inputs followed by the current block
+    std::vector<int32_t> histI, histQ;
+
+    void filterChannel(std::vector<int32_t> &hist, int32_t *out, size_t n);
+};
+
+// First order DC blocker on the FIR output, with the float path's alpha
+// (1e-4, as a Q24 multiplier), followed by rounding and saturation to int16.
+class LinHTDcBlockQ15
+{
+public:
+    static constexpr int FRAC_BITS = 13;
+    static constexpr int IN_FRAC_BITS = LinHTFirQ31::OUT_FRAC_BITS;
+    static constexpr int ALPHA_BITS = 24;
+    static constexpr int64_t ALPHA = 1678;  // 1e-4 * 2^24
+
+    void reset() { dcI = dcQ = 0; }
+
+    void process(const int32_t *inI, const int32_t *inQ,
+                 std::complex<int16_t> *out, size_t n);
+
+    // current estimate, full scale = 1.0
+    float estimateI() const { return dcI / float(int64_t(1) << (FRAC_BITS + IN_FRAC_BITS)) / 32768.0f; }
+    float estimateQ() const { return dcQ / float(int64_t(1) << (FRAC_BITS + IN_FRAC_BITS)) / 32768.0f; }
+
+private:
+    int64_t dcI = 0;  // input scale with FRAC_BITS extra fractional bits
+    int64_t dcQ = 0;
+};